@@ -3,12 +3,19 @@
  */
 #include "abstractresolver.h"
 
+// QtNetworkCrumbs headers
+#include "networkmonitor.h"
+
 // Qt headers
 #include <QLoggingCategory>
 #include <QNetworkInterface>
 #include <QTimer>
 #include <QUdpSocket>
 
+#if QT_VERSION >= QT_VERSION_CHECK(6,3,0)
+#include <QNetworkInformation>
+#endif
+
 namespace qnc::core {
 
 namespace {
@@ -23,9 +30,11 @@ AbstractResolver::AbstractResolver(QObject *parent)
     : QObject{parent}
     , m_timer{new QTimer{this}}
 {
+    m_timer->setInterval(15s);
     m_timer->callOnTimeout(this, &AbstractResolver::onTimeout);
-    QTimer::singleShot(0, this, &AbstractResolver::onTimeout);
-    m_timer->start(15s);
+
+    // subclasses are not fully constructed yet, so their isScanningNeeded() cannot be called yet
+    QMetaObject::invokeMethod(this, [this] { updateScanning(); }, Qt::QueuedConnection);
 }
 
 void AbstractResolver::setScanInterval(std::chrono::milliseconds ms)
@@ -60,6 +69,134 @@ AbstractResolver::socketForAddress(const QHostAddress &address) const
     return m_sockets[address];
 }
 
+bool AbstractResolver::isMonitoringNetworkInterfaces() const
+{
+    return m_monitor && m_monitor->isActive();
+}
+
+bool AbstractResolver::isScanningNeeded() const
+{
+    return true;
+}
+
+bool AbstractResolver::isScanning() const
+{
+    return m_timer->isActive();
+}
+
+void AbstractResolver::updateScanning(bool scanImmediately)
+{
+    watchReachability();
+
+    const auto isWanted = isNetworkReachable() && isScanningNeeded();
+
+    if (isWanted)
+        startMonitor();
+    else
+        stopMonitor();
+
+    // with an active network monitor we get told when usable interfaces appear
+    const auto hasInterfaces = m_fullScanNeeded || !m_sockets.isEmpty() || !isMonitoringNetworkInterfaces();
+    const auto isNeeded = hasInterfaces && isWanted;
+
+    if (isNeeded == m_timer->isActive())
+        return;
+
+    if (isNeeded) {
+        qCDebug(lcResolver, "Resuming to scan");
+        m_timer->start();
+
+        if (scanImmediately)
+            QTimer::singleShot(0, this, &AbstractResolver::onTimeout);
+    } else {
+        qCDebug(lcResolver, "Pausing to scan");
+        m_timer->stop();
+    }
+}
+
+void AbstractResolver::startMonitor()
+{
+    if (m_monitor)
+        return;
+
+    m_monitor = new NetworkMonitor{this};
+
+    connect(m_monitor, &NetworkMonitor::interfaceChanged, this, &AbstractResolver::onInterfaceChanged);
+    connect(m_monitor, &NetworkMonitor::addressAdded, this, &AbstractResolver::onInterfaceChanged);
+    connect(m_monitor, &NetworkMonitor::addressRemoved, this, &AbstractResolver::onAddressRemoved);
+    connect(m_monitor, &NetworkMonitor::resynchronizationRequired,
+            this, &AbstractResolver::onResynchronizationRequired);
+
+    // changes that happened while not monitoring went unnoticed
+    m_fullScanNeeded = true;
+}
+
+void AbstractResolver::stopMonitor()
+{
+    if (!m_monitor)
+        return;
+
+    // this might get called by one of the monitor's own signals
+    m_monitor->disconnect(this);
+    std::exchange(m_monitor, nullptr)->deleteLater();
+
+    // nobody needs the sockets either, resuming rescans all interfaces
+    if (!m_sockets.isEmpty()) {
+        qCDebug(lcResolver, "Closing sockets while paused");
+        m_sockets.clear();
+    }
+
+    m_fullScanNeeded = true;
+}
+
+void AbstractResolver::watchReachability()
+{
+#if QT_VERSION >= QT_VERSION_CHECK(6,3,0)
+    // loading a backend changes global state of the application, so that
+    // this is left to the application, which might do it at any time
+    const auto info = QNetworkInformation::instance();
+
+    if (!info || m_networkInformation == info)
+        return;
+
+    m_networkInformation = info;
+    connect(info, &QNetworkInformation::reachabilityChanged,
+            this, &AbstractResolver::onReachabilityChanged);
+#endif
+}
+
+bool AbstractResolver::isNetworkReachable() const
+{
+#if QT_VERSION >= QT_VERSION_CHECK(6,3,0)
+    if (const auto info = QNetworkInformation::instance())
+        return info->reachability() != QNetworkInformation::Reachability::Disconnected;
+#endif
+
+    return true;
+}
+
+void AbstractResolver::resetSockets()
+{
+    m_sockets.clear();
+    onResynchronizationRequired();
+}
+
+AbstractResolver::SocketPointer
+AbstractResolver::findOrCreateSocket(const QNetworkInterface &iface, const QHostAddress &address)
+{
+    if (!isSupportedAddress(address))
+        return nullptr;
+
+    if (const auto socket = socketForAddress(address))
+        return socket;
+
+    qCInfo(lcResolver, "Creating socket for %ls on %ls",
+           qUtf16Printable(address.toString()),
+           qUtf16Printable(iface.humanReadableName()));
+
+    return createSocket(iface, address);
+}
+
 void AbstractResolver::scanNetworkInterfaces()
 {
     auto newSockets = SocketTable{};
@@ -72,30 +209,99 @@ void AbstractResolver::scanNetworkInterfaces()
 
         const auto addressEntries = iface.addressEntries();
         for (const auto &entry : addressEntries) {
-            if (!isSupportedAddress(entry.ip()))
-                continue;
-
-            if (const auto socket = socketForAddress(entry.ip())) {
+            if (const auto socket = findOrCreateSocket(iface, entry.ip()))
                 newSockets.insert(entry.ip(), socket);
-                continue;
-            }
+        }
+    }
+
+    std::exchange(m_sockets, newSockets);
+}
 
-            qCInfo(lcResolver, "Creating socket for %ls on %ls",
-                   qUtf16Printable(entry.ip().toString()),
-                   qUtf16Printable(iface.humanReadableName()));
+void AbstractResolver::scanNetworkInterface(int index)
+{
+    const auto &iface = QNetworkInterface::interfaceFromIndex(index);
 
-            if (const auto socket = createSocket(iface, entry.ip()))
+    if (!iface.isValid())
+        return; // the interface is gone, but we'll also get notified about its addresses
+
+    const auto isSupported = isSupportedInterface(iface);
+    const auto addressEntries = iface.addressEntries();
+    auto newSockets = SocketTable{};
+
+    for (const auto &entry : addressEntries) {
+        if (!isSupported) {
+            m_sockets.remove(entry.ip());
+        } else if (!socketForAddress(entry.ip())) {
+            if (const auto socket = findOrCreateSocket(iface, entry.ip()))
                 newSockets.insert(entry.ip(), socket);
         }
     }
 
-    std::exchange(m_sockets, newSockets);
+    if (newSockets.isEmpty())
+        return;
+
+    for (auto it = newSockets.cbegin(); it != newSockets.cend(); ++it)
+        m_sockets.insert(it.key(), it.value());
+
+    // don't let new links wait for the next scheduled scan
+    submitQueries(newSockets);
+}
+
+void AbstractResolver::onInterfaceChanged(int index)
+{
+    if (m_fullScanNeeded)
+        return; // the initial scan will pick up this interface
+
+    if (!isNetworkReachable() || !isScanningNeeded()) {
+        m_fullScanNeeded = true; // don't open sockets nobody needs, rescan once resuming
+        return;
+    }
+
+    scanNetworkInterface(index);
+    updateScanning(false);
+}
+
+void AbstractResolver::onAddressRemoved(int /*index*/, const QHostAddress &address)
+{
+    if (m_sockets.remove(address) > 0) {
+        qCInfo(lcResolver, "Removing socket for %ls",
+               qUtf16Printable(address.toString()));
+        updateScanning(false);
+    }
+}
+
+void AbstractResolver::onResynchronizationRequired()
+{
+    m_fullScanNeeded = true;
+
+    if (m_timer->isActive())
+        QTimer::singleShot(0, this, &AbstractResolver::onTimeout);
+    else
+        updateScanning(true);
+}
+
+void AbstractResolver::onReachabilityChanged()
+{
+    // interfaces and addresses most probably have changed meanwhile
+    if (isNetworkReachable())
+        m_fullScanNeeded = true;
+
+    updateScanning(true);
 }
 
 void AbstractResolver::onTimeout()
 {
-    scanNetworkInterfaces();
+    // a scan might have been scheduled before pausing
+    if (!m_timer->isActive())
+        return;
+
+    // with an active network monitor the socket table is updated incrementally,
+    // periodic scanning of all interfaces only remains as fallback
+    if (std::exchange(m_fullScanNeeded, !isMonitoringNetworkInterfaces()))
+        scanNetworkInterfaces();
+
     submitQueries(m_sockets);
+    updateScanning(false);
 }
 
 } // namespace qnc
@@ -6,12 +6,15 @@
 
 #include <QAbstractSocket>
 #include <QHostAddress>
+#include <QPointer>
 
 class QNetworkInterface;
 class QTimer;
 
 namespace qnc::core {
 
+class NetworkMonitor;
+
 class AbstractResolver : public QObject
 {
     Q_OBJECT
@@ -31,7 +34,7 @@ signals:
     void scanIntervalChanged(int interval);
 
 protected:
-    using SocketPointer = std::shared_ptr<QAbstractSocket>;
+    using SocketPointer = std::shared_ptr<QObject>;
     using SocketTable   = QHash<QHostAddress, SocketPointer>;
 
     [[nodiscard]] virtual bool isSupportedInterface(const QNetworkInterface &iface) const = 0;
@@ -41,15 +44,47 @@ protected:
                                                      const QHostAddress &address) = 0;
 
     [[nodiscard]] SocketPointer socketForAddress(const QHostAddress &address) const;
+    [[nodiscard]] SocketTable sockets() const { return m_sockets; }
+    [[nodiscard]] bool isMonitoringNetworkInterfaces() const;
+
+    // Returns true if somebody waits for the results of this resolver. Scanning pauses
+    // otherwise, and also while there is no usable network. The resolver only knows
+    // about the latter if the application loaded a backend for QNetworkInformation.
+    // While paused, the sockets are closed and network interfaces are not monitored.
+    // Subclasses must call updateScanning() whenever the value returned by this
+    // function changes.
+    [[nodiscard]] virtual bool isScanningNeeded() const;
+    [[nodiscard]] bool isScanning() const;
+    void updateScanning(bool scanImmediately = true);
+
+    // Drops all sockets, and schedules a scan of all network interfaces.
+    void resetSockets();
 
     virtual void submitQueries(const SocketTable &sockets) = 0;
 
 private:
     void onTimeout();
+    void onInterfaceChanged(int index);
+    void onAddressRemoved(int index, const QHostAddress &address);
+    void onResynchronizationRequired();
+    void onReachabilityChanged();
+
+    void startMonitor();
+    void stopMonitor();
+    void watchReachability();
+    [[nodiscard]] bool isNetworkReachable() const;
+
+    [[nodiscard]] SocketPointer findOrCreateSocket(const QNetworkInterface &iface,
+                                                   const QHostAddress &address);
+
     void scanNetworkInterfaces();
+    void scanNetworkInterface(int index);
 
-    QTimer *const   m_timer;
-    SocketTable     m_sockets;
+    QTimer *const           m_timer;
+    NetworkMonitor         *m_monitor = nullptr;
+    QPointer<QObject>       m_networkInformation;
+    SocketTable             m_sockets;
+    bool                    m_fullScanNeeded = true;
 };
 
 } // namespace qnc::core
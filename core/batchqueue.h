@@ -0,0 +1,184 @@
+/* QtNetworkCrumbs - Some networking toys for Qt
+ * Copyright (C) 2019-2024 Mathias Hasselmann
+ */
+#ifndef QNCCORE_BATCHQUEUE_H
+#define QNCCORE_BATCHQUEUE_H
+
+// QtNetworkCrumbs headers
+#include "ringbuffer.h"
+
+// Qt headers
+#include <QList>
+#include <QDeadlineTimer>
+#include <QMutex>
+#include <QObject>
+#include <QThread>
+#include <QWaitCondition>
+
+// STL headers
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <tuple>
+
+namespace qnc::core {
+
+// Passes values from any thread to the thread of some context object. Values that
+// get posted while a delivery is pending are coalesced into the same batch, so that
+// at most one queued call is pending, no matter how fast values get posted. The
+// values themselves are passed via a lock-free RingBuffer of bounded capacity.
+// The context object must outlive the threads posting to this queue.
+template<typename T>
+class BatchQueue
+{
+public:
+    using Batch    = QList<T>;
+    using Consumer = std::function<void(Batch)>;
+
+    static constexpr auto s_defaultCapacity = std::size_t{1024};
+
+    BatchQueue(QObject *context, Consumer consumer, std::size_t capacity = s_defaultCapacity)
+        : m_shared{std::make_shared<Shared>(context, std::move(consumer), capacity)}
+    {}
+
+    // Posts the value, unless the queue is full, because the context's thread
+    // doesn't keep up. Returns false and drops the value in that case.
+    bool tryPost(T value) const
+    {
+        if (!m_shared->buffer.push(std::move(value)))
+            return false;
+
+        m_shared->scheduleDelivery();
+        return true;
+    }
+
+    // Posts the value, and blocks until the context's thread made room if the queue
+    // is full. Called from the context's thread, a full queue gets delivered at once.
+    // Returns false if the posting thread got asked to stop while waiting.
+    bool post(T value) const
+    {
+        if (tryPost(value))
+            return true;
+
+        const auto currentThread = QThread::currentThread();
+
+        if (currentThread == m_shared->context->thread()) {
+            do {
+                m_shared->deliver();
+            } while (!tryPost(value));
+
+            return true;
+        }
+
+        return m_shared->waitAndPost(currentThread, std::move(value));
+    }
+
+private:
+    struct Shared : public std::enable_shared_from_this<Shared>
+    {
+        Shared(QObject *context, Consumer consumer, std::size_t capacity)
+            : context{context}
+            , consumer{std::move(consumer)}
+            , buffer{capacity}
+        {}
+
+        void scheduleDelivery()
+        {
+            if (isDeliveryPending.exchange(true))
+                return;
+
+            QMetaObject::invokeMethod(context, [shared = this->shared_from_this()] {
+                shared->deliver();
+            }, Qt::QueuedConnection);
+        }
+
+        bool waitAndPost(QThread *currentThread, T value)
+        {
+            const auto locker = QMutexLocker{&mutex};
+
+            waitingProducers.fetch_add(1);
+
+            while (!buffer.push(T{value})) {
+                if (currentThread->isInterruptionRequested()) {
+                    waitingProducers.fetch_sub(1);
+                    return false;
+                }
+
+                // the context's thread might not have seen this producer yet,
+                // also interruption requests don't wake us up
+                scheduleDelivery();
+                spaceAvailable.wait(&mutex, QDeadlineTimer{s_maximumWaitTime});
+            }
+
+            waitingProducers.fetch_sub(1);
+            scheduleDelivery();
+            return true;
+        }
+
+        void deliver()
+        {
+            // clear the flag first, so that values pushed while draining schedule another delivery
+            isDeliveryPending.store(false);
+
+            auto batch = Batch{};
+            auto value = T{};
+
+            // don't let busy producers starve the context's event loop
+            for (auto limit = buffer.capacity(); limit > 0 && buffer.pop(value); --limit)
+                batch.append(std::move(value));
+
+            if (!batch.isEmpty() && waitingProducers.load() > 0) {
+                const auto locker = QMutexLocker{&mutex};
+                spaceAvailable.wakeAll();
+            }
+
+            if (static_cast<std::size_t>(batch.size()) == buffer.capacity())
+                scheduleDelivery();
+            if (!batch.isEmpty())
+                consumer(std::move(batch));
+        }
+
+        static constexpr auto s_maximumWaitTime = std::chrono::milliseconds{50};
+
+        QObject *const context;
+        const Consumer consumer;
+
+        RingBuffer<T>     buffer;
+        std::atomic<bool> isDeliveryPending{false};
+        std::atomic<int>  waitingProducers{0};
+        QMutex            mutex;
+        QWaitCondition    spaceAvailable;
+    };
+
+    std::shared_ptr<Shared> m_shared;
+};
+
+namespace detail {
+
+template<typename... Args>
+struct BatchValue { using type = std::tuple<std::decay_t<Args>...>; };
+
+template<typename Arg>
+struct BatchValue<Arg> { using type = std::decay_t<Arg>; };
+
+} // namespace detail
+
+// Connects a signal emitted on some other thread, like the one of a ResolverThread, to a
+// consumer running in the thread of context. The consumer receives lists of the signal's
+// arguments; signals with multiple arguments are delivered as lists of std::tuple.
+template<class Sender, typename... Args, typename Consumer>
+QMetaObject::Connection connectBatched(const Sender *sender, void (Sender::*signal)(Args...),
+                                       QObject *context, Consumer consumer)
+{
+    using Value = typename detail::BatchValue<Args...>::type;
+    const auto queue = BatchQueue<Value>{context, std::move(consumer)};
+
+    return QObject::connect(sender, signal, context, [queue](Args... args) {
+        queue.post(Value(args...));
+    }, Qt::DirectConnection);
+}
+
+} // namespace qnc::core
+
+#endif // QNCCORE_BATCHQUEUE_H
@@ -0,0 +1,86 @@
+/* QtNetworkCrumbs - Some networking toys for Qt
+ * Copyright (C) 2019-2024 Mathias Hasselmann
+ */
+#include "bytetemplate.h"
+
+// QtNetworkCrumbs headers
+#include "literals.h"
+
+namespace qnc::core {
+
+namespace {
+
+using literals::compat::lentype;
+
+const QByteArray *findValue(std::initializer_list<ByteTemplate::Argument> arguments, const QByteArray &name)
+{
+    for (const auto &[key, value] : arguments) {
+        if (key == name)
+            return &value;
+    }
+
+    return nullptr;
+}
+
+} // namespace
+
+ByteTemplate::ByteTemplate(const QByteArray &text)
+{
+    for (auto offset = lentype{0}; offset < text.size(); ) {
+        const auto start = text.indexOf('{', offset);
+        const auto end = start < 0 ? start : text.indexOf('}', start + 1);
+
+        if (end < 0) {
+            m_segments.append({text.mid(offset), false});
+            break;
+        }
+
+        if (start > offset)
+            m_segments.append({text.mid(offset, start - offset), false});
+
+        m_segments.append({text.mid(start + 1, end - start - 1), true});
+        offset = end + 1;
+    }
+}
+
+QByteArrayList ByteTemplate::placeholders() const
+{
+    auto placeholders = QByteArrayList{};
+
+    for (const auto &segment : m_segments) {
+        if (segment.isPlaceholder && !placeholders.contains(segment.text))
+            placeholders.append(segment.text);
+    }
+
+    return placeholders;
+}
+
+QByteArray ByteTemplate::render(std::initializer_list<Argument> arguments) const
+{
+    auto size = lentype{0};
+
+    for (const auto &segment : m_segments) {
+        if (!segment.isPlaceholder)
+            size += segment.text.size();
+        else if (const auto value = findValue(arguments, segment.text))
+            size += value->size();
+        else
+            size += segment.text.size() + 2;
+    }
+
+    auto result = QByteArray{};
+    result.reserve(size);
+
+    for (const auto &segment : m_segments) {
+        if (!segment.isPlaceholder)
+            result.append(segment.text);
+        else if (const auto value = findValue(arguments, segment.text))
+            result.append(*value);
+        else
+            result.append('{').append(segment.text).append('}');
+    }
+
+    return result;
+}
+
+} // namespace qnc::core
@@ -0,0 +1,44 @@
+/* QtNetworkCrumbs - Some networking toys for Qt
+ * Copyright (C) 2019-2024 Mathias Hasselmann
+ */
+#ifndef QNCCORE_BYTETEMPLATE_H
+#define QNCCORE_BYTETEMPLATE_H
+
+// Qt headers
+#include <QByteArrayList>
+
+// STL headers
+#include <initializer_list>
+#include <utility>
+
+namespace qnc::core {
+
+// A text with placeholders like "{name}", split into literal text and placeholders
+// once, so that rendering it needs neither searching nor more than one allocation.
+class ByteTemplate
+{
+public:
+    using Argument = std::pair<QByteArray, QByteArray>;
+
+    ByteTemplate() = default;
+    explicit ByteTemplate(const QByteArray &text);
+
+    [[nodiscard]] QByteArrayList placeholders() const;
+
+    // Replaces the placeholders by the values of the matching arguments.
+    // Placeholders without argument are kept, so that they can be rendered later.
+    [[nodiscard]] QByteArray render(std::initializer_list<Argument> arguments) const;
+
+private:
+    struct Segment
+    {
+        QByteArray text          = {};
+        bool       isPlaceholder = false;
+    };
+
+    QList<Segment> m_segments;
+};
+
+} // namespace qnc::core
+
+#endif // QNCCORE_BYTETEMPLATE_H
@@ -0,0 +1,150 @@
+/* QtNetworkCrumbs - Some networking toys for Qt
+ * Copyright (C) 2019-2024 Mathias Hasselmann
+ */
+#include "datagramengine.h"
+
+// Qt headers
+#include <QLoggingCategory>
+#include <QNetworkDatagram>
+#include <QNetworkInterface>
+#include <QUdpSocket>
+#include <QVariant>
+
+#if defined(Q_OS_LINUX)
+
+// Linux headers
+#include <linux/sock_diag.h>
+
+// POSIX headers
+#include <sys/socket.h>
+
+// STL headers
+#include <array>
+
+#endif // Q_OS_LINUX
+
+namespace qnc::core {
+
+namespace {
+
+Q_LOGGING_CATEGORY(lcEngine, "qnc.core.engine")
+
+QHostAddress wildcardAddress(const QHostAddress &address)
+{
+    switch(address.protocol()) {
+    case QUdpSocket::IPv4Protocol:
+        return QHostAddress::AnyIPv4;
+
+    case QUdpSocket::IPv6Protocol:
+        return QHostAddress::AnyIPv6;
+
+    case QUdpSocket::AnyIPProtocol:
+    case QUdpSocket::UnknownNetworkLayerProtocol:
+        break;
+    }
+
+    Q_UNREACHABLE();
+    return {};
+}
+
+} // namespace
+
+void DatagramEngine::flush()
+{
+}
+
+DatagramEngine::SocketPointer
+QtDatagramEngine::createSocket(const QNetworkInterface &iface, const QHostAddress &address,
+                               const QHostAddress &group, quint16 port)
+{
+    auto socket = std::make_shared<QUdpSocket>(this);
+
+    const auto &bindAddress = wildcardAddress(address);
+    const auto &bindMode = QUdpSocket::ShareAddress | QUdpSocket::ReuseAddressHint;
+
+    if (!socket->bind(bindAddress, port, bindMode)) {
+        qCWarning(lcEngine, "Could not bind multicast socket to %ls, port %d: %ls",
+                  qUtf16Printable(address.toString()), port,
+                  qUtf16Printable(socket->errorString()));
+        return nullptr;
+    }
+
+    if (socket->joinMulticastGroup(group, iface)) {
+        qCDebug(lcEngine, "Multicast group %ls joined on %ls",
+                qUtf16Printable(group.toString()),
+                qUtf16Printable(iface.humanReadableName()));
+    } else if (socket->error() != QUdpSocket::UnknownSocketError) {
+        qCWarning(lcEngine, "Could not join multicast group %ls on %ls: %ls",
+                  qUtf16Printable(group.toString()),
+                  qUtf16Printable(iface.name()),
+                  qUtf16Printable(socket->errorString()));
+        return nullptr;
+    }
+
+    connect(socket.get(), &QUdpSocket::readyRead,
+            this, [this, socket = socket.get()] {
+        onReadyRead(socket);
+    });
+
+    connect(socket.get(), &QUdpSocket::destroyed,
+            this, [this, socket = socket.get()] {
+        m_dropCounts.remove(socket);
+    });
+
+    socket->setMulticastInterface(iface);
+    socket->setSocketOption(QUdpSocket::MulticastTtlOption, 4);
+
+    return socket;
+}
+
+qintptr QtDatagramEngine::socketDescriptor(const SocketPointer &socket) const
+{
+    Q_ASSERT(dynamic_cast<QUdpSocket *>(socket.get()));
+    return static_cast<QUdpSocket *>(socket.get())->socketDescriptor();
+}
+
+void QtDatagramEngine::setReceiveBufferSize(const SocketPointer &socket, int size)
+{
+    Q_ASSERT(dynamic_cast<QUdpSocket *>(socket.get()));
+    static_cast<QUdpSocket *>(socket.get())->setSocketOption(QUdpSocket::ReceiveBufferSizeSocketOption, size);
+}
+
+void QtDatagramEngine::writeDatagram(const SocketPointer &socket, const QByteArray &data,
+                                     const QHostAddress &address, quint16 port)
+{
+    Q_ASSERT(dynamic_cast<QUdpSocket *>(socket.get()));
+    static_cast<QUdpSocket *>(socket.get())->writeDatagram(data, address, port);
+}
+
+void QtDatagramEngine::onReadyRead(QUdpSocket *socket)
+{
+    while (socket->hasPendingDatagrams())
+        emit datagramReceived(socket->receiveDatagram());
+
+    updateDropCount(socket);
+}
+
+void QtDatagramEngine::updateDropCount(QUdpSocket *socket)
+{
+#if defined(Q_OS_LINUX)
+    // QUdpSocket doesn't expose ancillary data like SO_RXQ_OVFL, but SO_MEMINFO has the same counter
+    auto meminfo = std::array<quint32, SK_MEMINFO_VARS>{};
+    auto length = static_cast<socklen_t>(sizeof meminfo);
+
+    if (::getsockopt(static_cast<int>(socket->socketDescriptor()), SOL_SOCKET, SO_MEMINFO,
+                     meminfo.data(), &length) < 0 || length <= SK_MEMINFO_DROPS * sizeof(quint32))
+        return;
+
+    const auto dropCount = meminfo[SK_MEMINFO_DROPS];
+    auto &lastDropCount = m_dropCounts[socket];
+
+    if (const auto dropped = dropCount - std::exchange(lastDropCount, dropCount); dropped > 0)
+        emit datagramsDropped(dropped);
+#else // !Q_OS_LINUX
+    Q_UNUSED(socket);
+#endif // !Q_OS_LINUX
+}
+
+} // namespace qnc::core
+
+#include "moc_datagramengine.cpp"
@@ -0,0 +1,87 @@
+/* QtNetworkCrumbs - Some networking toys for Qt
+ * Copyright (C) 2019-2024 Mathias Hasselmann
+ */
+#ifndef QNCCORE_DATAGRAMENGINE_H
+#define QNCCORE_DATAGRAMENGINE_H
+
+// Qt headers
+#include <QHash>
+#include <QObject>
+
+// STL headers
+#include <memory>
+
+class QHostAddress;
+class QNetworkDatagram;
+class QNetworkInterface;
+class QUdpSocket;
+
+namespace qnc::core {
+
+// Creates the multicast sockets of a MulticastResolver and moves datagrams
+// from and to them. Sockets are opaque handles owned by the caller; the
+// engine must outlive the sockets it has created.
+class DatagramEngine : public QObject
+{
+    Q_OBJECT
+
+public:
+    using SocketPointer = std::shared_ptr<QObject>;
+
+    using QObject::QObject;
+
+    // Binds a new socket to the given port, or to a random port if 0, of the wildcard
+    // address matching the protocol of address, and joins the multicast group on the
+    // given interface. Sockets bound to a fixed port share it with other sockets and
+    // processes, like the system's mDNS responder, to receive unsolicited messages.
+    [[nodiscard]] virtual SocketPointer createSocket(const QNetworkInterface &iface,
+                                                     const QHostAddress &address,
+                                                     const QHostAddress &group,
+                                                     quint16 port) = 0;
+
+    [[nodiscard]] virtual qintptr socketDescriptor(const SocketPointer &socket) const = 0;
+
+    virtual void setReceiveBufferSize(const SocketPointer &socket, int size) = 0;
+
+    // Sends a datagram, or just queues it until flush() is called.
+    virtual void writeDatagram(const SocketPointer &socket, const QByteArray &data,
+                               const QHostAddress &address, quint16 port) = 0;
+    virtual void flush();
+
+signals:
+    void datagramReceived(const QNetworkDatagram &datagram);
+
+    // Reports datagrams the kernel had to drop because some socket's receive buffer was full.
+    void datagramsDropped(quint64 count);
+};
+
+// The portable engine, built on top of QUdpSocket.
+class QtDatagramEngine : public DatagramEngine
+{
+    Q_OBJECT
+
+public:
+    using DatagramEngine::DatagramEngine;
+
+    [[nodiscard]] SocketPointer createSocket(const QNetworkInterface &iface,
+                                             const QHostAddress &address,
+                                             const QHostAddress &group,
+                                             quint16 port) override;
+
+    [[nodiscard]] qintptr socketDescriptor(const SocketPointer &socket) const override;
+
+    void setReceiveBufferSize(const SocketPointer &socket, int size) override;
+
+    void writeDatagram(const SocketPointer &socket, const QByteArray &data,
+                       const QHostAddress &address, quint16 port) override;
+
+private:
+    void onReadyRead(QUdpSocket *socket);
+    void updateDropCount(QUdpSocket *socket);
+
+    QHash<QUdpSocket *, quint32> m_dropCounts;
+};
+
+} // namespace qnc::core
+
+#endif // QNCCORE_DATAGRAMENGINE_H
@@ -0,0 +1,82 @@
+/* QtNetworkCrumbs - Some networking toys for Qt
+ * Copyright (C) 2019-2024 Mathias Hasselmann
+ */
+#include "decoderpool.h"
+
+// QtNetworkCrumbs headers
+#include "batchqueue.h"
+#include "literals.h"
+
+// Qt headers
+#include <QHostAddress>
+#include <QNetworkDatagram>
+#include <QThread>
+
+// STL headers
+#include <algorithm>
+
+namespace qnc::core {
+
+class DecoderPool::Worker
+{
+public:
+    Worker(int index, const Decoder &decoder, const BatchQueue<Result> &results)
+        : m_queue{&m_context, [decoder, results](QList<QNetworkDatagram> datagrams) {
+            for (const auto &datagram : datagrams) {
+                if (auto result = decoder(datagram); result && !results.post(std::move(result)))
+                    return; // the pool is shutting down
+            }
+        }}
+    {
+        m_thread.setObjectName("QncDecoder-"_L1 + QString::number(index));
+        m_context.moveToThread(&m_thread);
+        m_thread.start();
+    }
+
+    ~Worker()
+    {
+        // stops workers waiting for the context's thread, which now waits for them
+        m_thread.requestInterruption();
+        m_thread.quit();
+        m_thread.wait();
+    }
+
+    bool post(const QNetworkDatagram &datagram) const
+    {
+        return m_queue.tryPost(datagram);
+    }
+
+private:
+    QThread m_thread;
+    QObject m_context;
+    BatchQueue<QNetworkDatagram> m_queue;
+};
+
+DecoderPool::DecoderPool(int threadCount, const Decoder &decoder, QObject *context)
+{
+    const auto results = BatchQueue<Result>{context, [](QList<Result> results) {
+        for (const auto &apply : results)
+            apply();
+    }};
+
+    m_workers.reserve(static_cast<std::size_t>(std::max(threadCount, 1)));
+
+    for (auto i = 0; i < std::max(threadCount, 1); ++i)
+        m_workers.emplace_back(std::make_unique<Worker>(i, decoder, results));
+}
+
+DecoderPool::~DecoderPool() = default;
+
+int DecoderPool::threadCount() const
+{
+    return static_cast<int>(m_workers.size());
+}
+
+bool DecoderPool::decode(const QNetworkDatagram &datagram) const
+{
+    // all datagrams of the same sender go to the same worker to keep them ordered
+    const auto shard = qHash(datagram.senderAddress()) % m_workers.size();
+    return m_workers[shard]->post(datagram);
+}
+
+} // namespace qnc::core
@@ -0,0 +1,47 @@
+/* QtNetworkCrumbs - Some networking toys for Qt
+ * Copyright (C) 2019-2024 Mathias Hasselmann
+ */
+#ifndef QNCCORE_DECODERPOOL_H
+#define QNCCORE_DECODERPOOL_H
+
+// Qt headers
+#include <QtGlobal>
+
+// STL headers
+#include <functional>
+#include <memory>
+#include <vector>
+
+class QNetworkDatagram;
+class QObject;
+
+namespace qnc::core {
+
+// Decodes datagrams in a small pool of worker threads. Datagrams get distributed by
+// their sender address, so that the datagrams of each sender still get decoded, and
+// their results get applied, in the order they were received. The functions returned
+// by the decoder get called in batches from the thread of the context object. Workers
+// wait while the context's thread is busy, so that no result gets lost; instead new
+// datagrams get dropped once a worker's queue is full.
+class DecoderPool
+{
+public:
+    using Result  = std::function<void()>;
+    using Decoder = std::function<Result(const QNetworkDatagram &)>;
+
+    DecoderPool(int threadCount, const Decoder &decoder, QObject *context);
+    ~DecoderPool();
+
+    [[nodiscard]] int threadCount() const;
+
+    // Returns false and drops the datagram if the responsible worker's queue is full.
+    bool decode(const QNetworkDatagram &datagram) const;
+
+private:
+    class Worker;
+    std::vector<std::unique_ptr<Worker>> m_workers;
+};
+
+} // namespace qnc::core
+
+#endif // QNCCORE_DECODERPOOL_H
@@ -0,0 +1,59 @@
+/* QtNetworkCrumbs - Some networking toys for Qt
+ * Copyright (C) 2019-2024 Mathias Hasselmann
+ */
+#include "duplicatefilter.h"
+
+// Qt headers
+#include <QHash>
+#include <QNetworkDatagram>
+
+namespace qnc::core {
+
+DuplicateFilter::DuplicateFilter(milliseconds window)
+    : m_window{window}
+{}
+
+void DuplicateFilter::setWindow(milliseconds window)
+{
+    m_window = window;
+    m_entries.fill({});
+}
+
+DuplicateFilter::Verdict DuplicateFilter::check(const QNetworkDatagram &datagram, clock::time_point now)
+{
+    if (m_window.count() <= 0)
+        return Verdict::Unique;
+
+    const auto &payload = datagram.data();
+    const auto hash = static_cast<std::size_t>(qHash(payload, qHash(datagram.senderAddress())));
+    const auto size = static_cast<qsizetype>(payload.size());
+    const auto interfaceIndex = datagram.interfaceIndex();
+
+    for (auto &entry : m_entries) {
+        if (entry.hash != hash || entry.size != size || entry.expiry <= now)
+            continue;
+
+        // unknown interfaces cannot tell anything new
+        if (interfaceIndex == 0)
+            return Verdict::Repeated;
+
+        for (auto &knownIndex : entry.interfaces) {
+            if (knownIndex == interfaceIndex)
+                return Verdict::Repeated;
+
+            if (knownIndex == 0) {
+                knownIndex = interfaceIndex;
+                return Verdict::ViaOtherInterface;
+            }
+        }
+
+        return Verdict::ViaOtherInterface;
+    }
+
+    m_entries[m_next] = {hash, size, now + m_window, {interfaceIndex}};
+    m_next = (m_next + 1) % m_entries.size();
+
+    return Verdict::Unique;
+}
+
+} // namespace qnc::core
@@ -0,0 +1,68 @@
+/* QtNetworkCrumbs - Some networking toys for Qt
+ * Copyright (C) 2019-2024 Mathias Hasselmann
+ */
+#ifndef QNCCORE_DUPLICATEFILTER_H
+#define QNCCORE_DUPLICATEFILTER_H
+
+// Qt headers
+#include <QtGlobal>
+
+// STL headers
+#include <array>
+#include <chrono>
+
+class QNetworkDatagram;
+
+namespace qnc::core {
+
+// Remembers the hashes of recently received datagrams, so that copies of a message received
+// more than once from the same sender, like retransmissions, copies received by several
+// sockets, or copies received via several interfaces, can be dropped before parsing them.
+// Copies from other senders or address families are kept, as they tell how services can be
+// reached. Copies via other interfaces are reported as such, so that their interface can be
+// attributed to the sender without parsing the copy.
+class DuplicateFilter
+{
+public:
+    using clock = std::chrono::steady_clock;
+    using milliseconds = std::chrono::milliseconds;
+
+    enum class Verdict {
+        Unique,
+        Repeated,
+        ViaOtherInterface,
+    };
+
+    static constexpr auto s_defaultWindow = milliseconds{500};
+
+    explicit DuplicateFilter(milliseconds window = s_defaultWindow);
+
+    // The time for which payloads are remembered; 0 disables this filter.
+    [[nodiscard]] milliseconds window() const { return m_window; }
+    void setWindow(milliseconds window);
+
+    // Tells whether the same payload was received from the same sender within the window,
+    // and via which interface; remembers the datagram and its interface otherwise.
+    [[nodiscard]] Verdict check(const QNetworkDatagram &datagram, clock::time_point now = clock::now());
+
+    [[nodiscard]] bool isDuplicate(const QNetworkDatagram &datagram, clock::time_point now = clock::now())
+    { return check(datagram, now) != Verdict::Unique; }
+
+private:
+    struct Entry
+    {
+        std::size_t         hash       = 0;
+        qsizetype           size       = 0;
+        clock::time_point   expiry     = {};
+        std::array<uint, 4> interfaces = {}; // hosts rarely share more links than that
+    };
+
+    // a linear search over few entries is faster than hashing, and the window is short
+    std::array<Entry, 64> m_entries  = {};
+    std::size_t           m_next     = 0;
+    milliseconds          m_window;
+};
+
+} // namespace qnc::core
+
+#endif // QNCCORE_DUPLICATEFILTER_H
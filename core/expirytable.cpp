@@ -0,0 +1,63 @@
+/* QtNetworkCrumbs - Some networking toys for Qt
+ * Copyright (C) 2019-2024 Mathias Hasselmann
+ */
+#include "expirytable.h"
+
+// STL headers
+#include <algorithm>
+#include <chrono>
+
+namespace qnc::core {
+
+namespace {
+
+// well below the limit of QTimer, and short enough to notice clock changes
+constexpr auto s_maximumInterval = std::chrono::milliseconds{std::chrono::hours{24}};
+
+} // namespace
+
+ExpiryTimer::ExpiryTimer(QObject *context, std::function<void()> callback)
+    : m_timer{new QTimer{context}}
+    , m_callback{std::move(callback)}
+{
+    m_timer->setSingleShot(true);
+    m_timer->callOnTimeout(context, [this] { onTimeout(); });
+}
+
+void ExpiryTimer::schedule(const QDateTime &dueTime)
+{
+    if (m_timer->isActive() && m_dueTime <= dueTime)
+        return;
+
+    m_dueTime = dueTime;
+    start();
+}
+
+void ExpiryTimer::start()
+{
+    const auto remaining = std::chrono::milliseconds{QDateTime::currentDateTimeUtc().msecsTo(m_dueTime)};
+    m_timer->start(std::clamp(remaining, std::chrono::milliseconds::zero(), s_maximumInterval));
+}
+
+void ExpiryTimer::onTimeout()
+{
+    // the interval got clamped, or the timer fired a little early
+    if (QDateTime::currentDateTimeUtc() < m_dueTime) {
+        start();
+        return;
+    }
+
+    m_callback();
+}
+
+void ExpiryTimer::stop()
+{
+    m_timer->stop();
+}
+
+bool ExpiryTimer::isActive() const
+{
+    return m_timer->isActive();
+}
+
+} // namespace qnc::core
@@ -0,0 +1,111 @@
+/* QtNetworkCrumbs - Some networking toys for Qt
+ * Copyright (C) 2019-2024 Mathias Hasselmann
+ */
+#ifndef QNCCORE_EXPIRYTABLE_H
+#define QNCCORE_EXPIRYTABLE_H
+
+// Qt headers
+#include <QDateTime>
+#include <QHash>
+#include <QTimer>
+
+// STL headers
+#include <functional>
+
+namespace qnc::core {
+
+// A single-shot timer that fires at the earliest time it got scheduled for.
+// The timer is owned by the context object, which also runs the callback.
+// Distant due times are reached in steps, as QTimer only takes intervals
+// that fit into an int.
+class ExpiryTimer
+{
+public:
+    ExpiryTimer(QObject *context, std::function<void()> callback);
+
+    Q_DISABLE_COPY_MOVE(ExpiryTimer)
+
+    // Arms the timer for dueTime, unless it already is armed for some earlier time.
+    void schedule(const QDateTime &dueTime);
+    void stop();
+
+    [[nodiscard]] bool isActive() const;
+
+private:
+    void start();
+    void onTimeout();
+
+    QTimer *const               m_timer;
+    const std::function<void()> m_callback;
+    QDateTime                   m_dueTime;
+};
+
+// Tracks until when keys, like the names of services, are valid, and reports the
+// expired ones in batches, from a single timer armed for the earliest expiry.
+template<typename Key>
+class ExpiryTable
+{
+public:
+    using Callback = std::function<void(const QList<Key> &)>;
+
+    ExpiryTable(QObject *context, Callback onExpired)
+        : m_onExpired{std::move(onExpired)}
+        , m_timer{context, [this] { expire(); }}
+    {}
+
+    Q_DISABLE_COPY_MOVE(ExpiryTable)
+
+    // Tracks key until expiry, which replaces any earlier expiry of it.
+    // Keys with an invalid expiry never expire, and therefore are not tracked.
+    void insert(const Key &key, const QDateTime &expiry)
+    {
+        if (!expiry.isValid()) {
+            m_expiries.remove(key);
+            return;
+        }
+
+        m_expiries.insert(key, expiry);
+        m_timer.schedule(expiry);
+    }
+
+    bool remove(const Key &key) { return m_expiries.remove(key) > 0; }
+
+    [[nodiscard]] bool contains(const Key &key) const { return m_expiries.contains(key); }
+    [[nodiscard]] QDateTime expiry(const Key &key) const { return m_expiries.value(key); }
+
+private:
+    void expire()
+    {
+        const auto now = QDateTime::currentDateTimeUtc();
+        auto expiredKeys = QList<Key>{};
+        auto nextExpiry = QDateTime{};
+
+        for (auto it = m_expiries.begin(); it != m_expiries.end(); ) {
+            if (it.value() <= now) {
+                expiredKeys += it.key();
+                it = m_expiries.erase(it);
+                continue;
+            }
+
+            if (!nextExpiry.isValid() || it.value() < nextExpiry)
+                nextExpiry = it.value();
+
+            ++it;
+        }
+
+        if (nextExpiry.isValid())
+            m_timer.schedule(nextExpiry);
+
+        // the callback might modify this table
+        if (!expiredKeys.isEmpty())
+            m_onExpired(expiredKeys);
+    }
+
+    QHash<Key, QDateTime> m_expiries;
+    const Callback        m_onExpired;
+    ExpiryTimer           m_timer;
+};
+
+} // namespace qnc::core
+
+#endif // QNCCORE_EXPIRYTABLE_H
@@ -3,39 +3,500 @@
  */
 #include "multicastresolver.h"
 
+// QtNetworkCrumbs headers
+#include "compat.h"
+#include "datagramengine.h"
+#include "decoderpool.h"
+#include "sharedtransport.h"
+#include "uringdatagramengine.h"
+#include "warmcache.h"
+
 // Qt headers
 #include <QLoggingCategory>
+#include <QMetaEnum>
+#include <QMetaMethod>
 #include <QNetworkDatagram>
 #include <QNetworkInterface>
-#include <QUdpSocket>
-#include <QVariant>
+#include <QRandomGenerator>
+#include <QSet>
+#include <QTimer>
+
+// STL headers
+#include <algorithm>
+#include <array>
 
 namespace qnc::core {
 
 namespace {
 
+using namespace std::chrono_literals;
+
 Q_LOGGING_CATEGORY(lcMulticast, "qnc.core.resolver.multicast")
 
-QHostAddress wildcardAddress(const QHostAddress &address)
+constexpr auto s_overloadThreshold = quint64{32}; // dropped datagrams
+constexpr auto s_overloadRecovery  = 30s;
+
+auto engineName(MulticastResolver::Engine engine)
+{
+    return QMetaEnum::fromType<MulticastResolver::Engine>().valueToKey(qToUnderlying(engine));
+}
+
+std::unique_ptr<DatagramEngine> createEngine(MulticastResolver::Engine engine, QObject *parent)
 {
-    switch(address.protocol()) {
-    case QUdpSocket::IPv4Protocol:
-        return QHostAddress::AnyIPv4;
+    switch (engine) {
+    case MulticastResolver::Engine::Qt:
+        return std::make_unique<QtDatagramEngine>(parent);
 
-    case QUdpSocket::IPv6Protocol:
-        return QHostAddress::AnyIPv6;
+    case MulticastResolver::Engine::IoUring:
+        if (auto uringEngine = std::make_unique<UringDatagramEngine>(parent); uringEngine->isValid())
+            return uringEngine;
 
-    case QUdpSocket::AnyIPProtocol:
-    case QUdpSocket::UnknownNetworkLayerProtocol:
         break;
     }
 
-    Q_UNREACHABLE();
-    return {};
+    return nullptr;
+}
+
+SharedTransport *sharedTransport(const std::shared_ptr<QObject> &socket)
+{
+    return qobject_cast<SharedTransport *>(socket.get());
 }
 
 } // namespace
 
+MulticastResolver::MulticastResolver(QObject *parent)
+    : AbstractResolver{parent}
+    , m_overloadTimer{new QTimer{this}}
+    , m_batchTimer{new QTimer{this}}
+    , m_pacingTimer{new QTimer{this}}
+    , m_engine{new QtDatagramEngine{this}}
+    , m_serviceExpiries{this, [this](const QList<QString> &names) {
+        for (const auto &name : names)
+            expireService(name);
+    }}
+    , m_staleServices{this, [this](const QList<QString> &names) { expireStaleServices(names); }}
+{
+    m_overloadTimer->setSingleShot(true);
+    m_overloadTimer->setInterval(s_overloadRecovery);
+    m_overloadTimer->callOnTimeout(this, [this] {
+        m_recentDrops = 0;
+        setOverloaded(false);
+    });
+
+    m_batchTimer->setSingleShot(true);
+    m_batchTimer->setInterval(0);
+    m_batchTimer->callOnTimeout(this, &MulticastResolver::deliverBatches);
+
+    m_pacingTimer->setSingleShot(true);
+    m_pacingTimer->callOnTimeout(this, &MulticastResolver::sendPendingQueries);
+
+    connectEngine();
+}
+
+// the decoder pool must be stopped before the resolver gets destroyed
+MulticastResolver::~MulticastResolver() = default;
+
+MulticastResolver::Engine MulticastResolver::engine() const
+{
+    return m_engineType;
+}
+
+void MulticastResolver::setEngine(Engine engine)
+{
+    if (m_engineType == engine)
+        return;
+
+    if (!isSupportedEngine(engine)) {
+        qCWarning(lcMulticast, "Unsupported datagram engine: %s", engineName(engine));
+        return;
+    }
+
+    auto newEngine = createEngine(engine, this);
+
+    if (!newEngine) {
+        qCWarning(lcMulticast, "Could not create datagram engine: %s", engineName(engine));
+        return;
+    }
+
+    // the sockets of the old engine must be gone before the engine itself
+    resetSockets();
+    delete std::exchange(m_engine, newEngine.release());
+    connectEngine();
+
+    m_engineType = engine;
+    emit engineChanged(m_engineType);
+}
+
+bool MulticastResolver::isSupportedEngine(Engine engine)
+{
+    switch (engine) {
+    case Engine::Qt:
+        return true;
+
+    case Engine::IoUring:
+        return UringDatagramEngine::isSupported();
+    }
+
+    return false;
+}
+
+int MulticastResolver::receiveBufferSize() const
+{
+    return m_receiveBufferSize;
+}
+
+void MulticastResolver::setReceiveBufferSize(int size)
+{
+    size = std::max(size, 0);
+
+    if (std::exchange(m_receiveBufferSize, size) == size)
+        return;
+
+    if (size > 0) {
+        const auto &sockets = socketsAndListeners();
+
+        for (const auto &socket : sockets) {
+            if (const auto transport = sharedTransport(socket))
+                transport->setReceiveBufferSize(size);
+            else
+                m_engine->setReceiveBufferSize(socket, size);
+        }
+    } else if (!sockets().isEmpty()) {
+        // the system's default cannot be restored on open sockets, so they get replaced
+        resetSockets();
+    }
+
+    emit receiveBufferSizeChanged(m_receiveBufferSize);
+}
+
+quint64 MulticastResolver::droppedDatagrams() const
+{
+    return m_droppedDatagrams;
+}
+
+bool MulticastResolver::isOverloaded() const
+{
+    return m_overloaded;
+}
+
+int MulticastResolver::decoderThreadCount() const
+{
+    if (m_decoderPool)
+        return m_decoderPool->threadCount();
+
+    return 0;
+}
+
+void MulticastResolver::setDecoderThreadCount(int count)
+{
+    count = std::max(count, 0);
+
+    if (decoderThreadCount() == count)
+        return;
+
+    if (!m_decoder)
+        m_decoder = createDecoder();
+
+    // results of the previous pool that are still queued get applied nevertheless
+    m_decoderPool.reset();
+
+    if (count > 0)
+        m_decoderPool = std::make_unique<DecoderPool>(count, m_decoder, this);
+
+    emit decoderThreadCountChanged(count);
+}
+
+void MulticastResolver::stopDecoders()
+{
+    m_decoderPool.reset();
+}
+
+int MulticastResolver::batchInterval() const
+{
+    return m_batchTimer->interval();
+}
+
+void MulticastResolver::setBatchInterval(int ms)
+{
+    ms = std::max(ms, 0);
+
+    if (m_batchTimer->interval() == ms)
+        return;
+
+    m_batchTimer->setInterval(ms);
+    emit batchIntervalChanged(m_batchTimer->interval());
+}
+
+int MulticastResolver::batchSize() const
+{
+    return m_batchSize;
+}
+
+void MulticastResolver::setBatchSize(int size)
+{
+    size = std::max(size, 1);
+
+    if (std::exchange(m_batchSize, size) == size)
+        return;
+
+    emit batchSizeChanged(m_batchSize);
+}
+
+int MulticastResolver::duplicateWindow() const
+{
+    return static_cast<int>(m_duplicateFilter.window().count());
+}
+
+void MulticastResolver::setDuplicateWindow(int ms)
+{
+    ms = std::max(ms, 0);
+
+    if (duplicateWindow() == ms)
+        return;
+
+    m_duplicateFilter.setWindow(std::chrono::milliseconds{ms});
+    emit duplicateWindowChanged(duplicateWindow());
+}
+
+bool MulticastResolver::isSharedTransport() const
+{
+    return m_sharedTransport;
+}
+
+void MulticastResolver::setSharedTransport(bool shared)
+{
+    if (std::exchange(m_sharedTransport, shared) == shared)
+        return;
+
+    resetSockets();
+    emit sharedTransportChanged(m_sharedTransport);
+}
+
+bool MulticastResolver::isPassiveListening() const
+{
+    return m_passiveListening;
+}
+
+void MulticastResolver::setPassiveListening(bool passive)
+{
+    if (std::exchange(m_passiveListening, passive) == passive)
+        return;
+
+    resetSockets();
+    emit passiveListeningChanged(m_passiveListening);
+}
+
+QString MulticastResolver::cacheFileName() const
+{
+    if (m_cache)
+        return m_cache->fileName();
+
+    return {};
+}
+
+void MulticastResolver::setCacheFileName(const QString &fileName)
+{
+    if (cacheFileName() == fileName)
+        return;
+
+    m_cache.reset();
+
+    if (!fileName.isEmpty()) {
+        m_cache = std::make_unique<WarmCache>(fileName);
+
+        // give the owner a chance to connect signals after constructing this resolver
+        QMetaObject::invokeMethod(this, [this, cache = m_cache.get()] {
+            if (m_cache.get() == cache)
+                replayCache();
+        }, Qt::QueuedConnection);
+    }
+
+    m_caching.store(m_cache != nullptr);
+    emit cacheFileNameChanged(cacheFileName());
+}
+
+int MulticastResolver::queryRate() const
+{
+    return m_queryRate;
+}
+
+void MulticastResolver::setQueryRate(int rate)
+{
+    rate = std::max(rate, 0);
+
+    if (std::exchange(m_queryRate, rate) == rate)
+        return;
+
+    m_interfaceBuckets.clear();
+    sendPendingQueries();
+
+    emit queryRateChanged(m_queryRate);
+}
+
+int MulticastResolver::totalQueryRate() const
+{
+    return m_totalBucket.rate();
+}
+
+void MulticastResolver::setTotalQueryRate(int rate)
+{
+    rate = std::max(rate, 0);
+
+    if (m_totalBucket.rate() == rate)
+        return;
+
+    m_totalBucket = TokenBucket{rate, rate};
+    sendPendingQueries();
+
+    emit totalQueryRateChanged(totalQueryRate());
+}
+
+bool MulticastResolver::isStaleService(const QString &name) const
+{
+    return m_staleServices.contains(name);
+}
+
+void MulticastResolver::replayCache()
+{
+    const auto &entries = m_cache->load();
+
+    if (entries.isEmpty())
+        return;
+
+    qCDebug(lcMulticast, "Replaying %lld cached datagrams", static_cast<qint64>(entries.size()));
+
+    if (!m_decoder)
+        m_decoder = createDecoder();
+
+    for (const auto &entry : entries) {
+        m_replayExpiry = entry.expiry;
+        m_replayReceived = entry.received;
+
+        if (const auto apply = m_decoder(entry.datagram))
+            apply();
+    }
+
+    m_replayExpiry = {};
+    m_replayReceived = {};
+}
+
+void MulticastResolver::setDatagramExpiry(const QDateTime &expiry, const QString &serviceName)
+{
+    if (!m_datagramExpiry.isValid() || expiry < m_datagramExpiry)
+        m_datagramExpiry = expiry;
+    if (!serviceName.isEmpty() && !m_datagramKeys.contains(serviceName))
+        m_datagramKeys += serviceName;
+}
+
+QDateTime MulticastResolver::receivedTime(const QDateTime &now) const
+{
+    if (m_replayReceived.isValid())
+        return m_replayReceived;
+
+    return now;
+}
+
+void MulticastResolver::storeDatagram(const QNetworkDatagram &datagram, const QDateTime &expiry,
+                                      const QStringList &keys)
+{
+    // replayed datagrams already are in the cache
+    if (!m_cache || m_replayExpiry.isValid())
+        return;
+
+    if (const auto now = QDateTime::currentDateTimeUtc(); expiry.isValid() && expiry > now)
+        m_cache->store(datagram, expiry, keys, now);
+}
+
+void MulticastResolver::expireStaleServices(const QList<QString> &names)
+{
+    for (const auto &name : names) {
+        // a replayed service that was not seen again is gone, just like an expired one
+        m_serviceExpiries.remove(name);
+        expireService(name);
+        emit cachedServiceExpired(name);
+    }
+}
+
+QList<ServiceIdentity> MulticastResolver::serviceIdentities() const
+{
+    return m_identities.values();
+}
+
+void MulticastResolver::observeService(const QString &name, int interfaceIndex,
+                                       const QHostAddress &address, const QDateTime &expiry)
+{
+    if (m_replayExpiry.isValid()) {
+        // a replayed service is stale until seen again, but not longer than its cached datagram lives
+        m_staleServices.insert(name, m_replayExpiry);
+    } else if (m_staleServices.remove(name)) {
+        emit cachedServiceConfirmed(name);
+    }
+
+    m_serviceExpiries.insert(name, expiry);
+
+    if (!isSignalConnected(QMetaMethod::fromSignal(&MulticastResolver::serviceIdentityChanged)))
+        return;
+
+    auto it = m_identities.find(name);
+    const auto isNewService = (it == m_identities.end());
+
+    if (isNewService)
+        it = m_identities.insert(name, ServiceIdentity{name});
+
+    const auto hasChanged = it->observe(interfaceIndex, address, expiry);
+
+    if (isNewService || hasChanged)
+        emit serviceIdentityChanged(*it);
+}
+
+void MulticastResolver::observeSender(int interfaceIndex, const QHostAddress &address)
+{
+    for (auto &identity : m_identities) {
+        if (identity.addresses().contains(address)
+                && identity.observe(interfaceIndex, address, identity.expiry()))
+            emit serviceIdentityChanged(identity);
+    }
+}
+
+void MulticastResolver::forgetService(const QString &name)
+{
+    m_serviceExpiries.remove(name);
+    m_staleServices.remove(name);
+
+    // without a tombstone the service would be replayed after restarting
+    if (m_cache && !m_replayExpiry.isValid())
+        m_cache->remove(name);
+
+    if (m_identities.remove(name) > 0)
+        emit serviceIdentityLost(name);
+}
+
+void MulticastResolver::expireService(const QString &name)
+{
+    if (m_identities.remove(name) > 0)
+        emit serviceIdentityLost(name);
+}
+
+void MulticastResolver::scheduleBatchDelivery(qsizetype pendingCount)
+{
+    if (pendingCount >= m_batchSize) {
+        m_batchTimer->stop();
+        deliverBatches();
+    } else if (pendingCount > 0 && !m_batchTimer->isActive()) {
+        m_batchTimer->start();
+    }
+}
+
+void MulticastResolver::deliverBatches()
+{
+}
+
+void MulticastResolver::connectEngine()
+{
+    connect(m_engine, &DatagramEngine::datagramReceived, this, &MulticastResolver::onDatagramReceived);
+    connect(m_engine, &DatagramEngine::datagramsDropped, this, &MulticastResolver::onDatagramsDropped);
+}
+
 bool MulticastResolver::isSupportedInterface(const QNetworkInterface &iface) const
 {
     return isSupportedInterfaceType(iface)
@@ -68,7 +529,18 @@ bool MulticastResolver::isLinkLocalAddress(const QHostAddress &address)
 bool MulticastResolver::addQuery(QByteArray &&query)
 {
     if (!m_queries.contains(query)) {
+        const auto wasScanning = isScanning();
+
         m_queries.append(std::move(query));
+        updateSocketFilters();
+        updateScanning();
+
+        // new queries don't wait for the next scan, which happens immediately when resuming
+        if (wasScanning) {
+            enqueueQueries(m_newQueries, sockets(), {m_queries.constLast()});
+            sendPendingQueries();
+        }
+
         return true;
     }
 
@@ -78,75 +550,383 @@ bool MulticastResolver::addQuery(QByteArray &&query)
 MulticastResolver::SocketPointer
 MulticastResolver::createSocket(const QNetworkInterface &iface, const QHostAddress &address)
 {
-    auto socket = std::make_shared<QUdpSocket>(this);
+    m_interfaceIndices.insert(address, iface.index());
 
-    const auto &bindAddress = wildcardAddress(address);
-    const auto &bindMode = QUdpSocket::ShareAddress | QUdpSocket::ReuseAddressHint;
-    constexpr auto randomPort = 0;
+    auto socket = openSocket(iface, address, 0);
 
-    if (!socket->bind(bindAddress, randomPort, bindMode)) {
-        qCWarning(lcMulticast, "Could not bind multicast socket to %ls: %ls",
-                  qUtf16Printable(address.toString()),
-                  qUtf16Printable(socket->errorString()));
-        return nullptr;
+    if (!socket || !m_passiveListening)
+        return socket;
+
+    auto listener = openSocket(iface, address, port());
+
+    if (!listener) {
+        qCWarning(lcMulticast, "Could not listen on port %d of %ls",
+                  port(), qUtf16Printable(address.toString()));
+        return socket;
     }
 
-    const auto &group = multicastGroup(address);
+    m_listeners.append(listener);
+
+    // the listener lives as long as the socket used for sending queries
+    const auto sockets = std::make_shared<std::array<SocketPointer, 2>>();
+    (*sockets)[0] = socket;
+    (*sockets)[1] = std::move(listener);
+
+    return SocketPointer{sockets, socket.get()};
+}
+
+MulticastResolver::SocketPointer
+MulticastResolver::openSocket(const QNetworkInterface &iface, const QHostAddress &address, quint16 bindPort)
+{
+    if (m_sharedTransport)
+        return acquireSharedTransport(iface, address, bindPort);
 
-    if (socket->joinMulticastGroup(group, iface)) {
-        qCDebug(lcMulticast, "Multicast group %ls joined on %ls",
-                qUtf16Printable(group.toString()),
-                qUtf16Printable(iface.humanReadableName()));
-    } else if (socket->error() != QUdpSocket::UnknownSocketError) {
-        qCWarning(lcMulticast, "Could not join multicast group %ls on %ls: %ls",
-                  qUtf16Printable(group.toString()),
-                  qUtf16Printable(iface.name()),
-                  qUtf16Printable(socket->errorString()));
+    auto socket = m_engine->createSocket(iface, address, multicastGroup(address), bindPort);
+
+    if (!socket)
         return nullptr;
-    }
 
-    connect(socket.get(), &QUdpSocket::readyRead,
-            this, [this, socket = socket.get()] {
-        onDatagramReceived(socket);
+    if (m_receiveBufferSize > 0)
+        m_engine->setReceiveBufferSize(socket, m_receiveBufferSize);
+    if (SocketFilter::isSupported())
+        socketFilter().attach(m_engine->socketDescriptor(socket));
+
+    return socket;
+}
+
+MulticastResolver::SocketPointer
+MulticastResolver::acquireSharedTransport(const QNetworkInterface &iface,
+                                          const QHostAddress &address, quint16 bindPort)
+{
+    const auto engineType = m_engineType;
+    const auto key = SharedTransport::Key{qToUnderlying(engineType), multicastGroup(address),
+                                          port(), iface.index(), address, bindPort};
+
+    const auto transport = SharedTransport::acquire(key, iface, [engineType] {
+        return createEngine(engineType, nullptr);
     });
 
-    socket->setMulticastInterface(iface);
-    socket->setSocketOption(QUdpSocket::MulticastTtlOption, 4);
+    if (!transport)
+        return nullptr;
 
-    return socket;
+    if (m_receiveBufferSize > 0)
+        transport->setReceiveBufferSize(m_receiveBufferSize);
+
+    const auto connections = std::array{
+        connect(transport.get(), &SharedTransport::datagramReceived,
+                this, &MulticastResolver::onDatagramReceived),
+        connect(transport.get(), &SharedTransport::datagramsDropped,
+                this, &MulticastResolver::onDatagramsDropped),
+    };
+
+    // each resolver gets its own handle, so that it stops receiving once it drops the socket
+    return SocketPointer{transport.get(), [transport, connections](QObject *) {
+        for (const auto &connection : connections)
+            QObject::disconnect(connection);
+    }};
 }
 
 void MulticastResolver::submitQueries(const SocketTable &sockets)
 {
+    pruneInterfaces();
+    enqueueQueries(m_repeatedQueries, sockets, m_queries);
+    sendPendingQueries();
+}
+
+void MulticastResolver::pruneInterfaces()
+{
+    const auto &sockets = this->sockets();
+    auto interfaces = QSet<int>{};
+
+    // forget the addresses and interfaces that are gone since the last scan
+    for (auto it = m_interfaceIndices.begin(); it != m_interfaceIndices.end(); ) {
+        if (!sockets.contains(it.key())) {
+            it = m_interfaceIndices.erase(it);
+        } else {
+            interfaces.insert(it.value());
+            ++it;
+        }
+    }
+
+    for (auto it = m_interfaceBuckets.begin(); it != m_interfaceBuckets.end(); ) {
+        if (!interfaces.contains(it.key()))
+            it = m_interfaceBuckets.erase(it);
+        else
+            ++it;
+    }
+}
+
+void MulticastResolver::enqueueQueries(QList<PendingQuery> &queue, const SocketTable &sockets,
+                                       const QByteArrayList &queries)
+{
+    const auto now = TokenBucket::clock::now();
+    const auto jitter = static_cast<int>(queryJitter().count());
+
     for (auto it = sockets.cbegin(); it != sockets.cend(); ++it) {
-        Q_ASSERT(dynamic_cast<QUdpSocket *>(it->get()));
+        const auto delay = jitter > 0 ? QRandomGenerator::global()->bounded(jitter + 1) : 0;
+        const auto due = now + std::chrono::milliseconds{delay};
 
-        const auto &address = it.key();
-        const auto socket = static_cast<QUdpSocket *>(it->get());
-        const auto group = multicastGroup(address);
+        for (const auto &query : queries) {
+            auto pending = PendingQuery{it.key(), query, due};
 
-        for (const auto &data: m_queries) {
-            const auto query = finalizeQuery(address, data);
-            socket->writeDatagram(query, group, port());
+            // a query still waiting to be sent doesn't need to be sent twice
+            if (!m_newQueries.contains(pending) && !m_repeatedQueries.contains(pending))
+                queue.append(std::move(pending));
         }
     }
 }
 
+void MulticastResolver::sendPendingQueries()
+{
+    const auto now = TokenBucket::clock::now();
+    auto delay = TokenBucket::clock::duration::max();
+    auto hasSent = false;
+
+    // new queries go first, so that they don't wait for repeated ones
+    for (const auto queue : {&m_newQueries, &m_repeatedQueries}) {
+        for (auto it = queue->begin(); it != queue->end(); ) {
+            const auto socket = socketForAddress(it->address);
+
+            if (!socket) {
+                it = queue->erase(it); // the address is gone meanwhile
+                continue;
+            }
+
+            if (it->due > now) {
+                delay = std::min(delay, it->due - now);
+                ++it;
+                continue;
+            }
+
+            if (const auto totalDelay = m_totalBucket.delay(now); totalDelay > TokenBucket::clock::duration::zero()) {
+                delay = std::min(delay, totalDelay);
+                break;
+            }
+
+            const auto interfaceIndex = m_interfaceIndices.value(it->address);
+            auto bucket = m_interfaceBuckets.find(interfaceIndex);
+
+            if (bucket == m_interfaceBuckets.end())
+                bucket = m_interfaceBuckets.insert(interfaceIndex, TokenBucket{m_queryRate, m_queryRate});
+
+            if (!bucket->take(now)) {
+                delay = std::min(delay, bucket->delay(now));
+                ++it;
+                continue;
+            }
+
+            m_totalBucket.take(now);
+            writeQuery(it->address, socket, it->query);
+            it = queue->erase(it);
+            hasSent = true;
+        }
+    }
+
+    if (hasSent)
+        m_engine->flush();
+
+    if (!m_newQueries.isEmpty() || !m_repeatedQueries.isEmpty())
+        m_pacingTimer->start(std::chrono::ceil<std::chrono::milliseconds>(delay));
+}
+
+void MulticastResolver::writeQuery(const QHostAddress &address, const SocketPointer &socket,
+                                   const QByteArray &query)
+{
+    const auto datagram = finalizeQuery(address, query);
+
+    if (const auto transport = sharedTransport(socket))
+        transport->writeDatagram(datagram, multicastGroup(address), port());
+    else
+        m_engine->writeDatagram(socket, datagram, multicastGroup(address), port());
+}
+
+bool MulticastResolver::writeUnicastDatagram(const QByteArray &data, const QHostAddress &address,
+                                             quint16 port, int interfaceIndex)
+{
+    auto socket = SocketPointer{};
+    const auto &table = sockets();
+
+    for (auto it = table.cbegin(); it != table.cend(); ++it) {
+        if (it.key().protocol() != address.protocol())
+            continue;
+
+        socket = it.value();
+
+        if (interfaceIndex <= 0 || m_interfaceIndices.value(it.key()) == interfaceIndex)
+            break;
+    }
+
+    if (!socket)
+        return false;
+
+    if (const auto transport = sharedTransport(socket)) {
+        transport->writeDatagram(data, address, port);
+    } else {
+        m_engine->writeDatagram(socket, data, address, port);
+        m_engine->flush();
+    }
+
+    return true;
+}
+
+SocketFilter MulticastResolver::socketFilter() const
+{
+    return {};
+}
+
+bool MulticastResolver::isScanningNeeded() const
+{
+    return !m_queries.isEmpty() && hasSubscribers();
+}
+
+bool MulticastResolver::hasSubscribers() const
+{
+    return isSignalConnected(QMetaMethod::fromSignal(&MulticastResolver::serviceIdentityChanged))
+            || isSignalConnected(QMetaMethod::fromSignal(&MulticastResolver::serviceIdentityLost));
+}
+
+void MulticastResolver::connectNotify(const QMetaMethod &signal)
+{
+    // subclasses might update their state after calling this function
+    QMetaObject::invokeMethod(this, [this] { updateScanning(); }, Qt::QueuedConnection);
+    AbstractResolver::connectNotify(signal);
+}
+
+void MulticastResolver::disconnectNotify(const QMetaMethod &signal)
+{
+    // the connection might still be counted at this point
+    QMetaObject::invokeMethod(this, [this] { updateScanning(); }, Qt::QueuedConnection);
+    AbstractResolver::disconnectNotify(signal);
+}
+
+void MulticastResolver::updateSocketFilters()
+{
+    if (!SocketFilter::isSupported())
+        return;
+
+    const auto &filter = socketFilter();
+    const auto &sockets = socketsAndListeners();
+
+    for (const auto &socket : sockets) {
+        // other resolvers sharing the socket might need different messages
+        if (!sharedTransport(socket))
+            filter.attach(m_engine->socketDescriptor(socket));
+    }
+}
+
+QList<MulticastResolver::SocketPointer> MulticastResolver::socketsAndListeners()
+{
+    auto sockets = this->sockets().values();
+
+    // listeners are owned by the sockets used for sending queries, and vanish with them
+    m_listeners.erase(std::remove_if(m_listeners.begin(), m_listeners.end(),
+                                     [](const std::weak_ptr<QObject> &listener) {
+        return listener.expired();
+    }), m_listeners.end());
+
+    for (const auto &listener : std::as_const(m_listeners)) {
+        if (auto socket = listener.lock())
+            sockets.append(std::move(socket));
+    }
+
+    return sockets;
+}
+
 QByteArray MulticastResolver::finalizeQuery(const QHostAddress &/*address*/, const QByteArray &query) const
 {
     return query;
 }
 
-void MulticastResolver::onDatagramReceived(QUdpSocket *socket)
+std::chrono::milliseconds MulticastResolver::queryJitter() const
+{
+    return std::chrono::milliseconds::zero();
+}
+
+void MulticastResolver::onDatagramReceived(const QNetworkDatagram &datagram)
 {
-    while (socket->hasPendingDatagrams()) {
-        const auto datagram = socket->receiveDatagram();
+    if (isOwnMessage(datagram))
+        return;
+
+    switch (m_duplicateFilter.check(datagram)) {
+    case DuplicateFilter::Verdict::Unique:
+        break;
+
+    case DuplicateFilter::Verdict::Repeated:
+        return;
+
+    case DuplicateFilter::Verdict::ViaOtherInterface:
+        // the copy only tells that the sender also is reachable via this interface
+        observeSender(static_cast<int>(datagram.interfaceIndex()), datagram.senderAddress());
+        return;
+    }
 
-        if (!isOwnMessage(datagram))
-            processDatagram(datagram);
+    if (m_decoderPool) {
+        // shed load like the kernel does if the decoders cannot keep up
+        if (!m_decoderPool->decode(datagram))
+            onDatagramsDropped(1);
+    } else {
+        processDatagram(datagram);
     }
 }
 
+void MulticastResolver::processDatagram(const QNetworkDatagram &datagram)
+{
+    // the decoder cannot be created in the constructor, as it is provided by subclasses
+    if (!m_decoder)
+        m_decoder = createDecoder();
+
+    if (const auto apply = m_decoder(datagram))
+        apply();
+}
+
+MulticastResolver::DatagramDecoder MulticastResolver::createDecoder()
+{
+    return [this, decoder = datagramDecoder()](const QNetworkDatagram &datagram) -> DecodedDatagram {
+        auto apply = decoder(datagram);
+
+        // this might run in a worker thread, only atomic state must be accessed here
+        if (!apply || !m_caching.load(std::memory_order_relaxed))
+            return apply;
+
+        return [this, apply = std::move(apply), datagram] {
+            m_datagramExpiry = {};
+            m_datagramKeys.clear();
+            apply();
+            storeDatagram(datagram, std::exchange(m_datagramExpiry, {}), std::exchange(m_datagramKeys, {}));
+        };
+    };
+}
+
+void MulticastResolver::onDatagramsDropped(quint64 count)
+{
+    qCDebug(lcMulticast, "%llu datagrams got dropped", count);
+
+    m_droppedDatagrams += count;
+    m_recentDrops += count;
+    m_overloadTimer->start();
+
+    if (m_recentDrops >= s_overloadThreshold)
+        setOverloaded(true);
+
+    emit droppedDatagramsChanged(m_droppedDatagrams);
+}
+
+void MulticastResolver::setOverloaded(bool overloaded)
+{
+    if (std::exchange(m_overloaded, overloaded) == overloaded)
+        return;
+
+    if (overloaded)
+        qCWarning(lcMulticast, "Receive buffers are overflowing, ignoring unsolicited messages for now");
+    else
+        qCInfo(lcMulticast, "Receive buffers have recovered, processing all messages again");
+
+    // subclasses use stricter socket filters while overloaded
+    updateSocketFilters();
+
+    emit overloadedChanged(m_overloaded);
+}
+
 bool MulticastResolver::isOwnMessage(const QNetworkDatagram &message) const
 {
     if (message.senderPort() != port())
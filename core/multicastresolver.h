@@ -5,18 +5,157 @@
 #define QNCCORE_UNICASTRESOLVER_H
 
 #include "abstractresolver.h"
+#include "duplicatefilter.h"
+#include "expirytable.h"
+#include "serviceidentity.h"
+#include "socketfilter.h"
+#include "tokenbucket.h"
+
+// STL headers
+#include <atomic>
+#include <functional>
+#include <memory>
 
 class QNetworkDatagram;
-class QUdpSocket;
+class QTimer;
 
 namespace qnc::core {
 
+class DatagramEngine;
+class DecoderPool;
+class WarmCache;
+
 class MulticastResolver : public AbstractResolver
 {
     Q_OBJECT
+    Q_PROPERTY(Engine engine READ engine WRITE setEngine NOTIFY engineChanged FINAL)
+    Q_PROPERTY(int receiveBufferSize READ receiveBufferSize WRITE setReceiveBufferSize NOTIFY receiveBufferSizeChanged FINAL)
+    Q_PROPERTY(quint64 droppedDatagrams READ droppedDatagrams NOTIFY droppedDatagramsChanged FINAL)
+    Q_PROPERTY(bool overloaded READ isOverloaded NOTIFY overloadedChanged FINAL)
+    Q_PROPERTY(int decoderThreadCount READ decoderThreadCount WRITE setDecoderThreadCount NOTIFY decoderThreadCountChanged FINAL)
+    Q_PROPERTY(int batchInterval READ batchInterval WRITE setBatchInterval NOTIFY batchIntervalChanged FINAL)
+    Q_PROPERTY(int batchSize READ batchSize WRITE setBatchSize NOTIFY batchSizeChanged FINAL)
+    Q_PROPERTY(int duplicateWindow READ duplicateWindow WRITE setDuplicateWindow NOTIFY duplicateWindowChanged FINAL)
+    Q_PROPERTY(bool sharedTransport READ isSharedTransport WRITE setSharedTransport NOTIFY sharedTransportChanged FINAL)
+    Q_PROPERTY(bool passiveListening READ isPassiveListening WRITE setPassiveListening NOTIFY passiveListeningChanged FINAL)
+    Q_PROPERTY(QString cacheFileName READ cacheFileName WRITE setCacheFileName NOTIFY cacheFileNameChanged FINAL)
+    Q_PROPERTY(int queryRate READ queryRate WRITE setQueryRate NOTIFY queryRateChanged FINAL)
+    Q_PROPERTY(int totalQueryRate READ totalQueryRate WRITE setTotalQueryRate NOTIFY totalQueryRateChanged FINAL)
 
 public:
-    using AbstractResolver::AbstractResolver;
+    enum class Engine {
+        Qt,         // QUdpSocket, available everywhere
+        IoUring,    // io_uring, requires Linux 6.0
+    };
+
+    Q_ENUM(Engine)
+
+    explicit MulticastResolver(QObject *parent = nullptr);
+    ~MulticastResolver() override;
+
+    [[nodiscard]] Engine engine() const;
+    void setEngine(Engine engine);
+
+    [[nodiscard]] static bool isSupportedEngine(Engine engine);
+
+    // The receive buffer size of the sockets in bytes, or 0 to keep the system's default.
+    // Resetting this to 0 reopens the sockets. Shared transports keep the largest size
+    // requested by any of their resolvers.
+    [[nodiscard]] int receiveBufferSize() const;
+    void setReceiveBufferSize(int size);
+
+    // Datagrams the kernel had to drop, because they arrived faster than processed.
+    [[nodiscard]] quint64 droppedDatagrams() const;
+
+    // Datagrams get dropped continuously: Only responses to active queries
+    // get processed now, until no datagrams got dropped for a while.
+    [[nodiscard]] bool isOverloaded() const;
+
+    // The number of worker threads decoding received datagrams, or 0 to decode
+    // them in the resolver's thread. Datagrams of the same sender always get
+    // decoded by the same worker, so that their results keep their order.
+    [[nodiscard]] int decoderThreadCount() const;
+    void setDecoderThreadCount(int count);
+
+    // Results of batched signals, like servicesFound(), get collected for this many
+    // milliseconds; 0 delivers them once per iteration of the event loop. Results
+    // only get collected while the batched signals are connected.
+    [[nodiscard]] int batchInterval() const;
+    void setBatchInterval(int ms);
+
+    // Collected results get delivered immediately once this many are pending.
+    [[nodiscard]] int batchSize() const;
+    void setBatchSize(int size);
+
+    // Identical datagrams received from the same sender within this many milliseconds,
+    // like retransmissions or copies received by several sockets or interfaces, get
+    // dropped before decoding them; 0 disables this. Copies received via other interfaces
+    // still add that interface to the serviceIdentities() of the sender, and copies via
+    // the other address family still get decoded.
+    [[nodiscard]] int duplicateWindow() const;
+    void setDuplicateWindow(int ms);
+
+    // Shares sockets with all other resolvers of this thread that also use shared
+    // transports, and that use the same engine, multicast group and port. Kernel-side
+    // socket filters are not used for shared sockets, as the resolvers sharing them
+    // might be interested in different messages.
+    [[nodiscard]] bool isSharedTransport() const;
+    void setSharedTransport(bool shared);
+
+    // Also listens on the protocol's well-known port, shared with other processes, so
+    // that unsolicited announcements and goodbyes get received, not only the responses
+    // to this resolver's queries. Consider a longer scanInterval() in that case.
+    [[nodiscard]] bool isPassiveListening() const;
+    void setPassiveListening(bool passive);
+
+    // A file in which the datagrams that provided results get stored. When set, the
+    // stored datagrams get replayed once the event loop runs, so that the results
+    // of the previous run get reported immediately. Services reported this way are
+    // stale until they are seen again; cachedServiceExpired() is emitted otherwise.
+    [[nodiscard]] QString cacheFileName() const;
+    void setCacheFileName(const QString &fileName);
+
+    [[nodiscard]] bool isStaleService(const QString &name) const;
+
+    // The number of queries per second sent on each network interface, or 0 to send
+    // them without delay. Queries exceeding this rate get spread over time, and queries
+    // that were just added get sent before queries that just get repeated.
+    [[nodiscard]] int queryRate() const;
+    void setQueryRate(int rate);
+
+    // The number of queries per second sent on all network interfaces together,
+    // or 0 to not limit them beyond queryRate().
+    [[nodiscard]] int totalQueryRate() const;
+    void setTotalQueryRate(int rate);
+
+    // The services seen so far, merged across network interfaces and address
+    // families. Services are only tracked while serviceIdentityChanged() is connected.
+    [[nodiscard]] QList<ServiceIdentity> serviceIdentities() const;
+
+signals:
+    void engineChanged(qnc::core::MulticastResolver::Engine engine);
+    void receiveBufferSizeChanged(int size);
+    void droppedDatagramsChanged(quint64 count);
+    void overloadedChanged(bool overloaded);
+    void decoderThreadCountChanged(int count);
+    void batchIntervalChanged(int interval);
+    void batchSizeChanged(int size);
+    void duplicateWindowChanged(int window);
+    void sharedTransportChanged(bool shared);
+    void passiveListeningChanged(bool passive);
+    void cacheFileNameChanged(const QString &fileName);
+    void queryRateChanged(int rate);
+    void totalQueryRateChanged(int rate);
+
+    // a service was seen for the first time, or on another interface, or from another address
+    void serviceIdentityChanged(const qnc::core::ServiceIdentity &identity);
+    // a service said goodbye, or its lifetime has expired
+    void serviceIdentityLost(const QString &name);
+
+    // a service reported from the cache was seen again
+    void cachedServiceConfirmed(const QString &name);
+    // a service reported from the cache was not seen again before its cached datagram expired
+    void cachedServiceExpired(const QString &name);
 
 protected:
     [[nodiscard]] bool isSupportedInterface(const QNetworkInterface &iface) const override;
@@ -27,23 +166,153 @@ protected:
 
     void submitQueries(const SocketTable &sockets) override;
 
+    // Scanning is needed once there are queries, and somebody listens for results.
+    [[nodiscard]] bool isScanningNeeded() const override;
+    // Returns true if any signal reporting results is connected.
+    [[nodiscard]] virtual bool hasSubscribers() const;
+
+    void connectNotify(const QMetaMethod &signal) override;
+    void disconnectNotify(const QMetaMethod &signal) override;
+
     [[nodiscard]] virtual quint16 port() const = 0;
     [[nodiscard]] virtual QHostAddress multicastGroup(const QHostAddress &address) const = 0;
     [[nodiscard]] virtual QByteArray finalizeQuery(const QHostAddress &address, const QByteArray &query) const;
 
-    virtual void processDatagram(const QNetworkDatagram &message) = 0;
+    // Queries get delayed by a random time up to this value, different for each network
+    // interface, so that the responses of all interfaces don't arrive at the same time.
+    [[nodiscard]] virtual std::chrono::milliseconds queryJitter() const;
+
+    [[nodiscard]] virtual SocketFilter socketFilter() const;
+
+    using DecodedDatagram = std::function<void()>;
+    using DatagramDecoder = std::function<DecodedDatagram(const QNetworkDatagram &)>;
+
+    // Returns a function that parses datagrams, and which returns functions that apply
+    // the parsed information to this resolver. The decoder might be called from worker
+    // threads and therefore must not access the resolver, except for atomic state; only
+    // the functions it returns get called from the resolver's thread.
+    [[nodiscard]] virtual DatagramDecoder datagramDecoder() = 0;
 
     [[nodiscard]] static bool isSupportedInterfaceType(const QNetworkInterface &iface);
     [[nodiscard]] static bool isMulticastInterface(const QNetworkInterface &iface);
     [[nodiscard]] static bool isLinkLocalAddress(const QHostAddress &address);
 
     bool addQuery(QByteArray &&query);
+    [[nodiscard]] QByteArrayList queries() const { return m_queries; }
+
+    // Sends data directly to address, instead of to the multicast group, using the socket
+    // of the network interface with the given index, or any socket of the address' family
+    // if that interface is unknown. Such datagrams are not paced. Returns false if no
+    // suitable socket exists, for instance because scanning is paused.
+    bool writeUnicastDatagram(const QByteArray &data, const QHostAddress &address,
+                              quint16 port, int interfaceIndex = 0);
+
+    // Called whenever the criteria for relevant messages change, like the queries,
+    // or the overload state. Subclasses with additional filters update them here.
+    virtual void updateSocketFilters();
+
+    // The sockets used for sending queries, and the listeners of passive listening.
+    [[nodiscard]] QList<SocketPointer> socketsAndListeners();
+
+    // Schedules deliverBatches(), or calls it immediately if pendingCount reached batchSize().
+    void scheduleBatchDelivery(qsizetype pendingCount);
+    virtual void deliverBatches();
+
+    // Called by the functions returned by datagramDecoder() to tell until when the applied
+    // datagram stays valid for the named service, so that it gets cached for that long.
+    // The earliest expiry of a datagram wins, so that replaying it doesn't revive records
+    // that expired meanwhile. Datagrams without expiry, like goodbyes, are not cached.
+    void setDatagramExpiry(const QDateTime &expiry, const QString &serviceName = {});
+
+    // Tells when the applied datagram was received: the time it was cached if it
+    // is replayed from the cache, and otherwise now.
+    [[nodiscard]] QDateTime receivedTime(const QDateTime &now) const;
+
+    // Merges an observation of the named service, received via the network interface
+    // with the given index from address, into the service's identity.
+    void observeService(const QString &name, int interfaceIndex,
+                        const QHostAddress &address, const QDateTime &expiry);
+    // Drops what is known about a service that said goodbye, including its cached
+    // datagrams. Subclasses remove their own records of it themselves.
+    void forgetService(const QString &name);
+
+    // Called when the lifetime of a service observed by observeService() has expired,
+    // for instance because its device lost power, or when a service replayed from the
+    // cache was not seen again before its cached datagram expired. Subclasses that keep
+    // records of their services drop them here, so that all share the same expiry table.
+    virtual void expireService(const QString &name);
+
+    // Handles a datagram received by one of the sockets: drops own messages and
+    // duplicates, and then decodes it, either directly or by the decoder pool.
+    void onDatagramReceived(const QNetworkDatagram &datagram);
+
+    // Joins the decoder threads. Subclasses call this first when destroyed,
+    // as the decoders they provide might read their state until then.
+    void stopDecoders();
 
 private:
-    void onDatagramReceived(QUdpSocket *socket);
+    void connectEngine();
+    [[nodiscard]] SocketPointer openSocket(const QNetworkInterface &iface,
+                                           const QHostAddress &address, quint16 bindPort);
+    [[nodiscard]] SocketPointer acquireSharedTransport(const QNetworkInterface &iface,
+                                                       const QHostAddress &address, quint16 bindPort);
+    void onDatagramsDropped(quint64 count);
+    void setOverloaded(bool overloaded);
+    void processDatagram(const QNetworkDatagram &datagram);
+    [[nodiscard]] DatagramDecoder createDecoder();
+    void replayCache();
+    void storeDatagram(const QNetworkDatagram &datagram, const QDateTime &expiry, const QStringList &keys);
+    void expireStaleServices(const QList<QString> &names);
+    void observeSender(int interfaceIndex, const QHostAddress &address);
     bool isOwnMessage(const QNetworkDatagram &message) const;
 
-    QByteArrayList m_queries;
+    struct PendingQuery
+    {
+        QHostAddress                   address = {};
+        QByteArray                     query   = {};
+        TokenBucket::clock::time_point due     = {};
+
+        [[nodiscard]] bool operator==(const PendingQuery &rhs) const
+        { return address == rhs.address && query == rhs.query; }
+    };
+
+    void enqueueQueries(QList<PendingQuery> &queue, const SocketTable &sockets, const QByteArrayList &queries);
+    void sendPendingQueries();
+    void pruneInterfaces();
+    void writeQuery(const QHostAddress &address, const SocketPointer &socket, const QByteArray &query);
+
+    QTimer *const                   m_overloadTimer;
+    QTimer *const                   m_batchTimer;
+    QTimer *const                   m_pacingTimer;
+    DatagramEngine                 *m_engine            = nullptr;
+    Engine                          m_engineType        = Engine::Qt;
+    QByteArrayList                  m_queries;
+    QList<PendingQuery>             m_newQueries;
+    QList<PendingQuery>             m_repeatedQueries;
+    QHash<QHostAddress, int>        m_interfaceIndices;
+    QHash<int, TokenBucket>         m_interfaceBuckets;
+    TokenBucket                     m_totalBucket;
+    QList<std::weak_ptr<QObject>>   m_listeners;
+    DuplicateFilter                 m_duplicateFilter;
+    QHash<QString, ServiceIdentity> m_identities;
+    ExpiryTable<QString>            m_serviceExpiries;
+    ExpiryTable<QString>            m_staleServices;
+    QDateTime                       m_replayExpiry;
+    QDateTime                       m_replayReceived;
+    QDateTime                       m_datagramExpiry;
+    QStringList                     m_datagramKeys;
+    std::unique_ptr<WarmCache>      m_cache;
+    std::atomic<bool>               m_caching{false};
+    DatagramDecoder                 m_decoder;
+    std::unique_ptr<DecoderPool>    m_decoderPool;
+    int                             m_receiveBufferSize = 0;
+    int                             m_batchSize         = 100;
+    int                             m_queryRate         = 0;
+    quint64                         m_droppedDatagrams  = 0;
+    quint64                         m_recentDrops       = 0;
+    bool                            m_overloaded        = false;
+    bool                            m_sharedTransport   = false;
+    bool                            m_passiveListening  = false;
 };
 
 } // namespace qnc::core
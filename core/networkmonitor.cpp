@@ -0,0 +1,193 @@
+/* QtNetworkCrumbs - Some networking toys for Qt
+ * Copyright (C) 2019-2024 Mathias Hasselmann
+ */
+#include "networkmonitor.h"
+
+// Qt headers
+#include <QHostAddress>
+#include <QLoggingCategory>
+#include <QSocketNotifier>
+#include <QtEndian>
+
+#if defined(Q_OS_LINUX) && !defined(Q_OS_ANDROID)
+#define QNC_NETWORKMONITOR_NETLINK 1
+#endif
+
+#ifdef QNC_NETWORKMONITOR_NETLINK
+
+// Linux headers
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+
+// POSIX headers
+#include <sys/socket.h>
+#include <unistd.h>
+
+// STL headers
+#include <array>
+#include <cerrno>
+#include <cstring>
+
+#endif // QNC_NETWORKMONITOR_NETLINK
+
+namespace qnc::core {
+
+namespace {
+
+Q_LOGGING_CATEGORY(lcMonitor, "qnc.core.networkmonitor")
+
+#ifdef QNC_NETWORKMONITOR_NETLINK
+
+QHostAddress addressFromAttribute(int family, const rtattr *attribute)
+{
+    const auto data = static_cast<const char *>(RTA_DATA(attribute));
+    const auto size = RTA_PAYLOAD(attribute);
+
+    if (family == AF_INET && size == 4)
+        return QHostAddress{qFromBigEndian<quint32>(data)};
+    if (family == AF_INET6 && size == 16)
+        return QHostAddress{reinterpret_cast<const quint8 *>(data)};
+
+    return {};
+}
+
+QHostAddress addressFromMessage(const nlmsghdr *header)
+{
+    const auto message = static_cast<const ifaddrmsg *>(NLMSG_DATA(header));
+
+    auto localAddress = QHostAddress{};
+    auto interfaceAddress = QHostAddress{};
+    auto length = static_cast<int>(IFA_PAYLOAD(header));
+
+    for (auto attribute = IFA_RTA(message); RTA_OK(attribute, length);
+         attribute = RTA_NEXT(attribute, length)) {
+        if (attribute->rta_type == IFA_LOCAL)
+            localAddress = addressFromAttribute(message->ifa_family, attribute);
+        else if (attribute->rta_type == IFA_ADDRESS)
+            interfaceAddress = addressFromAttribute(message->ifa_family, attribute);
+    }
+
+    // for point-to-point links IFA_ADDRESS is the peer's address
+    auto address = localAddress.isNull() ? interfaceAddress : localAddress;
+
+    if (address.isLinkLocal() && address.protocol() == QAbstractSocket::IPv6Protocol)
+        address.setScopeId(QString::number(message->ifa_index));
+
+    return address;
+}
+
+#endif // QNC_NETWORKMONITOR_NETLINK
+
+} // namespace
+
+NetworkMonitor::NetworkMonitor(QObject *parent)
+    : QObject{parent}
+{
+#ifdef QNC_NETWORKMONITOR_NETLINK
+    m_descriptor = ::socket(AF_NETLINK, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_ROUTE);
+
+    if (m_descriptor < 0) {
+        qCWarning(lcMonitor, "Could not create netlink socket: %s", std::strerror(errno));
+        return;
+    }
+
+    auto address = sockaddr_nl{};
+    address.nl_family = AF_NETLINK;
+    address.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR;
+
+    if (::bind(m_descriptor, reinterpret_cast<const sockaddr *>(&address), sizeof address) < 0) {
+        qCWarning(lcMonitor, "Could not bind netlink socket: %s", std::strerror(errno));
+        ::close(std::exchange(m_descriptor, -1));
+        return;
+    }
+
+    m_notifier = new QSocketNotifier{m_descriptor, QSocketNotifier::Read, this};
+    connect(m_notifier, &QSocketNotifier::activated, this, &NetworkMonitor::onActivated);
+#endif // QNC_NETWORKMONITOR_NETLINK
+}
+
+NetworkMonitor::~NetworkMonitor()
+{
+#ifdef QNC_NETWORKMONITOR_NETLINK
+    delete std::exchange(m_notifier, nullptr);
+
+    if (m_descriptor >= 0)
+        ::close(m_descriptor);
+#else // !QNC_NETWORKMONITOR_NETLINK
+    Q_UNUSED(m_descriptor);
+#endif // !QNC_NETWORKMONITOR_NETLINK
+}
+
+bool NetworkMonitor::isActive() const
+{
+    return m_notifier != nullptr;
+}
+
+void NetworkMonitor::onActivated()
+{
+#ifdef QNC_NETWORKMONITOR_NETLINK
+    alignas(nlmsghdr) auto buffer = std::array<char, 32768>{};
+
+    for (;;) {
+        auto sender = sockaddr_nl{};
+        auto senderLength = socklen_t{sizeof sender};
+        auto length = ::recvfrom(m_descriptor, buffer.data(), buffer.size(), 0,
+                                 reinterpret_cast<sockaddr *>(&sender), &senderLength);
+
+        if (length < 0) {
+            if (errno == EINTR)
+                continue;
+
+            if (errno == ENOBUFS) {
+                qCWarning(lcMonitor, "Netlink notifications got lost, rescanning");
+                emit resynchronizationRequired();
+                continue;
+            }
+
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                qCWarning(lcMonitor, "Could not read from netlink socket: %s", std::strerror(errno));
+
+            break;
+        }
+
+        // only the kernel may report changes; unicast messages from other processes are spoofed
+        if (senderLength < sizeof sender || sender.nl_pid != 0)
+            continue;
+
+        for (auto header = reinterpret_cast<const nlmsghdr *>(buffer.data());
+             NLMSG_OK(header, length); header = NLMSG_NEXT(header, length)) {
+            switch (header->nlmsg_type) {
+            case RTM_NEWLINK:
+            case RTM_DELLINK:
+                emit interfaceChanged(static_cast<const ifinfomsg *>(NLMSG_DATA(header))->ifi_index);
+                break;
+
+            case RTM_NEWADDR:
+                if (const auto message = static_cast<const ifaddrmsg *>(NLMSG_DATA(header));
+                        (message->ifa_flags & (IFA_F_TENTATIVE | IFA_F_DADFAILED)) == 0) {
+                    if (const auto &address = addressFromMessage(header); !address.isNull())
+                        emit addressAdded(static_cast<int>(message->ifa_index), address);
+                }
+
+                break;
+
+            case RTM_DELADDR:
+                if (const auto &address = addressFromMessage(header); !address.isNull()) {
+                    const auto message = static_cast<const ifaddrmsg *>(NLMSG_DATA(header));
+                    emit addressRemoved(static_cast<int>(message->ifa_index), address);
+                }
+
+                break;
+
+            case NLMSG_OVERRUN:
+                emit resynchronizationRequired();
+                break;
+            }
+        }
+    }
+#endif // QNC_NETWORKMONITOR_NETLINK
+}
+
+} // namespace qnc::core
+
+#include "moc_networkmonitor.cpp"
@@ -0,0 +1,47 @@
+/* QtNetworkCrumbs - Some networking toys for Qt
+ * Copyright (C) 2019-2024 Mathias Hasselmann
+ */
+#ifndef QNCCORE_NETWORKMONITOR_H
+#define QNCCORE_NETWORKMONITOR_H
+
+// Qt headers
+#include <QObject>
+
+class QHostAddress;
+class QSocketNotifier;
+
+namespace qnc::core {
+
+// Reports changes of network interfaces and their addresses as they happen.
+// Currently only implemented for Linux via rtnetlink. On other platforms,
+// or if the kernel refuses the netlink socket, isActive() returns false
+// and users have to fall back to periodically scanning the interfaces.
+class NetworkMonitor : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit NetworkMonitor(QObject *parent = nullptr);
+    ~NetworkMonitor() override;
+
+    [[nodiscard]] bool isActive() const;
+
+signals:
+    void interfaceChanged(int index);
+    void addressAdded(int index, const QHostAddress &address);
+    void addressRemoved(int index, const QHostAddress &address);
+
+    // Emitted when notifications got lost, e.g. because the kernel's
+    // queue overflowed. Listeners must rescan all interfaces then.
+    void resynchronizationRequired();
+
+private:
+    void onActivated();
+
+    int              m_descriptor = -1;
+    QSocketNotifier *m_notifier   = nullptr;
+};
+
+} // namespace qnc::core
+
+#endif // QNCCORE_NETWORKMONITOR_H
@@ -0,0 +1,49 @@
+/* QtNetworkCrumbs - Some networking toys for Qt
+ * Copyright (C) 2019-2024 Mathias Hasselmann
+ */
+#include "resolverthread.h"
+
+// QtNetworkCrumbs headers
+#include "abstractresolver.h"
+#include "literals.h"
+
+// Qt headers
+#include <QLoggingCategory>
+
+namespace qnc::core {
+
+namespace {
+
+Q_LOGGING_CATEGORY(lcThread, "qnc.core.resolverthread")
+
+} // namespace
+
+ResolverThread::ResolverThread(QObject *parent)
+    : QThread{parent}
+{
+    setObjectName("QncResolverThread"_L1);
+}
+
+ResolverThread::~ResolverThread()
+{
+    // resolvers waiting for a full BatchQueue give up, as the other side might wait for us
+    requestInterruption();
+    quit();
+    wait();
+}
+
+void ResolverThread::addResolver(AbstractResolver *resolver)
+{
+    if (resolver->parent() != nullptr) {
+        qCWarning(lcThread, "Cannot move resolver with parent to different thread");
+        return;
+    }
+
+    // the timer, the network monitor and all the sockets are children of the resolver and move along
+    resolver->moveToThread(this);
+    connect(this, &QThread::finished, resolver, &QObject::deleteLater);
+}
+
+} // namespace qnc::core
+
+#include "moc_resolverthread.cpp"
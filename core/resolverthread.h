@@ -0,0 +1,43 @@
+/* QtNetworkCrumbs - Some networking toys for Qt
+ * Copyright (C) 2019-2024 Mathias Hasselmann
+ */
+#ifndef QNCCORE_RESOLVERTHREAD_H
+#define QNCCORE_RESOLVERTHREAD_H
+
+// Qt headers
+#include <QThread>
+
+namespace qnc::core {
+
+class AbstractResolver;
+
+// A thread dedicated to network I/O: Resolvers added to this thread run their
+// timers, sockets and message parsing there, so that bursts of traffic cannot
+// block the thread that created them, like the GUI thread. Once added, resolvers
+// must only be accessed via queued calls, e.g. via invoke(); use connectBatched()
+// from batchqueue.h to receive their results in coalesced batches.
+class ResolverThread : public QThread
+{
+    Q_OBJECT
+
+public:
+    explicit ResolverThread(QObject *parent = nullptr);
+    ~ResolverThread() override;
+
+    // Moves the resolver, which must not have a parent, to this thread and
+    // takes ownership. The resolver gets deleted when the thread finishes.
+    void addResolver(AbstractResolver *resolver);
+
+    // Calls function with the resolver from within this thread.
+    template<class Resolver, typename Function>
+    static bool invoke(Resolver *resolver, Function function)
+    {
+        return QMetaObject::invokeMethod(resolver, [resolver, function = std::move(function)] {
+            function(resolver);
+        }, Qt::QueuedConnection);
+    }
+};
+
+} // namespace qnc::core
+
+#endif // QNCCORE_RESOLVERTHREAD_H
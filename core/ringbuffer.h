@@ -0,0 +1,114 @@
+/* QtNetworkCrumbs - Some networking toys for Qt
+ * Copyright (C) 2019-2024 Mathias Hasselmann
+ */
+#ifndef QNCCORE_RINGBUFFER_H
+#define QNCCORE_RINGBUFFER_H
+
+// STL headers
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+namespace qnc::core {
+
+// A bounded, lock-free queue after Dmitry Vyukov's bounded MPMC queue: Any number
+// of threads can push and pop concurrently, without allocating memory and without
+// taking locks. The single producer and single consumer cases are just special
+// cases of this. The capacity gets rounded up to the next power of two.
+template<typename T>
+class RingBuffer
+{
+public:
+    explicit RingBuffer(std::size_t capacity)
+        : m_mask{roundedCapacity(capacity) - 1}
+        , m_cells{std::make_unique<Cell[]>(m_mask + 1)}
+    {
+        for (auto i = std::size_t{0}; i <= m_mask; ++i)
+            m_cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    RingBuffer(const RingBuffer &) = delete;
+    RingBuffer &operator=(const RingBuffer &) = delete;
+
+    [[nodiscard]] std::size_t capacity() const { return m_mask + 1; }
+
+    // Returns false, without moving from value, if the buffer is full.
+    [[nodiscard]] bool push(T &&value)
+    {
+        auto position = m_pushPosition.load(std::memory_order_relaxed);
+
+        for (;;) {
+            auto &cell = m_cells[position & m_mask];
+            const auto sequence = cell.sequence.load(std::memory_order_acquire);
+            const auto distance = static_cast<std::ptrdiff_t>(sequence - position);
+
+            if (distance == 0) {
+                if (m_pushPosition.compare_exchange_weak(position, position + 1,
+                                                         std::memory_order_relaxed)) {
+                    cell.value = std::move(value);
+                    cell.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (distance < 0) {
+                return false;
+            } else {
+                position = m_pushPosition.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Returns false, leaving value untouched, if the buffer is empty.
+    [[nodiscard]] bool pop(T &value)
+    {
+        auto position = m_popPosition.load(std::memory_order_relaxed);
+
+        for (;;) {
+            auto &cell = m_cells[position & m_mask];
+            const auto sequence = cell.sequence.load(std::memory_order_acquire);
+            const auto distance = static_cast<std::ptrdiff_t>(sequence - (position + 1));
+
+            if (distance == 0) {
+                if (m_popPosition.compare_exchange_weak(position, position + 1,
+                                                        std::memory_order_relaxed)) {
+                    value = std::move(cell.value);
+                    cell.sequence.store(position + m_mask + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (distance < 0) {
+                return false;
+            } else {
+                position = m_popPosition.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+private:
+    struct Cell
+    {
+        std::atomic<std::size_t> sequence;
+        T value;
+    };
+
+    // keeps producers and consumers from invalidating each other's cache lines
+    static constexpr auto s_cacheLineSize = std::size_t{64};
+
+    [[nodiscard]] static std::size_t roundedCapacity(std::size_t capacity)
+    {
+        auto rounded = std::size_t{2};
+
+        while (rounded < capacity)
+            rounded <<= 1;
+
+        return rounded;
+    }
+
+    const std::size_t m_mask;
+    const std::unique_ptr<Cell[]> m_cells;
+
+    alignas(s_cacheLineSize) std::atomic<std::size_t> m_pushPosition{0};
+    alignas(s_cacheLineSize) std::atomic<std::size_t> m_popPosition{0};
+};
+
+} // namespace qnc::core
+
+#endif // QNCCORE_RINGBUFFER_H
@@ -0,0 +1,48 @@
+/* QtNetworkCrumbs - Some networking toys for Qt
+ * Copyright (C) 2019-2024 Mathias Hasselmann
+ */
+#include "serviceidentity.h"
+
+// Qt headers
+#include <QDebug>
+
+namespace qnc::core {
+
+bool ServiceIdentity::observe(int interfaceIndex, const QHostAddress &address, const QDateTime &expiry)
+{
+    auto changed = false;
+
+    if (interfaceIndex > 0 && !m_interfaces.contains(interfaceIndex)) {
+        m_interfaces.append(interfaceIndex);
+        changed = true;
+    }
+
+    if (!address.isNull() && !m_addresses.contains(address)) {
+        m_addresses.append(address);
+        changed = true;
+    }
+
+    // all observations share the lifetime of the most recent announcement
+    m_expiry = expiry;
+
+    return changed;
+}
+
+} // namespace qnc::core
+
+QDebug operator<<(QDebug debug, const qnc::core::ServiceIdentity &identity)
+{
+    const auto _ = QDebugStateSaver{debug};
+
+    if (debug.verbosity() >= QDebug::DefaultVerbosity)
+        debug.nospace() << identity.staticMetaObject.className();
+
+    return debug.nospace()
+            << "(" << identity.name()
+            << ", interfaces=" << identity.interfaces()
+            << ", addresses=" << identity.addresses()
+            << ", expiry=" << identity.expiry()
+            << ")";
+}
+
+#include "moc_serviceidentity.cpp"
@@ -0,0 +1,51 @@
+/* QtNetworkCrumbs - Some networking toys for Qt
+ * Copyright (C) 2019-2024 Mathias Hasselmann
+ */
+#ifndef QNCCORE_SERVICEIDENTITY_H
+#define QNCCORE_SERVICEIDENTITY_H
+
+// Qt headers
+#include <QDateTime>
+#include <QHostAddress>
+
+namespace qnc::core {
+
+// A single service, no matter on how many network interfaces, and via which address
+// families it was seen. Keeps track of those interfaces and the sender addresses, and
+// of the lifetime announced by the most recent observation.
+class ServiceIdentity
+{
+    Q_GADGET
+    Q_PROPERTY(QString             name       READ name       CONSTANT FINAL)
+    Q_PROPERTY(QList<int>          interfaces READ interfaces CONSTANT FINAL)
+    Q_PROPERTY(QList<QHostAddress> addresses  READ addresses  CONSTANT FINAL)
+    Q_PROPERTY(QDateTime           expiry     READ expiry     CONSTANT FINAL)
+
+public:
+    ServiceIdentity() = default;
+    explicit ServiceIdentity(QString name)
+        : m_name{std::move(name)}
+    {}
+
+    [[nodiscard]] QString             name()       const { return m_name; }
+    [[nodiscard]] QList<int>          interfaces() const { return m_interfaces; }
+    [[nodiscard]] QList<QHostAddress> addresses()  const { return m_addresses; }
+    [[nodiscard]] QDateTime           expiry()     const { return m_expiry; }
+
+    // Merges an observation of this service on the network interface with the given
+    // index, sent from address, and valid until expiry. Returns true if the service
+    // was seen on a new interface, or from a new address.
+    bool observe(int interfaceIndex, const QHostAddress &address, const QDateTime &expiry);
+
+private:
+    QString             m_name;
+    QList<int>          m_interfaces;
+    QList<QHostAddress> m_addresses;
+    QDateTime           m_expiry;
+};
+
+} // namespace qnc::core
+
+QDebug operator<<(QDebug debug, const qnc::core::ServiceIdentity &identity);
+
+#endif // QNCCORE_SERVICEIDENTITY_H
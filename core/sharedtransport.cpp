@@ -0,0 +1,135 @@
+/* QtNetworkCrumbs - Some networking toys for Qt
+ * Copyright (C) 2019-2024 Mathias Hasselmann
+ */
+#include "sharedtransport.h"
+
+// Qt headers
+#include <QLoggingCategory>
+#include <QMutex>
+#include <QThread>
+
+// STL headers
+#include <algorithm>
+#include <vector>
+
+namespace qnc::core {
+
+namespace {
+
+Q_LOGGING_CATEGORY(lcTransport, "qnc.core.transport")
+
+struct Registration
+{
+    QThread                        *thread = nullptr;
+    SharedTransport::Key            key    = {};
+    std::weak_ptr<SharedTransport>  transport;
+};
+
+// there are only a few sockets per network interface, no need for anything fancy
+struct Registry
+{
+    QMutex                    mutex;
+    std::vector<Registration> transports;
+};
+
+Registry &transportRegistry()
+{
+    static auto registry = Registry{};
+    return registry;
+}
+
+} // namespace
+
+bool SharedTransport::Key::operator==(const Key &rhs) const
+{
+    return engine == rhs.engine
+            && group == rhs.group
+            && port == rhs.port
+            && interfaceIndex == rhs.interfaceIndex
+            && address == rhs.address
+            && bindPort == rhs.bindPort;
+}
+
+SharedTransport::SharedTransport(const Key &key, std::unique_ptr<DatagramEngine> engine, SocketPointer socket)
+    : m_key{key}
+    , m_engine{std::move(engine)}
+    , m_socket{std::move(socket)}
+{
+    connect(m_engine.get(), &DatagramEngine::datagramReceived, this, &SharedTransport::datagramReceived);
+    connect(m_engine.get(), &DatagramEngine::datagramsDropped, this, &SharedTransport::datagramsDropped);
+}
+
+SharedTransport::~SharedTransport()
+{
+    qCDebug(lcTransport, "Closing shared transport for %ls on %ls",
+            qUtf16Printable(m_key.group.toString()),
+            qUtf16Printable(m_key.address.toString()));
+}
+
+SharedTransport::Pointer SharedTransport::acquire(const Key &key, const QNetworkInterface &iface,
+                                                  const EngineFactory &createEngine)
+{
+    auto &registry = transportRegistry();
+    const auto thread = QThread::currentThread();
+    const auto locker = QMutexLocker{&registry.mutex};
+
+    auto &transports = registry.transports;
+
+    transports.erase(std::remove_if(transports.begin(), transports.end(),
+                                    [](const Registration &registration) {
+        return registration.transport.expired();
+    }), transports.end());
+
+    const auto it = std::find_if(transports.cbegin(), transports.cend(),
+                                 [thread, &key](const Registration &registration) {
+        return registration.thread == thread && registration.key == key;
+    });
+
+    if (it != transports.cend()) {
+        // the registration might just have expired since pruning the list
+        if (auto transport = it->transport.lock())
+            return transport;
+    }
+
+    auto engine = createEngine();
+
+    if (!engine)
+        return nullptr;
+
+    auto socket = engine->createSocket(iface, key.address, key.group, key.bindPort);
+
+    if (!socket)
+        return nullptr;
+
+    qCDebug(lcTransport, "Opening shared transport for %ls on %ls",
+            qUtf16Printable(key.group.toString()),
+            qUtf16Printable(key.address.toString()));
+
+    auto transport = Pointer{new SharedTransport{key, std::move(engine), std::move(socket)}};
+    transports.push_back({thread, key, transport});
+    return transport;
+}
+
+qintptr SharedTransport::socketDescriptor() const
+{
+    return m_engine->socketDescriptor(m_socket);
+}
+
+void SharedTransport::setReceiveBufferSize(int size)
+{
+    if (size <= m_receiveBufferSize)
+        return;
+
+    m_receiveBufferSize = size;
+    m_engine->setReceiveBufferSize(m_socket, m_receiveBufferSize);
+}
+
+void SharedTransport::writeDatagram(const QByteArray &data, const QHostAddress &address, quint16 port)
+{
+    m_engine->writeDatagram(m_socket, data, address, port);
+    m_engine->flush();
+}
+
+} // namespace qnc::core
+
+#include "moc_sharedtransport.cpp"
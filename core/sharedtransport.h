@@ -0,0 +1,78 @@
+/* QtNetworkCrumbs - Some networking toys for Qt
+ * Copyright (C) 2019-2024 Mathias Hasselmann
+ */
+#ifndef QNCCORE_SHAREDTRANSPORT_H
+#define QNCCORE_SHAREDTRANSPORT_H
+
+// QtNetworkCrumbs headers
+#include "datagramengine.h"
+
+// Qt headers
+#include <QHostAddress>
+
+// STL headers
+#include <functional>
+#include <memory>
+
+namespace qnc::core {
+
+// A multicast socket shared by all resolvers of the same thread that use the same
+// kind of datagram engine, multicast group, port and interface address. The socket
+// gets created for the first resolver needing it, and gets closed once the last
+// resolver has released it. Received datagrams are read only once, and then get
+// passed to all resolvers sharing the transport via datagramReceived().
+class SharedTransport : public QObject
+{
+    Q_OBJECT
+
+public:
+    using Pointer       = std::shared_ptr<SharedTransport>;
+    using EngineFactory = std::function<std::unique_ptr<DatagramEngine>()>;
+
+    struct Key
+    {
+        int          engine         = 0;
+        QHostAddress group          = {};
+        quint16      port           = 0;
+        int          interfaceIndex = 0;
+        QHostAddress address        = {};
+        quint16      bindPort       = 0; // the local port, or 0 for a random one
+
+        [[nodiscard]] bool operator==(const Key &rhs) const;
+        [[nodiscard]] bool operator!=(const Key &rhs) const { return !(*this == rhs); }
+    };
+
+    ~SharedTransport() override;
+
+    // Returns the current thread's transport for key, or creates a new one,
+    // using an engine returned by createEngine. Returns nullptr on failure.
+    [[nodiscard]] static Pointer acquire(const Key &key, const QNetworkInterface &iface,
+                                         const EngineFactory &createEngine);
+
+    [[nodiscard]] Key key() const { return m_key; }
+    [[nodiscard]] qintptr socketDescriptor() const;
+
+    // Grows the socket's receive buffer, but never shrinks it, as some other resolver might need it.
+    void setReceiveBufferSize(int size);
+
+    // Sends the datagram immediately.
+    void writeDatagram(const QByteArray &data, const QHostAddress &address, quint16 port);
+
+signals:
+    void datagramReceived(const QNetworkDatagram &datagram);
+    void datagramsDropped(quint64 count);
+
+private:
+    using SocketPointer = DatagramEngine::SocketPointer;
+
+    SharedTransport(const Key &key, std::unique_ptr<DatagramEngine> engine, SocketPointer socket);
+
+    const Key                             m_key;
+    const std::unique_ptr<DatagramEngine> m_engine;
+    SocketPointer                         m_socket;
+    int                                   m_receiveBufferSize = 0;
+};
+
+} // namespace qnc::core
+
+#endif // QNCCORE_SHAREDTRANSPORT_H
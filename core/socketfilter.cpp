@@ -0,0 +1,275 @@
+/* QtNetworkCrumbs - Some networking toys for Qt
+ * Copyright (C) 2019-2024 Mathias Hasselmann
+ */
+#include "socketfilter.h"
+
+// QtNetworkCrumbs headers
+#include "compat.h"
+
+// Qt headers
+#include <QLoggingCategory>
+
+#if defined(Q_OS_LINUX)
+#define QNC_SOCKETFILTER_BPF 1
+#endif
+
+#ifdef QNC_SOCKETFILTER_BPF
+
+// Linux headers
+#include <linux/filter.h>
+
+// POSIX headers
+#include <sys/socket.h>
+
+// STL headers
+#include <cerrno>
+#include <cstring>
+
+#endif // QNC_SOCKETFILTER_BPF
+
+// STL headers
+#include <optional>
+
+namespace qnc::core {
+
+namespace {
+
+Q_LOGGING_CATEGORY(lcSocketFilter, "qnc.core.socketfilter")
+
+// instruction classes, modes and operations of classic BPF
+enum : quint16 {
+    ClassLoad       = 0x00,
+    ClassAlu        = 0x04,
+    ClassJump       = 0x05,
+    ClassReturn     = 0x06,
+    ClassMisc       = 0x07,
+
+    ModeAbsolute    = 0x20,
+    ModeIndexed     = 0x40,
+    ModeLength      = 0x80,
+
+    AluSubtract     = 0x10,
+    AluOr           = 0x40,
+    AluAnd          = 0x50,
+
+    JumpAlways      = 0x00,
+    JumpEqual       = 0x10,
+    JumpGreaterEqual= 0x30,
+    JumpAnySet      = 0x40,
+
+    SourceConstant  = 0x00,
+    SourceIndex     = 0x08,
+
+    MiscCopyToIndex = 0x00,
+};
+
+constexpr auto s_acceptPacket = quint32{0xffffffff};
+constexpr auto s_rejectPacket = quint32{0};
+constexpr auto s_maximumProgramSize = std::size_t{4096};
+
+auto code(quint16 instructionClass, SocketFilter::Size size, quint16 mode)
+{
+    return static_cast<quint16>(instructionClass | qToUnderlying(size) | mode);
+}
+
+} // namespace
+
+SocketFilter::Label SocketFilter::createLabel()
+{
+    m_labels.push_back(s_maximumProgramSize);
+    return Label{static_cast<int>(m_labels.size() - 1)};
+}
+
+void SocketFilter::bindLabel(Label label)
+{
+    Q_ASSERT(label.m_id >= 0);
+    Q_ASSERT(static_cast<std::size_t>(label.m_id) < m_labels.size());
+
+    m_labels[static_cast<std::size_t>(label.m_id)] = m_instructions.size();
+}
+
+void SocketFilter::load(Size size, quint32 offset)
+{
+    append(code(ClassLoad, size, ModeAbsolute), offset);
+}
+
+void SocketFilter::loadIndexed(Size size, quint32 offset)
+{
+    append(code(ClassLoad, size, ModeIndexed), offset);
+}
+
+void SocketFilter::loadLength()
+{
+    append(code(ClassLoad, Size::Word, ModeLength), 0);
+}
+
+void SocketFilter::copyToIndex()
+{
+    append(ClassMisc | MiscCopyToIndex, 0);
+}
+
+void SocketFilter::bitwiseAnd(quint32 value)
+{
+    append(ClassAlu | AluAnd | SourceConstant, value);
+}
+
+void SocketFilter::bitwiseOr(quint32 value)
+{
+    append(ClassAlu | AluOr | SourceConstant, value);
+}
+
+void SocketFilter::subtract(quint32 value)
+{
+    append(ClassAlu | AluSubtract | SourceConstant, value);
+}
+
+void SocketFilter::jumpIfEqual(quint32 value, Label ifTrue, Label ifFalse)
+{
+    append(ClassJump | JumpEqual | SourceConstant, value, ifTrue, ifFalse);
+}
+
+void SocketFilter::jumpIfGreaterEqual(quint32 value, Label ifTrue, Label ifFalse)
+{
+    append(ClassJump | JumpGreaterEqual | SourceConstant, value, ifTrue, ifFalse);
+}
+
+void SocketFilter::jumpIfGreaterEqualIndex(Label ifTrue, Label ifFalse)
+{
+    append(ClassJump | JumpGreaterEqual | SourceIndex, 0, ifTrue, ifFalse);
+}
+
+void SocketFilter::jumpIfAnySet(quint32 mask, Label ifTrue, Label ifFalse)
+{
+    append(ClassJump | JumpAnySet | SourceConstant, mask, ifTrue, ifFalse);
+}
+
+void SocketFilter::jump(Label target)
+{
+    append(ClassJump | JumpAlways, 0, target);
+}
+
+void SocketFilter::accept()
+{
+    append(ClassReturn | SourceConstant, s_acceptPacket);
+}
+
+void SocketFilter::reject()
+{
+    append(ClassReturn | SourceConstant, s_rejectPacket);
+}
+
+void SocketFilter::append(quint16 code, quint32 value, Label ifTrue, Label ifFalse)
+{
+    auto instruction = PendingInstruction{};
+
+    instruction.instruction.code  = code;
+    instruction.instruction.value = value;
+    instruction.ifTrue            = ifTrue;
+    instruction.ifFalse           = ifFalse;
+
+    m_instructions.push_back(std::move(instruction));
+}
+
+std::vector<SocketFilter::Instruction> SocketFilter::compile() const
+{
+    if (m_instructions.size() > s_maximumProgramSize) {
+        qCWarning(lcSocketFilter, "Socket filter is too long: %zu instructions", m_instructions.size());
+        return {};
+    }
+
+    auto program = std::vector<Instruction>{};
+    program.reserve(m_instructions.size());
+
+    for (auto pc = std::size_t{0}; pc < m_instructions.size(); ++pc) {
+        const auto resolve = [this, pc](Label label) -> std::optional<std::size_t> {
+            if (label.m_id < 0)
+                return 0;
+
+            const auto target = m_labels[static_cast<std::size_t>(label.m_id)];
+
+            if (target <= pc || target >= m_instructions.size())
+                return {};
+
+            return target - pc - 1;
+        };
+
+        const auto &pending = m_instructions[pc];
+        auto instruction = pending.instruction;
+
+        const auto ifTrue = resolve(pending.ifTrue);
+        const auto ifFalse = resolve(pending.ifFalse);
+
+        if (!ifTrue || !ifFalse) {
+            qCWarning(lcSocketFilter, "Unresolved jump at instruction %zu", pc);
+            return {};
+        }
+
+        if ((instruction.code & 0x07) == ClassJump && (instruction.code & 0xf0) == JumpAlways) {
+            instruction.value = static_cast<quint32>(*ifTrue);
+        } else if (*ifTrue > 255 || *ifFalse > 255) {
+            qCWarning(lcSocketFilter, "Jump too far at instruction %zu", pc);
+            return {};
+        } else {
+            instruction.jumpIfTrue  = static_cast<quint8>(*ifTrue);
+            instruction.jumpIfFalse = static_cast<quint8>(*ifFalse);
+        }
+
+        program.push_back(std::move(instruction));
+    }
+
+    return program;
+}
+
+bool SocketFilter::attach(qintptr socketDescriptor) const
+{
+#ifdef QNC_SOCKETFILTER_BPF
+    const auto descriptor = static_cast<int>(socketDescriptor);
+
+    if (isEmpty()) {
+        if (::setsockopt(descriptor, SOL_SOCKET, SO_DETACH_FILTER, nullptr, 0) < 0 && errno != ENOENT) {
+            qCWarning(lcSocketFilter, "Could not detach socket filter: %s", std::strerror(errno));
+            return false;
+        }
+
+        return true;
+    }
+
+    const auto &instructions = compile();
+
+    if (instructions.empty())
+        return false;
+
+    auto filter = std::vector<sock_filter>{};
+    filter.reserve(instructions.size());
+
+    for (const auto &instruction : instructions) {
+        filter.push_back({instruction.code, instruction.jumpIfTrue,
+                          instruction.jumpIfFalse, instruction.value});
+    }
+
+    auto program = sock_fprog{};
+    program.len = static_cast<unsigned short>(filter.size());
+    program.filter = filter.data();
+
+    if (::setsockopt(descriptor, SOL_SOCKET, SO_ATTACH_FILTER, &program, sizeof program) < 0) {
+        qCWarning(lcSocketFilter, "Could not attach socket filter: %s", std::strerror(errno));
+        return false;
+    }
+
+    return true;
+#else // !QNC_SOCKETFILTER_BPF
+    Q_UNUSED(socketDescriptor);
+    return false;
+#endif // !QNC_SOCKETFILTER_BPF
+}
+
+bool SocketFilter::isSupported()
+{
+#ifdef QNC_SOCKETFILTER_BPF
+    return true;
+#else // !QNC_SOCKETFILTER_BPF
+    return false;
+#endif // !QNC_SOCKETFILTER_BPF
+}
+
+} // namespace qnc::core
@@ -0,0 +1,96 @@
+/* QtNetworkCrumbs - Some networking toys for Qt
+ * Copyright (C) 2019-2024 Mathias Hasselmann
+ */
+#ifndef QNCCORE_SOCKETFILTER_H
+#define QNCCORE_SOCKETFILTER_H
+
+// Qt headers
+#include <QtGlobal>
+
+// STL headers
+#include <vector>
+
+namespace qnc::core {
+
+// A tiny assembler for classic BPF programs, as attached to sockets via SO_ATTACH_FILTER.
+// For UDP sockets offsets are relative to the UDP header, so the payload starts at offset 8.
+// Jumps are forward only and are expressed via labels; Label::next() continues with the
+// next instruction. Attaching filters currently is only supported on Linux.
+class SocketFilter
+{
+public:
+    enum class Size : quint16 {
+        Word     = 0x00,
+        HalfWord = 0x08,
+        Byte     = 0x10,
+    };
+
+    class Label
+    {
+    public:
+        constexpr Label() noexcept = default;
+        [[nodiscard]] static constexpr Label next() noexcept { return {}; }
+
+    private:
+        friend class SocketFilter;
+        constexpr explicit Label(int id) noexcept : m_id{id} {}
+        int m_id = -1;
+    };
+
+    struct Instruction
+    {
+        quint16 code        = 0;
+        quint8  jumpIfTrue  = 0;
+        quint8  jumpIfFalse = 0;
+        quint32 value       = 0;
+    };
+
+    [[nodiscard]] Label createLabel();
+    void bindLabel(Label label);
+
+    void load(Size size, quint32 offset);           // A <- P[offset]
+    void loadIndexed(Size size, quint32 offset);    // A <- P[X + offset]
+    void loadLength();                              // A <- packet length
+    void copyToIndex();                             // X <- A
+
+    void bitwiseAnd(quint32 value);
+    void bitwiseOr(quint32 value);
+    void subtract(quint32 value);
+
+    void jumpIfEqual(quint32 value, Label ifTrue, Label ifFalse);
+    void jumpIfGreaterEqual(quint32 value, Label ifTrue, Label ifFalse);
+    void jumpIfGreaterEqualIndex(Label ifTrue, Label ifFalse);
+    void jumpIfAnySet(quint32 mask, Label ifTrue, Label ifFalse);
+    void jump(Label target);
+
+    void accept();
+    void reject();
+
+    [[nodiscard]] bool isEmpty() const { return m_instructions.empty(); }
+    [[nodiscard]] std::size_t size() const { return m_instructions.size(); }
+
+    // Resolves all labels. Returns an empty program if some jump cannot be encoded.
+    [[nodiscard]] std::vector<Instruction> compile() const;
+
+    // Attaches this program to the socket, or removes any attached program if this one is empty.
+    bool attach(qintptr socketDescriptor) const;
+
+    [[nodiscard]] static bool isSupported();
+
+private:
+    struct PendingInstruction
+    {
+        Instruction instruction = {};
+        Label       ifTrue      = {};
+        Label       ifFalse     = {};
+    };
+
+    void append(quint16 code, quint32 value, Label ifTrue = {}, Label ifFalse = {});
+
+    std::vector<PendingInstruction> m_instructions;
+    std::vector<std::size_t>        m_labels;
+};
+
+} // namespace qnc::core
+
+#endif // QNCCORE_SOCKETFILTER_H
@@ -0,0 +1,40 @@
+/* QtNetworkCrumbs - Some networking toys for Qt
+ * Copyright (C) 2019-2024 Mathias Hasselmann
+ */
+#include "tokenbucket.h"
+
+// STL headers
+#include <algorithm>
+
+namespace qnc::core {
+
+TokenBucket::TokenBucket(int rate, int burst)
+    : m_rate{std::max(rate, 0)}
+    , m_burst{std::max(burst, 1)}
+{
+    if (m_rate > 0) {
+        m_interval = std::chrono::duration_cast<clock::duration>(std::chrono::seconds{1}) / m_rate;
+        m_tolerance = m_interval * (m_burst - 1);
+    }
+}
+
+TokenBucket::clock::duration TokenBucket::delay(clock::time_point now) const
+{
+    if (!isLimited())
+        return clock::duration::zero();
+
+    return std::max(m_full - m_tolerance - now, clock::duration::zero());
+}
+
+bool TokenBucket::take(clock::time_point now)
+{
+    if (delay(now) > clock::duration::zero())
+        return false;
+
+    if (isLimited())
+        m_full = std::max(m_full, now) + m_interval;
+
+    return true;
+}
+
+} // namespace qnc::core
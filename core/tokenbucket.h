@@ -0,0 +1,43 @@
+/* QtNetworkCrumbs - Some networking toys for Qt
+ * Copyright (C) 2019-2024 Mathias Hasselmann
+ */
+#ifndef QNCCORE_TOKENBUCKET_H
+#define QNCCORE_TOKENBUCKET_H
+
+// STL headers
+#include <chrono>
+
+namespace qnc::core {
+
+// Limits how often something happens: Tokens get refilled at rate() per second,
+// up to burst() tokens, and each event must take one. Instead of counting tokens,
+// this tracks when the bucket will be full again, which only needs integer math.
+class TokenBucket
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    // A rate of 0 disables limiting.
+    explicit TokenBucket(int rate = 0, int burst = 1);
+
+    [[nodiscard]] int rate() const { return m_rate; }
+    [[nodiscard]] int burst() const { return m_burst; }
+    [[nodiscard]] bool isLimited() const { return m_rate > 0; }
+
+    // Returns how long to wait until a token is available, or zero if there is one.
+    [[nodiscard]] clock::duration delay(clock::time_point now = clock::now()) const;
+
+    // Takes a token if one is available, and returns false otherwise.
+    bool take(clock::time_point now = clock::now());
+
+private:
+    clock::duration   m_interval  = {};
+    clock::duration   m_tolerance = {};
+    clock::time_point m_full      = {};
+    int               m_rate;
+    int               m_burst;
+};
+
+} // namespace qnc::core
+
+#endif // QNCCORE_TOKENBUCKET_H
@@ -0,0 +1,895 @@
+/* QtNetworkCrumbs - Some networking toys for Qt
+ * Copyright (C) 2019-2024 Mathias Hasselmann
+ */
+#include "uringdatagramengine.h"
+
+// QtNetworkCrumbs headers
+#include "compat.h"
+#include "literals.h"
+
+// Qt headers
+#include <QHostAddress>
+#include <QLoggingCategory>
+#include <QNetworkDatagram>
+#include <QNetworkInterface>
+#include <QSocketNotifier>
+#include <QtEndian>
+
+#if defined(Q_OS_LINUX) && !defined(Q_OS_ANDROID) && __has_include(<linux/io_uring.h>)
+#define QNC_DATAGRAMENGINE_URING 1
+#endif
+
+#ifdef QNC_DATAGRAMENGINE_URING
+
+// Linux headers
+#include <linux/io_uring.h>
+
+// POSIX headers
+#include <netinet/in.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// STL headers
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
+#endif // QNC_DATAGRAMENGINE_URING
+
+namespace qnc::core {
+
+namespace {
+
+#ifdef QNC_DATAGRAMENGINE_URING
+
+Q_LOGGING_CATEGORY(lcUring, "qnc.core.engine.uring")
+
+constexpr auto s_queueDepth     = 256U;
+constexpr auto s_bufferCount    = 64U;  // must be a power of two
+constexpr auto s_bufferGroup    = quint16{0};
+constexpr auto s_controlSize    = 128U;
+constexpr auto s_maximumPayload = 65535U;
+
+// each buffer must hold the largest possible datagram after the recvmsg header,
+// the sender's address, and the control messages; otherwise the kernel truncates it
+constexpr auto s_bufferSize     = static_cast<unsigned>(sizeof(io_uring_recvmsg_out) + sizeof(sockaddr_storage))
+                                + s_controlSize + s_maximumPayload;
+constexpr auto s_multicastHops  = 4;
+
+enum class Operation : quint64 {
+    Receive = 1,
+    Send    = 2,
+    Cancel  = 3,
+};
+
+constexpr auto s_operationShift = 56;
+constexpr auto s_identifierMask = (quint64{1} << s_operationShift) - 1;
+
+constexpr quint64 userData(Operation operation, quint64 id)
+{
+    return (qToUnderlying(operation) << s_operationShift) | (id & s_identifierMask);
+}
+
+int setupRing(unsigned entries, io_uring_params *params)
+{
+    return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+}
+
+int enterRing(int descriptor, unsigned submissions, unsigned minimumCompletions = 0)
+{
+    const auto flags = minimumCompletions > 0 ? IORING_ENTER_GETEVENTS : 0U;
+    return static_cast<int>(::syscall(__NR_io_uring_enter, descriptor, submissions,
+                                      minimumCompletions, flags, nullptr, 0));
+}
+
+int registerWithRing(int descriptor, unsigned opcode, const void *argument, unsigned count)
+{
+    return static_cast<int>(::syscall(__NR_io_uring_register, descriptor, opcode, argument, count));
+}
+
+bool setSocketOption(int descriptor, int level, int option, int value)
+{
+    return ::setsockopt(descriptor, level, option, &value, sizeof value) == 0;
+}
+
+socklen_t toSocketAddress(const QHostAddress &address, quint16 port, sockaddr_storage *storage)
+{
+    *storage = {};
+
+    if (address.protocol() == QAbstractSocket::IPv4Protocol) {
+        const auto ipv4 = reinterpret_cast<sockaddr_in *>(storage);
+        ipv4->sin_family = AF_INET;
+        ipv4->sin_port = qToBigEndian(port);
+        ipv4->sin_addr.s_addr = qToBigEndian(address.toIPv4Address());
+        return sizeof(sockaddr_in);
+    }
+
+    const auto ipv6 = reinterpret_cast<sockaddr_in6 *>(storage);
+    const auto bytes = address.toIPv6Address();
+    ipv6->sin6_family = AF_INET6;
+    ipv6->sin6_port = qToBigEndian(port);
+    std::memcpy(&ipv6->sin6_addr, bytes.c, sizeof bytes.c);
+    return sizeof(sockaddr_in6);
+}
+
+quint16 portFromSocketAddress(const sockaddr_storage &storage)
+{
+    if (storage.ss_family == AF_INET)
+        return qFromBigEndian(reinterpret_cast<const sockaddr_in *>(&storage)->sin_port);
+    if (storage.ss_family == AF_INET6)
+        return qFromBigEndian(reinterpret_cast<const sockaddr_in6 *>(&storage)->sin6_port);
+
+    return 0;
+}
+
+#endif // QNC_DATAGRAMENGINE_URING
+
+} // namespace
+
+#ifdef QNC_DATAGRAMENGINE_URING
+
+// The bare minimum of liburing that is needed by this engine: one submission
+// and completion queue, and one ring of provided buffers for receiving.
+class UringDatagramEngine::Ring
+{
+public:
+    Ring() = default;
+    ~Ring();
+
+    Q_DISABLE_COPY_MOVE(Ring)
+
+    [[nodiscard]] bool setup(unsigned entries);
+    [[nodiscard]] bool registerBuffers(quint16 group, unsigned count, unsigned size);
+    [[nodiscard]] bool registerEventDescriptor(int descriptor);
+
+    [[nodiscard]] bool supportsOperations(std::initializer_list<quint8> operations) const;
+    [[nodiscard]] bool supportsMultishotReceive();
+
+    [[nodiscard]] io_uring_sqe *nextSubmission();
+    int submit(unsigned minimumCompletions = 0);
+
+    template<typename Callback>
+    void reapCompletions(Callback &&callback);
+
+    [[nodiscard]] const char *buffer(unsigned id) const { return m_buffers.data() + id * m_bufferSize; }
+    void recycleBuffer(unsigned id);
+    void publishBuffers();
+
+private:
+    int            m_descriptor          = -1;
+    void          *m_submissionRing      = MAP_FAILED;
+    std::size_t    m_submissionRingSize  = 0;
+    void          *m_completionRing      = MAP_FAILED;
+    std::size_t    m_completionRingSize  = 0;
+    io_uring_sqe  *m_submissions         = static_cast<io_uring_sqe *>(MAP_FAILED);
+    std::size_t    m_submissionsSize     = 0;
+
+    unsigned      *m_submissionHead      = nullptr;
+    unsigned      *m_submissionTail      = nullptr;
+    unsigned      *m_submissionArray     = nullptr;
+    unsigned       m_submissionMask      = 0;
+    unsigned       m_submissionEntries   = 0;
+    unsigned       m_pendingTail         = 0;
+
+    unsigned      *m_completionHead      = nullptr;
+    unsigned      *m_completionTail      = nullptr;
+    io_uring_cqe  *m_completions         = nullptr;
+    unsigned       m_completionMask      = 0;
+
+    io_uring_buf  *m_bufferRing          = static_cast<io_uring_buf *>(MAP_FAILED);
+    std::size_t    m_bufferRingSize      = 0;
+    std::vector<char> m_buffers;
+    unsigned       m_bufferSize          = 0;
+    unsigned       m_bufferMask          = 0;
+    quint16        m_bufferTail          = 0;
+};
+
+UringDatagramEngine::Ring::~Ring()
+{
+    if (m_descriptor >= 0)
+        ::close(m_descriptor);
+
+    if (m_bufferRing != MAP_FAILED)
+        ::munmap(m_bufferRing, m_bufferRingSize);
+    if (m_submissions != MAP_FAILED)
+        ::munmap(m_submissions, m_submissionsSize);
+    if (m_completionRing != MAP_FAILED && m_completionRing != m_submissionRing)
+        ::munmap(m_completionRing, m_completionRingSize);
+    if (m_submissionRing != MAP_FAILED)
+        ::munmap(m_submissionRing, m_submissionRingSize);
+}
+
+bool UringDatagramEngine::Ring::setup(unsigned entries)
+{
+    auto params = io_uring_params{};
+
+    // multishot receives can post many completions for a single submission
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = entries * 4;
+
+    m_descriptor = setupRing(entries, &params);
+
+    if (m_descriptor < 0)
+        return false;
+
+    m_submissionRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    m_completionRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        m_submissionRingSize = std::max(m_submissionRingSize, m_completionRingSize);
+        m_completionRingSize = m_submissionRingSize;
+    }
+
+    m_submissionRing = ::mmap(nullptr, m_submissionRingSize, PROT_READ | PROT_WRITE,
+                              MAP_SHARED | MAP_POPULATE, m_descriptor, IORING_OFF_SQ_RING);
+
+    if (m_submissionRing == MAP_FAILED)
+        return false;
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        m_completionRing = m_submissionRing;
+    } else {
+        m_completionRing = ::mmap(nullptr, m_completionRingSize, PROT_READ | PROT_WRITE,
+                                  MAP_SHARED | MAP_POPULATE, m_descriptor, IORING_OFF_CQ_RING);
+
+        if (m_completionRing == MAP_FAILED)
+            return false;
+    }
+
+    m_submissionsSize = params.sq_entries * sizeof(io_uring_sqe);
+    m_submissions = static_cast<io_uring_sqe *>(::mmap(nullptr, m_submissionsSize, PROT_READ | PROT_WRITE,
+                                                       MAP_SHARED | MAP_POPULATE, m_descriptor,
+                                                       IORING_OFF_SQES));
+
+    if (m_submissions == MAP_FAILED)
+        return false;
+
+    const auto submissionRing = static_cast<char *>(m_submissionRing);
+    const auto completionRing = static_cast<char *>(m_completionRing);
+
+    m_submissionHead    = reinterpret_cast<unsigned *>(submissionRing + params.sq_off.head);
+    m_submissionTail    = reinterpret_cast<unsigned *>(submissionRing + params.sq_off.tail);
+    m_submissionArray   = reinterpret_cast<unsigned *>(submissionRing + params.sq_off.array);
+    m_submissionMask    = *reinterpret_cast<unsigned *>(submissionRing + params.sq_off.ring_mask);
+    m_submissionEntries = params.sq_entries;
+    m_pendingTail       = *m_submissionTail;
+
+    m_completionHead    = reinterpret_cast<unsigned *>(completionRing + params.cq_off.head);
+    m_completionTail    = reinterpret_cast<unsigned *>(completionRing + params.cq_off.tail);
+    m_completions       = reinterpret_cast<io_uring_cqe *>(completionRing + params.cq_off.cqes);
+    m_completionMask    = *reinterpret_cast<unsigned *>(completionRing + params.cq_off.ring_mask);
+
+    return true;
+}
+
+bool UringDatagramEngine::Ring::registerBuffers(quint16 group, unsigned count, unsigned size)
+{
+    Q_ASSERT((count & (count - 1)) == 0);
+
+    m_bufferRingSize = count * sizeof(io_uring_buf);
+    m_bufferRing = static_cast<io_uring_buf *>(::mmap(nullptr, m_bufferRingSize, PROT_READ | PROT_WRITE,
+                                                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+
+    if (m_bufferRing == MAP_FAILED)
+        return false;
+
+    auto registration = io_uring_buf_reg{};
+    registration.ring_addr = reinterpret_cast<quint64>(m_bufferRing);
+    registration.ring_entries = count;
+    registration.bgid = group;
+
+    if (registerWithRing(m_descriptor, IORING_REGISTER_PBUF_RING, &registration, 1) < 0)
+        return false;
+
+    m_buffers.resize(std::size_t{count} * size);
+    m_bufferSize = size;
+    m_bufferMask = count - 1;
+
+    for (auto id = 0U; id < count; ++id)
+        recycleBuffer(id);
+
+    publishBuffers();
+    return true;
+}
+
+bool UringDatagramEngine::Ring::registerEventDescriptor(int descriptor)
+{
+    return registerWithRing(m_descriptor, IORING_REGISTER_EVENTFD, &descriptor, 1) == 0;
+}
+
+bool UringDatagramEngine::Ring::supportsOperations(std::initializer_list<quint8> operations) const
+{
+    // io_uring_probe ends with a flexible array, which the kernel expects zeroed
+    auto storage = std::vector<char>(sizeof(io_uring_probe) + IORING_OP_LAST * sizeof(io_uring_probe_op));
+    const auto probe = reinterpret_cast<io_uring_probe *>(storage.data());
+
+    if (registerWithRing(m_descriptor, IORING_REGISTER_PROBE, probe, IORING_OP_LAST) < 0)
+        return false;
+
+    return std::all_of(operations.begin(), operations.end(), [probe](quint8 operation) {
+        return operation <= probe->last_op
+                && (probe->ops[operation].flags & IO_URING_OP_SUPPORTED);
+    });
+}
+
+// The probe only tells if IORING_OP_RECVMSG exists, but not if it supports multishot
+// receives, which came with Linux 6.0. Older kernels reject them with EINVAL right
+// away, while newer ones keep them pending until they get canceled.
+bool UringDatagramEngine::Ring::supportsMultishotReceive()
+{
+    const auto descriptor = ::socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_UDP);
+
+    if (descriptor < 0)
+        return false;
+
+    auto header = msghdr{};
+    header.msg_namelen = sizeof(sockaddr_storage);
+
+    const auto receive = nextSubmission();
+    const auto cancel = receive ? nextSubmission() : nullptr;
+
+    if (!cancel) {
+        ::close(descriptor);
+        return false;
+    }
+
+    receive->opcode = IORING_OP_RECVMSG;
+    receive->fd = descriptor;
+    receive->addr = reinterpret_cast<quint64>(&header);
+    receive->len = 1;
+    receive->ioprio = IORING_RECV_MULTISHOT;
+    receive->flags = IOSQE_BUFFER_SELECT;
+    receive->buf_group = s_bufferGroup;
+    receive->user_data = userData(Operation::Receive, 0);
+
+    cancel->opcode = IORING_OP_ASYNC_CANCEL;
+    cancel->fd = -1;
+    cancel->addr = userData(Operation::Receive, 0);
+    cancel->user_data = userData(Operation::Cancel, 0);
+
+    auto supported = false;
+
+    if (submit(2) >= 0) {
+        reapCompletions([&supported](const io_uring_cqe &completion) {
+            if (completion.user_data == userData(Operation::Receive, 0))
+                supported = (completion.res != -EINVAL);
+        });
+    }
+
+    ::close(descriptor);
+    return supported;
+}
+
+io_uring_sqe *UringDatagramEngine::Ring::nextSubmission()
+{
+    if (m_pendingTail - __atomic_load_n(m_submissionHead, __ATOMIC_ACQUIRE) >= m_submissionEntries) {
+        if (submit() < 0)
+            return nullptr;
+        if (m_pendingTail - __atomic_load_n(m_submissionHead, __ATOMIC_ACQUIRE) >= m_submissionEntries)
+            return nullptr;
+    }
+
+    const auto index = m_pendingTail & m_submissionMask;
+    const auto submission = &m_submissions[index];
+
+    std::memset(submission, 0, sizeof *submission);
+    m_submissionArray[index] = index;
+    ++m_pendingTail;
+
+    return submission;
+}
+
+int UringDatagramEngine::Ring::submit(unsigned minimumCompletions)
+{
+    const auto count = m_pendingTail - *m_submissionTail;
+
+    if (count == 0)
+        return 0;
+
+    __atomic_store_n(m_submissionTail, m_pendingTail, __ATOMIC_RELEASE);
+
+    for (;;) {
+        const auto result = enterRing(m_descriptor, count, minimumCompletions);
+
+        if (result >= 0 || errno != EINTR)
+            return result;
+    }
+}
+
+template<typename Callback>
+void UringDatagramEngine::Ring::reapCompletions(Callback &&callback)
+{
+    auto head = *m_completionHead;
+    const auto tail = __atomic_load_n(m_completionTail, __ATOMIC_ACQUIRE);
+
+    for (; head != tail; ++head)
+        callback(m_completions[head & m_completionMask]);
+
+    __atomic_store_n(m_completionHead, head, __ATOMIC_RELEASE);
+}
+
+void UringDatagramEngine::Ring::recycleBuffer(unsigned id)
+{
+    // only assign the fields of the entry, the ring's tail shares memory with the first one
+    auto &entry = m_bufferRing[m_bufferTail & m_bufferMask];
+
+    entry.addr = reinterpret_cast<quint64>(buffer(id));
+    entry.len  = m_bufferSize;
+    entry.bid  = static_cast<quint16>(id);
+
+    ++m_bufferTail;
+}
+
+void UringDatagramEngine::Ring::publishBuffers()
+{
+    __atomic_store_n(&m_bufferRing[0].resv, m_bufferTail, __ATOMIC_RELEASE);
+}
+
+class UringDatagramEngine::Socket : public QObject
+{
+public:
+    Socket(UringDatagramEngine *engine, int descriptor, quint64 id)
+        : QObject{engine}
+        , engine{engine}
+        , descriptor{descriptor}
+        , id{id}
+    {
+        header.msg_namelen = sizeof(sockaddr_storage);
+        header.msg_controllen = s_controlSize;
+    }
+
+    ~Socket() override
+    {
+        if (engine)
+            engine->cancelReceive(this);
+
+        ::close(descriptor);
+    }
+
+    [[nodiscard]] QNetworkDatagram parseMessage(const char *data, std::size_t length);
+
+    UringDatagramEngine *engine;
+    const int            descriptor;
+    const quint64        id;
+    quint16              port        = 0;
+    msghdr               header      = {};
+    bool                 isReceiving = false;
+    quint32              dropCount   = 0;   // as reported by SO_RXQ_OVFL
+    quint32              newDrops    = 0;
+};
+
+// io_uring_recvmsg_out, followed by the space reserved for name and control messages, and the payload
+QNetworkDatagram UringDatagramEngine::Socket::parseMessage(const char *data, std::size_t length)
+{
+    auto message = io_uring_recvmsg_out{};
+
+    const auto nameOffset = sizeof message;
+    const auto controlOffset = nameOffset + header.msg_namelen;
+    const auto payloadOffset = controlOffset + header.msg_controllen;
+
+    if (length < payloadOffset)
+        return {};
+
+    std::memcpy(&message, data, sizeof message);
+
+    if (message.flags & MSG_TRUNC) {
+        qCWarning(lcUring, "Dropping truncated datagram of %u bytes", message.payloadlen);
+        return {};
+    }
+
+    const auto payloadLength = std::min<std::size_t>(message.payloadlen, length - payloadOffset);
+    auto datagram = QNetworkDatagram{QByteArray{data + payloadOffset, static_cast<compat::lentype>(payloadLength)}};
+
+    if (message.namelen <= header.msg_namelen) {
+        auto sender = sockaddr_storage{};
+        std::memcpy(&sender, data + nameOffset, message.namelen);
+        datagram.setSender(QHostAddress{reinterpret_cast<const sockaddr *>(&sender)},
+                           portFromSocketAddress(sender));
+    }
+
+    auto control = msghdr{};
+    control.msg_control = const_cast<char *>(data + controlOffset);
+    control.msg_controllen = std::min<std::size_t>(message.controllen, header.msg_controllen);
+
+    for (auto cmsg = CMSG_FIRSTHDR(&control); cmsg; cmsg = CMSG_NXTHDR(&control, cmsg)) {
+        if (cmsg->cmsg_level == IPPROTO_IP && cmsg->cmsg_type == IP_PKTINFO) {
+            auto info = in_pktinfo{};
+            std::memcpy(&info, CMSG_DATA(cmsg), sizeof info);
+            datagram.setDestination(QHostAddress{qFromBigEndian(info.ipi_addr.s_addr)}, port);
+            datagram.setInterfaceIndex(static_cast<uint>(info.ipi_ifindex));
+        } else if (cmsg->cmsg_level == IPPROTO_IPV6 && cmsg->cmsg_type == IPV6_PKTINFO) {
+            auto info = in6_pktinfo{};
+            std::memcpy(&info, CMSG_DATA(cmsg), sizeof info);
+            datagram.setDestination(QHostAddress{info.ipi6_addr.s6_addr}, port);
+            datagram.setInterfaceIndex(info.ipi6_ifindex);
+        } else if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL) {
+            auto counter = quint32{};
+            std::memcpy(&counter, CMSG_DATA(cmsg), sizeof counter);
+            newDrops += counter - std::exchange(dropCount, counter);
+        }
+    }
+
+    return datagram;
+}
+
+struct UringDatagramEngine::PendingSend
+{
+    QByteArray       data    = {};
+    sockaddr_storage address = {};
+    iovec            vector  = {};
+    msghdr           header  = {};
+};
+
+#else // !QNC_DATAGRAMENGINE_URING
+
+class UringDatagramEngine::Ring {};
+class UringDatagramEngine::Socket : public QObject {};
+struct UringDatagramEngine::PendingSend {};
+
+#endif // !QNC_DATAGRAMENGINE_URING
+
+UringDatagramEngine::UringDatagramEngine(QObject *parent)
+    : DatagramEngine{parent}
+{
+#ifdef QNC_DATAGRAMENGINE_URING
+    auto ring = std::make_unique<Ring>();
+
+    if (!ring->setup(s_queueDepth)) {
+        qCWarning(lcUring, "Could not setup io_uring: %s", std::strerror(errno));
+        return;
+    }
+
+    if (!ring->registerBuffers(s_bufferGroup, s_bufferCount, s_bufferSize)) {
+        qCWarning(lcUring, "Could not register receive buffers: %s", std::strerror(errno));
+        return;
+    }
+
+    m_eventDescriptor = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    if (m_eventDescriptor < 0) {
+        qCWarning(lcUring, "Could not create eventfd: %s", std::strerror(errno));
+        return;
+    }
+
+    if (!ring->registerEventDescriptor(m_eventDescriptor)) {
+        qCWarning(lcUring, "Could not register eventfd: %s", std::strerror(errno));
+        return;
+    }
+
+    m_ring = std::move(ring);
+    m_notifier = new QSocketNotifier{m_eventDescriptor, QSocketNotifier::Read, this};
+    connect(m_notifier, &QSocketNotifier::activated, this, &UringDatagramEngine::onCompletionsAvailable);
+#endif // QNC_DATAGRAMENGINE_URING
+}
+
+UringDatagramEngine::~UringDatagramEngine()
+{
+#ifdef QNC_DATAGRAMENGINE_URING
+    for (const auto socket : std::as_const(m_sockets))
+        socket->engine = nullptr;
+
+    delete std::exchange(m_notifier, nullptr);
+    m_ring.reset();
+
+    if (m_eventDescriptor >= 0)
+        ::close(m_eventDescriptor);
+#else // !QNC_DATAGRAMENGINE_URING
+    Q_UNUSED(m_eventDescriptor);
+    Q_UNUSED(m_lastSocketId);
+    Q_UNUSED(m_lastSendId);
+#endif // !QNC_DATAGRAMENGINE_URING
+}
+
+bool UringDatagramEngine::isValid() const
+{
+    return m_notifier != nullptr;
+}
+
+bool UringDatagramEngine::isSupported()
+{
+#ifdef QNC_DATAGRAMENGINE_URING
+    static const auto supported = [] {
+        auto ring = Ring{};
+
+        // buffer rings need Linux 5.19, multishot receives even need Linux 6.0
+        return ring.setup(2)
+                && ring.supportsOperations({IORING_OP_RECVMSG, IORING_OP_SENDMSG, IORING_OP_ASYNC_CANCEL})
+                && ring.registerBuffers(s_bufferGroup, 1, 1)
+                && ring.supportsMultishotReceive();
+    }();
+
+    return supported;
+#else // !QNC_DATAGRAMENGINE_URING
+    return false;
+#endif // !QNC_DATAGRAMENGINE_URING
+}
+
+DatagramEngine::SocketPointer
+UringDatagramEngine::createSocket(const QNetworkInterface &iface, const QHostAddress &address,
+                                  const QHostAddress &group, quint16 port)
+{
+#ifdef QNC_DATAGRAMENGINE_URING
+    if (!isValid())
+        return nullptr;
+
+    const auto isIPv4 = (address.protocol() == QAbstractSocket::IPv4Protocol);
+    const auto descriptor = ::socket(isIPv4 ? AF_INET : AF_INET6,
+                                     SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_UDP);
+
+    if (descriptor < 0) {
+        qCWarning(lcUring, "Could not create multicast socket for %ls: %s",
+                  qUtf16Printable(address.toString()), std::strerror(errno));
+        return nullptr;
+    }
+
+    auto socket = std::make_shared<Socket>(this, descriptor, ++m_lastSocketId);
+
+    const auto bindAddress = isIPv4 ? QHostAddress{QHostAddress::AnyIPv4} : QHostAddress{QHostAddress::AnyIPv6};
+    auto storage = sockaddr_storage{};
+    auto storageSize = toSocketAddress(bindAddress, port, &storage);
+
+    if (!setSocketOption(descriptor, SOL_SOCKET, SO_RXQ_OVFL, 1))
+        qCWarning(lcUring, "Could not enable drop counting: %s", std::strerror(errno));
+
+    // well-known ports are shared with other processes, like the system's mDNS responder
+    if (!setSocketOption(descriptor, SOL_SOCKET, SO_REUSEADDR, 1)
+            || (port != 0 && !setSocketOption(descriptor, SOL_SOCKET, SO_REUSEPORT, 1))
+            || (!isIPv4 && !setSocketOption(descriptor, IPPROTO_IPV6, IPV6_V6ONLY, 1))
+            || ::bind(descriptor, reinterpret_cast<const sockaddr *>(&storage), storageSize) < 0
+            || ::getsockname(descriptor, reinterpret_cast<sockaddr *>(&storage), &storageSize) < 0) {
+        qCWarning(lcUring, "Could not bind multicast socket to %ls, port %d: %s",
+                  qUtf16Printable(address.toString()), port, std::strerror(errno));
+        return nullptr;
+    }
+
+    socket->port = portFromSocketAddress(storage);
+
+    auto joined = false;
+
+    if (isIPv4) {
+        auto request = ip_mreqn{};
+        request.imr_multiaddr.s_addr = qToBigEndian(group.toIPv4Address());
+        request.imr_ifindex = iface.index();
+
+        joined = ::setsockopt(descriptor, IPPROTO_IP, IP_ADD_MEMBERSHIP, &request, sizeof request) == 0
+                && ::setsockopt(descriptor, IPPROTO_IP, IP_MULTICAST_IF, &request, sizeof request) == 0
+                && setSocketOption(descriptor, IPPROTO_IP, IP_MULTICAST_TTL, s_multicastHops)
+                && setSocketOption(descriptor, IPPROTO_IP, IP_PKTINFO, 1);
+    } else {
+        const auto bytes = group.toIPv6Address();
+
+        auto request = ipv6_mreq{};
+        std::memcpy(&request.ipv6mr_multiaddr, bytes.c, sizeof bytes.c);
+        request.ipv6mr_interface = static_cast<unsigned>(iface.index());
+
+        joined = ::setsockopt(descriptor, IPPROTO_IPV6, IPV6_JOIN_GROUP, &request, sizeof request) == 0
+                && setSocketOption(descriptor, IPPROTO_IPV6, IPV6_MULTICAST_IF, iface.index())
+                && setSocketOption(descriptor, IPPROTO_IPV6, IPV6_MULTICAST_HOPS, s_multicastHops)
+                && setSocketOption(descriptor, IPPROTO_IPV6, IPV6_RECVPKTINFO, 1);
+    }
+
+    if (!joined) {
+        qCWarning(lcUring, "Could not join multicast group %ls on %ls: %s",
+                  qUtf16Printable(group.toString()),
+                  qUtf16Printable(iface.name()),
+                  std::strerror(errno));
+        return nullptr;
+    }
+
+    qCDebug(lcUring, "Multicast group %ls joined on %ls",
+            qUtf16Printable(group.toString()),
+            qUtf16Printable(iface.humanReadableName()));
+
+    m_sockets.insert(socket->id, socket.get());
+    armReceive(socket.get());
+    m_ring->submit();
+
+    return socket;
+#else // !QNC_DATAGRAMENGINE_URING
+    Q_UNUSED(iface);
+    Q_UNUSED(address);
+    Q_UNUSED(group);
+    Q_UNUSED(port);
+    return nullptr;
+#endif // !QNC_DATAGRAMENGINE_URING
+}
+
+qintptr UringDatagramEngine::socketDescriptor(const SocketPointer &socket) const
+{
+#ifdef QNC_DATAGRAMENGINE_URING
+    Q_ASSERT(dynamic_cast<Socket *>(socket.get()));
+    return static_cast<Socket *>(socket.get())->descriptor;
+#else // !QNC_DATAGRAMENGINE_URING
+    Q_UNUSED(socket);
+    return -1;
+#endif // !QNC_DATAGRAMENGINE_URING
+}
+
+void UringDatagramEngine::setReceiveBufferSize(const SocketPointer &socket, int size)
+{
+#ifdef QNC_DATAGRAMENGINE_URING
+    Q_ASSERT(dynamic_cast<Socket *>(socket.get()));
+
+    if (!setSocketOption(static_cast<Socket *>(socket.get())->descriptor, SOL_SOCKET, SO_RCVBUF, size))
+        qCWarning(lcUring, "Could not change receive buffer size: %s", std::strerror(errno));
+#else // !QNC_DATAGRAMENGINE_URING
+    Q_UNUSED(socket);
+    Q_UNUSED(size);
+#endif // !QNC_DATAGRAMENGINE_URING
+}
+
+void UringDatagramEngine::writeDatagram(const SocketPointer &socket, const QByteArray &data,
+                                        const QHostAddress &address, quint16 port)
+{
+#ifdef QNC_DATAGRAMENGINE_URING
+    Q_ASSERT(dynamic_cast<Socket *>(socket.get()));
+
+    const auto submission = m_ring->nextSubmission();
+
+    if (!submission) {
+        qCWarning(lcUring, "Could not queue datagram for %ls: %s",
+                  qUtf16Printable(address.toString()), std::strerror(errno));
+        return;
+    }
+
+    // the message must stay alive until the kernel reports its completion
+    auto send = std::make_unique<PendingSend>();
+
+    send->data = data;
+    send->vector.iov_base = const_cast<char *>(send->data.constData()); // data() would detach
+    send->vector.iov_len = static_cast<std::size_t>(send->data.size());
+    send->header.msg_name = &send->address;
+    send->header.msg_namelen = toSocketAddress(address, port, &send->address);
+    send->header.msg_iov = &send->vector;
+    send->header.msg_iovlen = 1;
+
+    submission->opcode = IORING_OP_SENDMSG;
+    submission->fd = static_cast<Socket *>(socket.get())->descriptor;
+    submission->addr = reinterpret_cast<quint64>(&send->header);
+    submission->len = 1;
+    submission->user_data = userData(Operation::Send, ++m_lastSendId);
+
+    m_pendingSends.emplace(m_lastSendId, std::move(send));
+#else // !QNC_DATAGRAMENGINE_URING
+    Q_UNUSED(socket);
+    Q_UNUSED(data);
+    Q_UNUSED(address);
+    Q_UNUSED(port);
+#endif // !QNC_DATAGRAMENGINE_URING
+}
+
+void UringDatagramEngine::flush()
+{
+#ifdef QNC_DATAGRAMENGINE_URING
+    if (m_ring && m_ring->submit() < 0)
+        qCWarning(lcUring, "Could not submit to io_uring: %s", std::strerror(errno));
+#endif // QNC_DATAGRAMENGINE_URING
+}
+
+void UringDatagramEngine::armReceive(Socket *socket)
+{
+#ifdef QNC_DATAGRAMENGINE_URING
+    const auto submission = m_ring->nextSubmission();
+
+    if (!submission) {
+        qCWarning(lcUring, "Could not arm receive operation: %s", std::strerror(errno));
+        return;
+    }
+
+    submission->opcode = IORING_OP_RECVMSG;
+    submission->fd = socket->descriptor;
+    submission->addr = reinterpret_cast<quint64>(&socket->header);
+    submission->len = 1;
+    submission->ioprio = IORING_RECV_MULTISHOT;
+    submission->flags = IOSQE_BUFFER_SELECT;
+    submission->buf_group = s_bufferGroup;
+    submission->user_data = userData(Operation::Receive, socket->id);
+
+    socket->isReceiving = true;
+#else // !QNC_DATAGRAMENGINE_URING
+    Q_UNUSED(socket);
+#endif // !QNC_DATAGRAMENGINE_URING
+}
+
+void UringDatagramEngine::cancelReceive(Socket *socket)
+{
+#ifdef QNC_DATAGRAMENGINE_URING
+    m_sockets.remove(socket->id);
+
+    if (!socket->isReceiving)
+        return;
+
+    if (const auto submission = m_ring->nextSubmission()) {
+        submission->opcode = IORING_OP_ASYNC_CANCEL;
+        submission->fd = -1;
+        submission->addr = userData(Operation::Receive, socket->id);
+        submission->user_data = userData(Operation::Cancel, socket->id);
+
+        m_ring->submit();
+    }
+#else // !QNC_DATAGRAMENGINE_URING
+    Q_UNUSED(socket);
+#endif // !QNC_DATAGRAMENGINE_URING
+}
+
+void UringDatagramEngine::onCompletionsAvailable()
+{
+#ifdef QNC_DATAGRAMENGINE_URING
+    auto counter = quint64{};
+
+    if (::read(m_eventDescriptor, &counter, sizeof counter) < 0 && errno != EAGAIN)
+        qCWarning(lcUring, "Could not read from eventfd: %s", std::strerror(errno));
+
+    auto datagrams = QList<QNetworkDatagram>{};
+    auto disarmedSockets = QList<Socket *>{};
+
+    m_ring->reapCompletions([&](const io_uring_cqe &completion) {
+        const auto id = completion.user_data & s_identifierMask;
+
+        switch (static_cast<Operation>(completion.user_data >> s_operationShift)) {
+        case Operation::Send:
+            if (completion.res < 0)
+                qCWarning(lcUring, "Could not send datagram: %s", std::strerror(-completion.res));
+
+            m_pendingSends.erase(id);
+            break;
+
+        case Operation::Receive:
+            if (const auto socket = m_sockets.value(id)) {
+                if (completion.flags & IORING_CQE_F_BUFFER && completion.res > 0) {
+                    const auto bufferId = completion.flags >> IORING_CQE_BUFFER_SHIFT;
+                    auto datagram = socket->parseMessage(m_ring->buffer(bufferId),
+                                                         static_cast<std::size_t>(completion.res));
+
+                    if (!datagram.data().isEmpty())
+                        datagrams.append(std::move(datagram));
+                }
+
+                if (!(completion.flags & IORING_CQE_F_MORE)) {
+                    socket->isReceiving = false;
+
+                    // running out of buffers terminates multishot receives; other errors are fatal
+                    if (completion.res >= 0 || completion.res == -ENOBUFS)
+                        disarmedSockets.append(socket);
+                    else
+                        qCWarning(lcUring, "Could not receive datagrams: %s", std::strerror(-completion.res));
+                }
+            }
+
+            if (completion.flags & IORING_CQE_F_BUFFER)
+                m_ring->recycleBuffer(completion.flags >> IORING_CQE_BUFFER_SHIFT);
+
+            break;
+
+        case Operation::Cancel:
+            break;
+        }
+    });
+
+    m_ring->publishBuffers();
+
+    for (const auto socket : std::as_const(disarmedSockets))
+        armReceive(socket);
+
+    flush();
+
+    auto dropped = quint64{0};
+
+    for (const auto socket : std::as_const(m_sockets))
+        dropped += std::exchange(socket->newDrops, 0);
+
+    if (dropped > 0)
+        emit datagramsDropped(dropped);
+
+    for (const auto &datagram : std::as_const(datagrams))
+        emit datagramReceived(datagram);
+#endif // QNC_DATAGRAMENGINE_URING
+}
+
+} // namespace qnc::core
+
+#include "moc_uringdatagramengine.cpp"
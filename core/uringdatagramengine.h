@@ -0,0 +1,70 @@
+/* QtNetworkCrumbs - Some networking toys for Qt
+ * Copyright (C) 2019-2024 Mathias Hasselmann
+ */
+#ifndef QNCCORE_URINGDATAGRAMENGINE_H
+#define QNCCORE_URINGDATAGRAMENGINE_H
+
+// QtNetworkCrumbs headers
+#include "datagramengine.h"
+
+// Qt headers
+#include <QHash>
+
+// STL headers
+#include <unordered_map>
+
+class QSocketNotifier;
+
+namespace qnc::core {
+
+// A datagram engine for Linux that is driven by io_uring: Each socket has one
+// multishot receive armed, which picks its buffers from a registered buffer ring.
+// Datagrams are sent in batches when flush() is called. The Qt event loop only
+// wakes up when completions got posted to the ring's eventfd, instead of getting
+// notified for each socket. Requires Linux 6.0; on other systems, or if the
+// kernel refuses to set up the ring, isValid() returns false.
+class UringDatagramEngine : public DatagramEngine
+{
+    Q_OBJECT
+
+public:
+    explicit UringDatagramEngine(QObject *parent = nullptr);
+    ~UringDatagramEngine() override;
+
+    [[nodiscard]] bool isValid() const;
+    [[nodiscard]] static bool isSupported();
+
+    [[nodiscard]] SocketPointer createSocket(const QNetworkInterface &iface,
+                                             const QHostAddress &address,
+                                             const QHostAddress &group,
+                                             quint16 port) override;
+
+    [[nodiscard]] qintptr socketDescriptor(const SocketPointer &socket) const override;
+
+    void setReceiveBufferSize(const SocketPointer &socket, int size) override;
+
+    void writeDatagram(const SocketPointer &socket, const QByteArray &data,
+                       const QHostAddress &address, quint16 port) override;
+    void flush() override;
+
+private:
+    class Ring;
+    class Socket;
+    struct PendingSend;
+
+    void armReceive(Socket *socket);
+    void cancelReceive(Socket *socket);
+    void onCompletionsAvailable();
+
+    QHash<quint64, Socket *>                                 m_sockets;
+    std::unordered_map<quint64, std::unique_ptr<PendingSend>> m_pendingSends;
+    std::unique_ptr<Ring>                                    m_ring;
+    QSocketNotifier                                         *m_notifier         = nullptr;
+    int                                                      m_eventDescriptor  = -1;
+    quint64                                                  m_lastSocketId     = 0;
+    quint64                                                  m_lastSendId       = 0;
+};
+
+} // namespace qnc::core
+
+#endif // QNCCORE_URINGDATAGRAMENGINE_H
@@ -0,0 +1,321 @@
+/* QtNetworkCrumbs - Some networking toys for Qt
+ * Copyright (C) 2019-2024 Mathias Hasselmann
+ */
+#include "warmcache.h"
+
+// QtNetworkCrumbs headers
+#include "literals.h"
+
+// Qt headers
+#include <QLoggingCategory>
+#include <QSaveFile>
+#include <QTimeZone>
+#include <QtEndian>
+
+// STL headers
+#include <algorithm>
+#include <cstring>
+#include <optional>
+
+namespace qnc::core {
+
+namespace {
+
+Q_LOGGING_CATEGORY(lcCache, "qnc.core.warmcache")
+
+constexpr char s_magic[] = "QNCWARM2";
+constexpr auto s_magicSize = qint64{sizeof s_magic - 1};
+
+// expiry (64 bit), reception time (64 bit), interface index (32 bit), sender port (16 bit),
+// address family (8 bit), entry kind (8 bit), sender address (128 bit), payload size (32 bit),
+// size of the keys (32 bit); followed by the payload, and by the keys separated by newlines
+constexpr auto s_entryHeaderSize = 48;
+constexpr auto s_maximumPayloadSize = quint32{65535};
+
+enum class Family : quint8 {
+    None = 0,
+    IPv4 = 4,
+    IPv6 = 6,
+};
+
+enum class Kind : quint8 {
+    Datagram = 0,
+    Tombstone = 1,
+};
+
+QByteArray encodeEntry(Kind kind, const QNetworkDatagram &datagram, qint64 expiry,
+                       qint64 received, const QStringList &keys)
+{
+    const auto &payload = datagram.data();
+    const auto encodedKeys = keys.join(u'\n').toUtf8();
+    const auto sender = datagram.senderAddress();
+
+    auto entry = QByteArray{s_entryHeaderSize, '\0'};
+    auto header = reinterpret_cast<uchar *>(entry.data());
+
+    qToLittleEndian(expiry, header);
+    qToLittleEndian(received, header + 8);
+    qToLittleEndian(static_cast<quint32>(datagram.interfaceIndex()), header + 16);
+    qToLittleEndian(static_cast<quint16>(datagram.senderPort()), header + 20);
+    header[23] = static_cast<uchar>(kind);
+
+    switch (sender.protocol()) {
+    case QAbstractSocket::IPv4Protocol:
+        header[22] = static_cast<uchar>(Family::IPv4);
+        qToBigEndian(sender.toIPv4Address(), header + 24);
+        break;
+
+    case QAbstractSocket::IPv6Protocol:
+        header[22] = static_cast<uchar>(Family::IPv6);
+        std::memcpy(header + 24, sender.toIPv6Address().c, 16);
+        break;
+
+    case QAbstractSocket::AnyIPProtocol:
+    case QAbstractSocket::UnknownNetworkLayerProtocol:
+        break;
+    }
+
+    qToLittleEndian(static_cast<quint32>(payload.size()), header + 40);
+    qToLittleEndian(static_cast<quint32>(encodedKeys.size()), header + 44);
+
+    return entry + payload + encodedKeys;
+}
+
+QHostAddress decodeAddress(const uchar *header)
+{
+    switch (static_cast<Family>(header[22])) {
+    case Family::IPv4:
+        return QHostAddress{qFromBigEndian<quint32>(header + 24)};
+
+    case Family::IPv6:
+        return QHostAddress{header + 24};
+
+    case Family::None:
+        break;
+    }
+
+    return {};
+}
+
+} // namespace
+
+WarmCache::WarmCache(const QString &fileName)
+    : m_file{fileName}
+{}
+
+QList<WarmCache::Entry> WarmCache::load(const QDateTime &now)
+{
+    m_file.close();
+    m_stored.clear();
+
+    if (!m_file.exists())
+        return {};
+
+    if (!m_file.open(QFile::ReadOnly)) {
+        qCWarning(lcCache, "Could not open %ls: %ls",
+                  qUtf16Printable(m_file.fileName()),
+                  qUtf16Printable(m_file.errorString()));
+        return {};
+    }
+
+    const auto fileSize = m_file.size();
+    const auto data = fileSize > 0 ? m_file.map(0, fileSize) : nullptr;
+
+    auto entries = QList<Entry>{};
+    auto indices = QHash<QByteArray, qsizetype>{};
+    auto entryCount = qsizetype{0};
+    auto isCorrupt = (data == nullptr);
+
+    if (data && (fileSize < s_magicSize || std::memcmp(data, s_magic, s_magicSize) != 0))
+        isCorrupt = true;
+
+    const auto nowMs = now.toMSecsSinceEpoch();
+    auto offset = s_magicSize;
+
+    while (!isCorrupt && offset < fileSize) {
+        if (fileSize - offset < s_entryHeaderSize) {
+            isCorrupt = true; // most probably an interrupted write
+            break;
+        }
+
+        const auto header = data + offset;
+        const auto expiry = qFromLittleEndian<qint64>(header);
+        const auto kind = static_cast<Kind>(header[23]);
+        const auto payloadSize = qFromLittleEndian<quint32>(header + 40);
+        const auto keysSize = qFromLittleEndian<quint32>(header + 44);
+
+        if (payloadSize > s_maximumPayloadSize || keysSize > s_maximumPayloadSize
+                || fileSize - offset - s_entryHeaderSize < qint64{payloadSize} + qint64{keysSize}
+                || (kind != Kind::Datagram && kind != Kind::Tombstone)) {
+            isCorrupt = true;
+            break;
+        }
+
+        offset += s_entryHeaderSize + payloadSize + keysSize;
+        ++entryCount;
+
+        if (expiry <= nowMs)
+            continue;
+
+        const auto payload = QByteArray{reinterpret_cast<const char *>(header + s_entryHeaderSize),
+                                        static_cast<literals::compat::lentype>(payloadSize)};
+        const auto keys = QString::fromUtf8(reinterpret_cast<const char *>(header + s_entryHeaderSize + payloadSize),
+                                            static_cast<literals::compat::lentype>(keysSize));
+
+        if (kind == Kind::Tombstone) {
+            // tombstones only suppress the entries written before them
+            const auto isRemoved = [&keys](const Entry &entry) { return entry.keys.contains(keys); };
+            const auto removed = std::remove_if(entries.begin(), entries.end(), isRemoved);
+
+            if (removed != entries.end()) {
+                entries.erase(removed, entries.end());
+                indices.clear();
+
+                for (auto i = qsizetype{0}; i < entries.size(); ++i)
+                    indices.insert(entries[i].datagram.data(), i);
+            }
+
+            continue;
+        }
+
+        auto datagram = QNetworkDatagram{payload};
+        datagram.setSender(decodeAddress(header), qFromLittleEndian<quint16>(header + 20));
+        datagram.setInterfaceIndex(qFromLittleEndian<quint32>(header + 16));
+
+        auto entry = Entry{std::move(datagram),
+                           QDateTime::fromMSecsSinceEpoch(expiry, QTimeZone::utc()),
+                           QDateTime::fromMSecsSinceEpoch(qFromLittleEndian<qint64>(header + 8), QTimeZone::utc()),
+                           keys.isEmpty() ? QStringList{} : keys.split(u'\n')};
+
+        // newer copies of the same datagram supersede older ones
+        if (const auto it = indices.constFind(payload); it != indices.cend()) {
+            entries[*it] = std::move(entry);
+        } else {
+            indices.insert(payload, entries.size());
+            entries.append(std::move(entry));
+        }
+    }
+
+    if (data)
+        m_file.unmap(data);
+
+    m_file.close();
+
+    if (isCorrupt && fileSize > 0)
+        qCWarning(lcCache, "Ignoring corrupt data in %ls", qUtf16Printable(m_file.fileName()));
+
+    // keep the file small, so that loading stays cheap; this also drops
+    // the tombstones, as the entries they suppress are not written again
+    if (isCorrupt || entries.size() < entryCount / 2)
+        rewrite(entries);
+
+    for (const auto &entry : std::as_const(entries))
+        m_stored.insert(entry.datagram.data(), {entry.expiry.toMSecsSinceEpoch(), entry.keys});
+
+    return entries;
+}
+
+bool WarmCache::store(const QNetworkDatagram &datagram, const QDateTime &expiry,
+                      const QStringList &keys, const QDateTime &now)
+{
+    const auto &payload = datagram.data();
+    const auto expiryMs = expiry.toMSecsSinceEpoch();
+    const auto nowMs = now.toMSecsSinceEpoch();
+
+    if (payload.isEmpty() || static_cast<quint64>(payload.size()) > s_maximumPayloadSize)
+        return false;
+
+    // refresh entries only once they have lived half of their lifetime, to limit the file's growth
+    if (const auto it = m_stored.constFind(payload); it != m_stored.cend()
+            && it->expiry - nowMs > (expiryMs - nowMs) / 2)
+        return false;
+
+    if (!append(encodeEntry(Kind::Datagram, datagram, expiryMs, nowMs, keys)))
+        return false;
+
+    m_stored.insert(payload, {expiryMs, keys});
+    return true;
+}
+
+bool WarmCache::remove(const QString &key, const QDateTime &now)
+{
+    const auto nowMs = now.toMSecsSinceEpoch();
+    auto expiryMs = std::optional<qint64>{};
+
+    for (auto it = m_stored.begin(); it != m_stored.end(); ) {
+        if (!it->keys.contains(key)) {
+            ++it;
+            continue;
+        }
+
+        if (it->expiry > nowMs)
+            expiryMs = std::max(expiryMs.value_or(nowMs), it->expiry);
+
+        it = m_stored.erase(it);
+    }
+
+    if (!expiryMs)
+        return false;
+
+    // the tombstone is needed no longer than the entries it suppresses
+    return append(encodeEntry(Kind::Tombstone, QNetworkDatagram{}, *expiryMs, nowMs, {key}));
+}
+
+bool WarmCache::openForAppending()
+{
+    if (m_file.isOpen())
+        return m_file.isWritable();
+
+    if (!m_file.open(QFile::WriteOnly | QFile::Append)) {
+        qCWarning(lcCache, "Could not open %ls: %ls",
+                  qUtf16Printable(m_file.fileName()),
+                  qUtf16Printable(m_file.errorString()));
+        return false;
+    }
+
+    if (m_file.size() == 0)
+        m_file.write(s_magic, s_magicSize);
+
+    return true;
+}
+
+bool WarmCache::append(const QByteArray &entry)
+{
+    if (!openForAppending())
+        return false;
+
+    if (m_file.write(entry) != entry.size() || !m_file.flush()) {
+        qCWarning(lcCache, "Could not write to %ls: %ls",
+                  qUtf16Printable(m_file.fileName()),
+                  qUtf16Printable(m_file.errorString()));
+        return false;
+    }
+
+    return true;
+}
+
+void WarmCache::rewrite(const QList<Entry> &entries)
+{
+    auto file = QSaveFile{m_file.fileName()};
+
+    if (!file.open(QFile::WriteOnly)) {
+        qCWarning(lcCache, "Could not rewrite %ls: %ls",
+                  qUtf16Printable(file.fileName()),
+                  qUtf16Printable(file.errorString()));
+        return;
+    }
+
+    file.write(s_magic, s_magicSize);
+
+    for (const auto &entry : entries)
+        file.write(encodeEntry(Kind::Datagram, entry.datagram, entry.expiry.toMSecsSinceEpoch(),
+                               entry.received.toMSecsSinceEpoch(), entry.keys));
+
+    if (!file.commit()) {
+        qCWarning(lcCache, "Could not rewrite %ls: %ls",
+                  qUtf16Printable(file.fileName()),
+                  qUtf16Printable(file.errorString()));
+    }
+}
+
+} // namespace qnc::core
@@ -0,0 +1,68 @@
+/* QtNetworkCrumbs - Some networking toys for Qt
+ * Copyright (C) 2019-2024 Mathias Hasselmann
+ */
+#ifndef QNCCORE_WARMCACHE_H
+#define QNCCORE_WARMCACHE_H
+
+// Qt headers
+#include <QDateTime>
+#include <QFile>
+#include <QHash>
+#include <QNetworkDatagram>
+#include <QStringList>
+
+namespace qnc::core {
+
+// Persists the datagrams that provided results, so that a resolver can replay them
+// right after starting, instead of showing nothing until the first responses arrive.
+// The file is an append-only log of binary entries, which gets memory-mapped for
+// loading, and which gets rewritten without expired entries once they dominate.
+// Entries are tagged with the keys of the results they provided, so that tombstones
+// appended by remove() can suppress them once these results are gone.
+class WarmCache
+{
+public:
+    struct Entry
+    {
+        QNetworkDatagram datagram = {};
+        QDateTime        expiry   = {};
+        QDateTime        received = {};
+        QStringList      keys     = {};
+    };
+
+    explicit WarmCache(const QString &fileName);
+
+    [[nodiscard]] QString fileName() const { return m_file.fileName(); }
+
+    // Reads all entries that have not expired, and that were not removed yet.
+    // Only the most recent entry is returned for datagrams that were stored
+    // multiple times.
+    [[nodiscard]] QList<Entry> load(const QDateTime &now = QDateTime::currentDateTimeUtc());
+
+    // Appends the datagram, received at now, to the file, unless the same
+    // datagram was stored recently, and still is valid for a while.
+    bool store(const QNetworkDatagram &datagram, const QDateTime &expiry, const QStringList &keys,
+               const QDateTime &now = QDateTime::currentDateTimeUtc());
+
+    // Appends a tombstone suppressing all entries stored before with this key,
+    // unless there are no such entries that still are valid.
+    bool remove(const QString &key, const QDateTime &now = QDateTime::currentDateTimeUtc());
+
+private:
+    struct StoredEntry
+    {
+        qint64      expiry = 0; // in ms since epoch
+        QStringList keys   = {};
+    };
+
+    [[nodiscard]] bool openForAppending();
+    [[nodiscard]] bool append(const QByteArray &entry);
+    void rewrite(const QList<Entry> &entries);
+
+    QFile                          m_file;
+    QHash<QByteArray, StoredEntry> m_stored; // the stored entries that were not removed, by payload
+};
+
+} // namespace qnc::core
+
+#endif // QNCCORE_WARMCACHE_H
@@ -0,0 +1,124 @@
+/* QtNetworkCrumbs - Some networking toys for Qt
+ * Copyright (C) 2019-2024 Mathias Hasselmann
+ */
+#include "discoveryclient.h"
+
+// Qt headers
+#include <QLocalSocket>
+#include <QLoggingCategory>
+
+namespace qnc::discovery {
+
+namespace {
+
+Q_LOGGING_CATEGORY(lcClient, "qnc.discovery.client")
+
+} // namespace
+
+Client::Client(QObject *parent)
+    : QObject{parent}
+    , m_socket{new QLocalSocket{this}}
+{
+    connect(m_socket, &QLocalSocket::connected, this, &Client::onConnected);
+    connect(m_socket, &QLocalSocket::disconnected, this, &Client::onDisconnected);
+    connect(m_socket, &QLocalSocket::readyRead, this, &Client::onReadyRead);
+}
+
+void Client::connectToServer(const QString &serverName)
+{
+    m_socket->abort();
+    m_socket->connectToServer(serverName);
+}
+
+void Client::disconnectFromServer()
+{
+    m_socket->disconnectFromServer();
+}
+
+bool Client::isConnected() const
+{
+    return m_socket->state() == QLocalSocket::ConnectedState;
+}
+
+QList<Record> Client::records() const
+{
+    return m_records.values();
+}
+
+void Client::onConnected()
+{
+    m_reader = {};
+    m_socket->write(protocol::encodeSubscribe());
+
+    emit connectedChanged(true);
+}
+
+void Client::onDisconnected()
+{
+    emit connectedChanged(false);
+}
+
+void Client::onReadyRead()
+{
+    m_reader.append(m_socket->readAll());
+
+    while (const auto message = m_reader.next()) {
+        if (!processMessage(*message)) {
+            qCWarning(lcClient, "Invalid message of type %d received",
+                      static_cast<int>(message->type));
+            m_socket->abort();
+            return;
+        }
+    }
+
+    if (!m_reader.isValid()) {
+        qCWarning(lcClient, "Invalid data received from discovery daemon");
+        m_socket->abort();
+    }
+}
+
+bool Client::processMessage(const protocol::Message &message)
+{
+    switch (message.type) {
+    case protocol::MessageType::Snapshot:
+        if (const auto records = protocol::decodeSnapshot(message.payload)) {
+            m_records.clear();
+
+            for (const auto &record : *records)
+                m_records.insert(record.key(), record);
+
+            emit snapshotReceived(*records);
+            return true;
+        }
+
+        break;
+
+    case protocol::MessageType::RecordFound:
+        if (const auto record = protocol::decodeRecordFound(message.payload)) {
+            m_records.insert(record->key(), *record);
+            emit recordFound(*record);
+            return true;
+        }
+
+        break;
+
+    case protocol::MessageType::RecordLost:
+        if (const auto key = protocol::decodeRecordLost(message.payload)) {
+            if (m_records.remove(*key) > 0)
+                emit recordLost(key->first, key->second);
+
+            return true;
+        }
+
+        break;
+
+    case protocol::MessageType::Subscribe:
+        break;
+    }
+
+    return false;
+}
+
+} // namespace qnc::discovery
+
+#include "moc_discoveryclient.cpp"
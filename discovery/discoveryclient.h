@@ -0,0 +1,57 @@
+/* QtNetworkCrumbs - Some networking toys for Qt
+ * Copyright (C) 2019-2024 Mathias Hasselmann
+ */
+#ifndef QNCDISCOVERY_DISCOVERYCLIENT_H
+#define QNCDISCOVERY_DISCOVERYCLIENT_H
+
+// QtNetworkCrumbs headers
+#include "discoveryprotocol.h"
+#include "discoveryrecord.h"
+
+// Qt headers
+#include <QMap>
+#include <QObject>
+
+class QLocalSocket;
+
+namespace qnc::discovery {
+
+// Receives the records found by a discovery daemon, instead of running resolvers
+// within this process. After connecting the client receives a snapshot of all
+// records known to the daemon, followed by changes as they happen.
+class Client : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(bool connected READ isConnected NOTIFY connectedChanged FINAL)
+
+public:
+    explicit Client(QObject *parent = nullptr);
+
+    void connectToServer(const QString &serverName = protocol::defaultServerName());
+    void disconnectFromServer();
+
+    [[nodiscard]] bool isConnected() const;
+    [[nodiscard]] QList<Record> records() const;
+
+signals:
+    void connectedChanged(bool connected);
+
+    // the records known to the daemon when subscribing, all earlier records are gone
+    void snapshotReceived(const QList<qnc::discovery::Record> &records);
+    void recordFound(const qnc::discovery::Record &record);
+    void recordLost(qnc::discovery::Record::Kind kind, const QString &name);
+
+private:
+    void onConnected();
+    void onDisconnected();
+    void onReadyRead();
+    bool processMessage(const protocol::Message &message);
+
+    QLocalSocket *const         m_socket;
+    protocol::MessageReader     m_reader;
+    QMap<Record::Key, Record>   m_records;
+};
+
+} // namespace qnc::discovery
+
+#endif // QNCDISCOVERY_DISCOVERYCLIENT_H
@@ -0,0 +1,82 @@
+/* QtNetworkCrumbs - Some networking toys for Qt
+ * Copyright (C) 2019-2024 Mathias Hasselmann
+ */
+
+// QtNetworkCrumbs headers
+#include "discoveryserver.h"
+#include "literals.h"
+#include "mdnsresolver.h"
+#include "ssdpresolver.h"
+
+// Qt headers
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QLoggingCategory>
+
+namespace qnc::discovery::daemon {
+namespace {
+
+Q_LOGGING_CATEGORY(lcDaemon, "discovery.daemon", QtInfoMsg)
+
+class DiscoveryDaemon : public QCoreApplication
+{
+public:
+    using QCoreApplication::QCoreApplication;
+
+    int run()
+    {
+        const auto serverName = QCommandLineOption{{"n"_L1, "name"_L1},
+                                                   tr("Name of the local socket to listen on"), tr("NAME"),
+                                                   protocol::defaultServerName()};
+        const auto mdnsServices = QCommandLineOption{{"m"_L1, "mdns-service"_L1},
+                                                     tr("mDNS service type to look up"), tr("TYPE")};
+        const auto ssdpServices = QCommandLineOption{{"s"_L1, "ssdp-service"_L1},
+                                                     tr("SSDP service type to look up"), tr("TYPE")};
+
+        auto commandLine = QCommandLineParser{};
+        commandLine.addOption(serverName);
+        commandLine.addOption(mdnsServices);
+        commandLine.addOption(ssdpServices);
+        commandLine.addHelpOption();
+        commandLine.process(arguments());
+
+        const auto server = new Server{this};
+
+        if (!server->listen(commandLine.value(serverName)))
+            return EXIT_FAILURE;
+
+        if (commandLine.isSet(mdnsServices)) {
+            const auto resolver = new mdns::Resolver{this};
+            resolver->setSharedTransport(true);
+            resolver->setPassiveListening(true);
+            server->addResolver(resolver);
+            resolver->lookupServices(commandLine.values(mdnsServices));
+        }
+
+        if (commandLine.isSet(ssdpServices)) {
+            const auto resolver = new ssdp::Resolver{this};
+            resolver->setSharedTransport(true);
+            resolver->setPassiveListening(true);
+            server->addResolver(resolver);
+
+            for (const auto &serviceType : commandLine.values(ssdpServices))
+                resolver->lookupService(serviceType);
+        }
+
+        connect(server, &Server::clientCountChanged, this, [](int count) {
+            qCInfo(lcDaemon, "%d clients connected", count);
+        });
+
+        qCInfo(lcDaemon, "Listening on %ls", qUtf16Printable(server->serverName()));
+
+        return exec();
+    }
+};
+
+} // namespace
+} // namespace qnc::discovery::daemon
+
+int main(int argc, char *argv[])
+{
+    return qnc::discovery::daemon::DiscoveryDaemon{argc, argv}.run();
+}
@@ -0,0 +1,136 @@
+/* QtNetworkCrumbs - Some networking toys for Qt
+ * Copyright (C) 2019-2024 Mathias Hasselmann
+ */
+#include "discoveryprotocol.h"
+
+// QtNetworkCrumbs headers
+#include "compat.h"
+#include "literals.h"
+
+// Qt headers
+#include <QDataStream>
+#include <QtEndian>
+
+namespace qnc::discovery::protocol {
+
+namespace {
+
+constexpr auto s_headerSize = 4 + 1; // size and message type
+
+// the daemon and its clients might be built with different versions of Qt
+constexpr auto s_streamVersion = QDataStream::Qt_5_15;
+
+template<typename... Args>
+QByteArray encode(MessageType type, const Args &...args)
+{
+    auto payload = QByteArray{};
+    auto stream = QDataStream{&payload, QIODevice::WriteOnly};
+    stream.setVersion(s_streamVersion);
+    (stream << ... << args);
+
+    const auto size = static_cast<quint32>(1 + payload.size());
+    auto message = QByteArray{s_headerSize, Qt::Uninitialized};
+
+    qToBigEndian(size, message.data());
+    message[4] = static_cast<char>(qToUnderlying(type));
+
+    return message + payload;
+}
+
+template<typename T>
+std::optional<T> decode(const QByteArray &payload)
+{
+    auto stream = QDataStream{payload};
+    stream.setVersion(s_streamVersion);
+
+    auto value = T{};
+    stream >> value;
+
+    if (stream.status() != QDataStream::Ok || !stream.atEnd())
+        return {};
+
+    return value;
+}
+
+} // namespace
+
+QString defaultServerName()
+{
+    return "qnc-discovery"_L1;
+}
+
+QByteArray encodeSubscribe()
+{
+    return encode(MessageType::Subscribe);
+}
+
+QByteArray encodeSnapshot(const QList<Record> &records)
+{
+    return encode(MessageType::Snapshot, records);
+}
+
+QByteArray encodeRecordFound(const Record &record)
+{
+    return encode(MessageType::RecordFound, record);
+}
+
+QByteArray encodeRecordLost(const Record::Key &key)
+{
+    return encode(MessageType::RecordLost, qToUnderlying(key.first), key.second);
+}
+
+std::optional<QList<Record>> decodeSnapshot(const QByteArray &payload)
+{
+    return decode<QList<Record>>(payload);
+}
+
+std::optional<Record> decodeRecordFound(const QByteArray &payload)
+{
+    auto record = decode<Record>(payload);
+
+    if (record && !record->isValid())
+        return {};
+
+    return record;
+}
+
+std::optional<Record::Key> decodeRecordLost(const QByteArray &payload)
+{
+    auto stream = QDataStream{payload};
+    stream.setVersion(s_streamVersion);
+
+    auto kind = quint8{};
+    auto name = QString{};
+    stream >> kind >> name;
+
+    if (stream.status() != QDataStream::Ok || !stream.atEnd()
+            || kind == qToUnderlying(Record::Kind::Invalid)
+            || kind > qToUnderlying(Record::Kind::SsdpService))
+        return {};
+
+    return Record::Key{static_cast<Record::Kind>(kind), std::move(name)};
+}
+
+std::optional<Message> MessageReader::next()
+{
+    if (!m_valid || m_buffer.size() < s_headerSize)
+        return {};
+
+    const auto size = qFromBigEndian<quint32>(m_buffer.constData());
+
+    if (size < 1 || size > s_maximumMessageSize) {
+        m_valid = false;
+        return {};
+    }
+
+    if (static_cast<quint32>(m_buffer.size() - 4) < size)
+        return {};
+
+    const auto payloadSize = static_cast<core::literals::compat::lentype>(size - 1);
+    auto message = Message{static_cast<MessageType>(m_buffer[4]), m_buffer.mid(s_headerSize, payloadSize)};
+    m_buffer.remove(0, s_headerSize + payloadSize);
+
+    return message;
+}
+
+} // namespace qnc::discovery::protocol
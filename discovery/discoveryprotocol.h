@@ -0,0 +1,66 @@
+/* QtNetworkCrumbs - Some networking toys for Qt
+ * Copyright (C) 2019-2024 Mathias Hasselmann
+ */
+#ifndef QNCDISCOVERY_DISCOVERYPROTOCOL_H
+#define QNCDISCOVERY_DISCOVERYPROTOCOL_H
+
+// QtNetworkCrumbs headers
+#include "discoveryrecord.h"
+
+// Qt headers
+#include <QByteArray>
+
+// STL headers
+#include <optional>
+
+namespace qnc::discovery::protocol {
+
+// Messages are framed by their size as 32-bit big-endian integer, followed
+// by a single byte for the message type, and by the type's payload as
+// serialized by QDataStream.
+enum class MessageType : quint8 {
+    Subscribe   = 1,    // client => server: no payload
+    Snapshot    = 2,    // server => client: all current records
+    RecordFound = 3,    // server => client: a new or a changed record
+    RecordLost  = 4,    // server => client: the kind and name of a record
+};
+
+constexpr auto s_maximumMessageSize = quint32{16 * 1024 * 1024};
+
+// The local socket name a daemon listens on if nothing else is configured.
+[[nodiscard]] QString defaultServerName();
+
+[[nodiscard]] QByteArray encodeSubscribe();
+[[nodiscard]] QByteArray encodeSnapshot(const QList<Record> &records);
+[[nodiscard]] QByteArray encodeRecordFound(const Record &record);
+[[nodiscard]] QByteArray encodeRecordLost(const Record::Key &key);
+
+[[nodiscard]] std::optional<QList<Record>> decodeSnapshot(const QByteArray &payload);
+[[nodiscard]] std::optional<Record> decodeRecordFound(const QByteArray &payload);
+[[nodiscard]] std::optional<Record::Key> decodeRecordLost(const QByteArray &payload);
+
+struct Message
+{
+    MessageType type    = {};
+    QByteArray  payload = {};
+};
+
+// Splits the byte stream received from a local socket into messages.
+class MessageReader
+{
+public:
+    void append(const QByteArray &data) { m_buffer.append(data); }
+
+    // Returns the next complete message, if any. Returns nothing
+    // if the stream is corrupt; see isValid() to tell the difference.
+    [[nodiscard]] std::optional<Message> next();
+    [[nodiscard]] bool isValid() const { return m_valid; }
+
+private:
+    QByteArray m_buffer;
+    bool       m_valid = true;
+};
+
+} // namespace qnc::discovery::protocol
+
+#endif // QNCDISCOVERY_DISCOVERYPROTOCOL_H
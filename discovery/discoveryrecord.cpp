@@ -0,0 +1,99 @@
+/* QtNetworkCrumbs - Some networking toys for Qt
+ * Copyright (C) 2019-2024 Mathias Hasselmann
+ */
+#include "discoveryrecord.h"
+
+// QtNetworkCrumbs headers
+#include "compat.h"
+
+// Qt headers
+#include <QDataStream>
+#include <QDebug>
+
+namespace qnc::discovery {
+
+Record::Record(Kind                kind,
+               QString             name,
+               QString             type,
+               QList<QHostAddress> addresses,
+               QList<QUrl>         locations,
+               QStringList         info,
+               QDateTime           expiry)
+    : m_kind     {kind}
+    , m_name     {std::move(name)}
+    , m_type     {std::move(type)}
+    , m_addresses{std::move(addresses)}
+    , m_locations{std::move(locations)}
+    , m_info     {std::move(info)}
+    , m_expiry   {std::move(expiry)}
+{}
+
+bool Record::operator==(const Record &rhs) const
+{
+    return m_kind == rhs.m_kind
+            && m_name == rhs.m_name
+            && m_type == rhs.m_type
+            && m_addresses == rhs.m_addresses
+            && m_locations == rhs.m_locations
+            && m_info == rhs.m_info
+            && m_expiry == rhs.m_expiry;
+}
+
+QDataStream &operator<<(QDataStream &stream, const Record &record)
+{
+    return stream << qToUnderlying(record.kind())
+                  << record.name()
+                  << record.type()
+                  << record.addresses()
+                  << record.locations()
+                  << record.info()
+                  << record.expiry();
+}
+
+QDataStream &operator>>(QDataStream &stream, Record &record)
+{
+    auto kind = quint8{};
+    auto name = QString{};
+    auto type = QString{};
+    auto addresses = QList<QHostAddress>{};
+    auto locations = QList<QUrl>{};
+    auto info = QStringList{};
+    auto expiry = QDateTime{};
+
+    stream >> kind >> name >> type >> addresses >> locations >> info >> expiry;
+
+    if (kind > qToUnderlying(Record::Kind::SsdpService))
+        stream.setStatus(QDataStream::ReadCorruptData);
+
+    if (stream.status() != QDataStream::Ok) {
+        record = {};
+        return stream;
+    }
+
+    record = {static_cast<Record::Kind>(kind), std::move(name), std::move(type),
+              std::move(addresses), std::move(locations), std::move(info), std::move(expiry)};
+
+    return stream;
+}
+
+} // namespace qnc::discovery
+
+QDebug operator<<(QDebug debug, const qnc::discovery::Record &record)
+{
+    const auto _ = QDebugStateSaver{debug};
+
+    if (debug.verbosity() >= QDebug::DefaultVerbosity)
+        debug.nospace() << record.staticMetaObject.className();
+
+    return debug.nospace()
+            << "("            << record.kind()
+            << ", name="      << record.name()
+            << ", type="      << record.type()
+            << ", addresses=" << record.addresses()
+            << ", locations=" << record.locations()
+            << ", info="      << record.info()
+            << ", expiry="    << record.expiry()
+            << ")";
+}
+
+#include "moc_discoveryrecord.cpp"
@@ -0,0 +1,95 @@
+/* QtNetworkCrumbs - Some networking toys for Qt
+ * Copyright (C) 2019-2024 Mathias Hasselmann
+ */
+#ifndef QNCDISCOVERY_DISCOVERYRECORD_H
+#define QNCDISCOVERY_DISCOVERYRECORD_H
+
+// Qt headers
+#include <QDateTime>
+#include <QHash>
+#include <QHostAddress>
+#include <QUrl>
+
+// STL headers
+#include <utility>
+
+class QDataStream;
+
+namespace qnc::discovery {
+
+// Something found by the resolvers of a discovery daemon: a host name, an mDNS
+// service, or an SSDP service. Records are identified by their kind and name.
+class Record
+{
+    Q_GADGET
+    Q_PROPERTY(Kind                kind      READ kind      CONSTANT FINAL)
+    Q_PROPERTY(QString             name      READ name      CONSTANT FINAL)
+    Q_PROPERTY(QString             type      READ type      CONSTANT FINAL)
+    Q_PROPERTY(QList<QHostAddress> addresses READ addresses CONSTANT FINAL)
+    Q_PROPERTY(QList<QUrl>         locations READ locations CONSTANT FINAL)
+    Q_PROPERTY(QStringList         info      READ info      CONSTANT FINAL)
+    Q_PROPERTY(QDateTime           expiry    READ expiry    CONSTANT FINAL)
+
+public:
+    enum class Kind : quint8 {
+        Invalid,
+        HostName,
+        MdnsService,
+        SsdpService,
+    };
+
+    Q_ENUM(Kind)
+
+    using Key = std::pair<Kind, QString>;
+
+    Record() = default;
+    Record(Kind                kind,
+           QString             name,
+           QString             type      = {},
+           QList<QHostAddress> addresses = {},
+           QList<QUrl>         locations = {},
+           QStringList         info      = {},
+           QDateTime           expiry    = {});
+
+    [[nodiscard]] Kind                kind()      const { return m_kind; }
+    [[nodiscard]] QString             name()      const { return m_name; }
+    [[nodiscard]] QString             type()      const { return m_type; }
+    [[nodiscard]] QList<QHostAddress> addresses() const { return m_addresses; }
+    [[nodiscard]] QList<QUrl>         locations() const { return m_locations; }
+    [[nodiscard]] QStringList         info()      const { return m_info; }
+    [[nodiscard]] QDateTime           expiry()    const { return m_expiry; }
+
+    [[nodiscard]] Key key() const { return {m_kind, m_name}; }
+    [[nodiscard]] bool isValid() const { return m_kind != Kind::Invalid; }
+
+    [[nodiscard]] bool operator==(const Record &rhs) const;
+    [[nodiscard]] bool operator!=(const Record &rhs) const { return !(*this == rhs); }
+
+private:
+    Kind                m_kind = Kind::Invalid;
+    QString             m_name;
+    QString             m_type;
+    QList<QHostAddress> m_addresses;
+    QList<QUrl>         m_locations;
+    QStringList         m_info;
+    QDateTime           m_expiry;
+};
+
+QDataStream &operator<<(QDataStream &stream, const Record &record);
+QDataStream &operator>>(QDataStream &stream, Record &record);
+
+#if QT_VERSION_MAJOR < 6
+
+// Qt 5 cannot hash scoped enums, but Record::Key must be hashable.
+inline uint qHash(Record::Kind kind, uint seed = 0) noexcept
+{
+    return ::qHash(static_cast<quint8>(kind), seed);
+}
+
+#endif // QT_VERSION_MAJOR < 6
+
+} // namespace qnc::discovery
+
+QDebug operator<<(QDebug debug, const qnc::discovery::Record &record);
+
+#endif // QNCDISCOVERY_DISCOVERYRECORD_H
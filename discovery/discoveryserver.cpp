@@ -0,0 +1,247 @@
+/* QtNetworkCrumbs - Some networking toys for Qt
+ * Copyright (C) 2019-2024 Mathias Hasselmann
+ */
+#include "discoveryserver.h"
+
+// QtNetworkCrumbs headers
+#include "mdnsresolver.h"
+#include "ssdpresolver.h"
+
+// Qt headers
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QLoggingCategory>
+
+namespace qnc::discovery {
+
+namespace {
+
+Q_LOGGING_CATEGORY(lcServer, "qnc.discovery.server")
+
+// clients that cannot keep up get disconnected; they get a fresh snapshot when reconnecting
+constexpr auto s_maximumBacklog = qint64{4 * 1024 * 1024};
+
+// host name signals don't carry the time to life, so the one RFC 6762 recommends is assumed
+constexpr auto s_hostNameLifetime = 120;
+
+// the time to wait for a running server answering on the socket, before taking it over
+constexpr auto s_probeTimeout = 1000;
+
+Record makeRecord(const QString &hostName, const QList<QHostAddress> &addresses)
+{
+    return {Record::Kind::HostName, hostName, {}, addresses, {}, {},
+            QDateTime::currentDateTimeUtc().addSecs(s_hostNameLifetime)};
+}
+
+Record makeRecord(const mdns::ServiceDescription &service)
+{
+    return {Record::Kind::MdnsService, service.name(), service.type(),
+            {}, service.locations(), service.info(), service.expires()};
+}
+
+// The SSDP resolver reports expired services as lost, but reports refreshed ones
+// only when they changed. Therefore these records don't get an expiry of their own.
+Record makeRecord(const ssdp::ServiceDescription &service)
+{
+    return {Record::Kind::SsdpService, service.name(), service.type(),
+            {}, service.locations() + service.alternativeLocations()};
+}
+
+// The expiry changes with each announcement, but is not worth telling the clients.
+bool isSameContent(const Record &lhs, const Record &rhs)
+{
+    return lhs.kind() == rhs.kind()
+            && lhs.name() == rhs.name()
+            && lhs.type() == rhs.type()
+            && lhs.addresses() == rhs.addresses()
+            && lhs.locations() == rhs.locations()
+            && lhs.info() == rhs.info();
+}
+
+} // namespace
+
+Server::Server(QObject *parent)
+    : QObject{parent}
+    , m_server{new QLocalServer{this}}
+    , m_expiries{this, [this](const QList<Record::Key> &keys) { expireRecords(keys); }}
+{
+    connect(m_server, &QLocalServer::newConnection, this, &Server::onNewConnection);
+}
+
+bool Server::listen(const QString &serverName)
+{
+    // a running instance of the daemon must keep its socket
+    auto probe = QLocalSocket{};
+    probe.connectToServer(serverName);
+
+    if (probe.waitForConnected(s_probeTimeout)) {
+        qCWarning(lcServer, "Another server already listens on %ls", qUtf16Printable(serverName));
+        return false;
+    }
+
+    // but a previous instance might have crashed, leaving a stale socket file
+    QLocalServer::removeServer(serverName);
+
+    if (!m_server->listen(serverName)) {
+        qCWarning(lcServer, "Could not listen on %ls: %ls",
+                  qUtf16Printable(serverName),
+                  qUtf16Printable(m_server->errorString()));
+        return false;
+    }
+
+    return true;
+}
+
+QString Server::serverName() const
+{
+    return m_server->serverName();
+}
+
+void Server::addResolver(mdns::Resolver *resolver)
+{
+    connect(resolver, &mdns::Resolver::hostNameFound, this,
+            [this](const QString &hostName, const QList<QHostAddress> &addresses) {
+        publish(makeRecord(hostName, addresses));
+    });
+
+    connect(resolver, &mdns::Resolver::serviceFound, this,
+            [this](const mdns::ServiceDescription &service) {
+        // services saying goodbye are reported with a time to life of zero
+        if (service.expires().isValid() && service.expires() <= QDateTime::currentDateTimeUtc())
+            withdraw(Record::Kind::MdnsService, service.name());
+        else
+            publish(makeRecord(service));
+    });
+}
+
+void Server::addResolver(ssdp::Resolver *resolver)
+{
+    connect(resolver, &ssdp::Resolver::serviceFound, this,
+            [this](const ssdp::ServiceDescription &service) {
+        publish(makeRecord(service));
+    });
+
+    connect(resolver, &ssdp::Resolver::serviceLost, this,
+            [this](const QString &serviceName) {
+        withdraw(Record::Kind::SsdpService, serviceName);
+    });
+}
+
+QList<Record> Server::records() const
+{
+    return m_records.values();
+}
+
+int Server::clientCount() const
+{
+    return static_cast<int>(m_clients.size());
+}
+
+void Server::publish(const Record &record)
+{
+    if (!record.isValid())
+        return;
+
+    auto &storedRecord = m_records[record.key()];
+    const auto isChanged = !isSameContent(std::exchange(storedRecord, record), record);
+
+    m_expiries.insert(record.key(), record.expiry());
+
+    // refreshed expiries are not worth flooding the clients
+    if (!isChanged)
+        return;
+
+    broadcast(protocol::encodeRecordFound(record));
+}
+
+void Server::withdraw(Record::Kind kind, const QString &name)
+{
+    const auto key = Record::Key{kind, name};
+
+    m_expiries.remove(key);
+
+    if (m_records.remove(key) > 0)
+        broadcast(protocol::encodeRecordLost(key));
+}
+
+void Server::onNewConnection()
+{
+    while (const auto client = m_server->nextPendingConnection()) {
+        connect(client, &QLocalSocket::readyRead, this, [this, client] {
+            onReadyRead(client);
+        });
+
+        connect(client, &QLocalSocket::disconnected, this, [this, client] {
+            onDisconnected(client);
+        });
+
+        m_clients.insert(client, {});
+        emit clientCountChanged(clientCount());
+    }
+}
+
+void Server::onReadyRead(QLocalSocket *client)
+{
+    const auto it = m_clients.find(client);
+
+    if (it == m_clients.end())
+        return;
+
+    it->reader.append(client->readAll());
+
+    while (const auto message = it->reader.next()) {
+        if (message->type != protocol::MessageType::Subscribe || !message->payload.isEmpty()) {
+            qCWarning(lcServer, "Unexpected message of type %d received",
+                      static_cast<int>(message->type));
+            client->abort();
+            return;
+        }
+
+        if (!std::exchange(it->subscribed, true))
+            client->write(protocol::encodeSnapshot(m_records.values()));
+    }
+
+    if (!it->reader.isValid()) {
+        qCWarning(lcServer, "Invalid data received from client");
+        client->abort();
+    }
+}
+
+void Server::onDisconnected(QLocalSocket *client)
+{
+    if (m_clients.remove(client) > 0) {
+        client->deleteLater();
+        emit clientCountChanged(clientCount());
+    }
+}
+
+void Server::broadcast(const QByteArray &message)
+{
+    auto slowClients = QList<QLocalSocket *>{};
+
+    for (auto it = m_clients.cbegin(); it != m_clients.cend(); ++it) {
+        if (!it->subscribed)
+            continue;
+
+        if (it.key()->bytesToWrite() > s_maximumBacklog)
+            slowClients.append(it.key());
+        else
+            it.key()->write(message);
+    }
+
+    // aborting emits disconnected() immediately, which modifies m_clients
+    for (const auto client : slowClients) {
+        qCWarning(lcServer, "Disconnecting client that doesn't keep up");
+        client->abort();
+    }
+}
+
+void Server::expireRecords(const QList<Record::Key> &keys)
+{
+    for (const auto &[kind, name] : keys)
+        withdraw(kind, name);
+}
+
+} // namespace qnc::discovery
+
+#include "moc_discoveryserver.cpp"
@@ -0,0 +1,79 @@
+/* QtNetworkCrumbs - Some networking toys for Qt
+ * Copyright (C) 2019-2024 Mathias Hasselmann
+ */
+#ifndef QNCDISCOVERY_DISCOVERYSERVER_H
+#define QNCDISCOVERY_DISCOVERYSERVER_H
+
+// QtNetworkCrumbs headers
+#include "discoveryprotocol.h"
+#include "discoveryrecord.h"
+#include "expirytable.h"
+
+// Qt headers
+#include <QMap>
+#include <QObject>
+
+class QLocalServer;
+class QLocalSocket;
+
+namespace qnc::mdns {
+class Resolver;
+} // namespace qnc::mdns
+
+namespace qnc::ssdp {
+class Resolver;
+} // namespace qnc::ssdp
+
+namespace qnc::discovery {
+
+// The heart of a discovery daemon: Collects the records found by the resolvers
+// added to it, and serves them to Client instances of other processes via a
+// local socket. This way only the daemon does multicast I/O and parses
+// messages, no matter how many processes are interested in the results.
+class Server : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(int clientCount READ clientCount NOTIFY clientCountChanged FINAL)
+
+public:
+    explicit Server(QObject *parent = nullptr);
+
+    bool listen(const QString &serverName = protocol::defaultServerName());
+    [[nodiscard]] QString serverName() const;
+
+    // Publishes the results of this resolver. The server does not take ownership.
+    void addResolver(mdns::Resolver *resolver);
+    void addResolver(ssdp::Resolver *resolver);
+
+    [[nodiscard]] QList<Record> records() const;
+    [[nodiscard]] int clientCount() const;
+
+public slots:
+    void publish(const qnc::discovery::Record &record);
+    void withdraw(qnc::discovery::Record::Kind kind, const QString &name);
+
+signals:
+    void clientCountChanged(int count);
+
+private:
+    struct Subscriber
+    {
+        protocol::MessageReader reader     = {};
+        bool                    subscribed = false;
+    };
+
+    void onNewConnection();
+    void onReadyRead(QLocalSocket *client);
+    void onDisconnected(QLocalSocket *client);
+    void broadcast(const QByteArray &message);
+    void expireRecords(const QList<Record::Key> &keys);
+
+    QLocalServer *const                 m_server;
+    core::ExpiryTable<Record::Key>      m_expiries;
+    QMap<Record::Key, Record>           m_records;
+    QHash<QLocalSocket *, Subscriber>   m_clients;
+};
+
+} // namespace qnc::discovery
+
+#endif // QNCDISCOVERY_DISCOVERYSERVER_H
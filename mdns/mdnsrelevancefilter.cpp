@@ -0,0 +1,193 @@
+/* QtNetworkCrumbs - Some networking toys for Qt
+ * Copyright (C) 2019-2024 Mathias Hasselmann
+ */
+#include "mdnsrelevancefilter.h"
+
+// QtNetworkCrumbs headers
+#include "mdnsmessage.h"
+
+// STL headers
+#include <algorithm>
+#include <optional>
+
+namespace qnc::mdns {
+
+namespace {
+
+constexpr auto s_headerSize            = 12;
+constexpr auto s_offsetFlags           = 2;
+constexpr auto s_offsetQuestionCount   = 4;
+constexpr auto s_offsetAnswerCount     = 6;
+constexpr auto s_offsetAuthorityCount  = 8;
+constexpr auto s_offsetAdditionalCount = 10;
+
+constexpr auto s_questionFieldsSize    = 4;  // type, class
+constexpr auto s_recordFieldsSize      = 10; // type, class, ttl, data length
+constexpr auto s_recordOffsetLength    = 8;
+constexpr auto s_maximumNameSize       = 255;
+
+// FNV-1a, which is good enough for the few dozen names of some queries
+constexpr auto s_hashOffsetBasis       = quint64{0xcbf29ce484222325};
+constexpr auto s_hashPrime             = quint64{0x100000001b3};
+
+struct NameHashes
+{
+    quint64 name   = s_hashOffsetBasis;
+    quint64 parent = s_hashOffsetBasis;
+    int     end    = -1; // where the encoded name ends, ignoring compression pointers
+};
+
+quint16 u16(const QByteArray &data, int offset)
+{
+    return static_cast<quint16>((static_cast<quint8>(data[offset]) << 8)
+                                | static_cast<quint8>(data[offset + 1]));
+}
+
+constexpr quint64 hashByte(quint64 hash, quint8 byte)
+{
+    return (hash ^ byte) * s_hashPrime;
+}
+
+constexpr quint8 toLower(quint8 ch)
+{
+    return (ch >= 'A' && ch <= 'Z') ? static_cast<quint8>(ch | 0x20) : ch;
+}
+
+// Hashes the name at offset, and the name of its parent, following compression
+// pointers. Returns nothing for malformed names, including pointer loops.
+std::optional<NameHashes> hashName(const QByteArray &data, int offset)
+{
+    const auto size = static_cast<int>(data.size());
+    auto hashes = NameHashes{};
+    auto nameSize = 0;
+
+    for (auto position = offset; position < size; ) {
+        const auto length = static_cast<quint8>(data[position]);
+
+        if ((length & 0xc0) == 0xc0) {
+            if (position + 1 >= size)
+                return {};
+
+            const auto target = ((length & 0x3f) << 8) | static_cast<quint8>(data[position + 1]);
+
+            if (hashes.end < 0)
+                hashes.end = position + 2;
+
+            // only permit pointers to earlier positions, so that they cannot loop
+            if (target >= position)
+                return {};
+
+            position = target;
+            continue;
+        }
+
+        if ((length & 0xc0) != 0) // reserved label types
+            return {};
+
+        nameSize += 1 + length;
+
+        if (position + 1 + length > size || nameSize > s_maximumNameSize)
+            return {};
+
+        const auto isFirstLabel = (nameSize == 1 + length);
+
+        for (auto i = position; i <= position + length; ++i) {
+            // the label's length is part of the hash, so that labels cannot run into each other
+            const auto ch = toLower(static_cast<quint8>(data[i]));
+
+            hashes.name = hashByte(hashes.name, ch);
+
+            if (!isFirstLabel)
+                hashes.parent = hashByte(hashes.parent, ch);
+        }
+
+        if (length == 0) {
+            if (hashes.end < 0)
+                hashes.end = position + 1;
+
+            return hashes;
+        }
+
+        position += 1 + length;
+    }
+
+    return {};
+}
+
+} // namespace
+
+RelevanceFilter::RelevanceFilter(const QByteArrayList &queries)
+{
+    for (const auto &query : queries) {
+        if (query.size() < s_headerSize)
+            continue;
+
+        auto offset = s_headerSize;
+
+        for (auto i = u16(query, s_offsetQuestionCount); i > 0; --i) {
+            const auto hashes = hashName(query, offset);
+
+            if (!hashes)
+                break;
+
+            m_nameHashes.push_back(hashes->name);
+            offset = hashes->end + s_questionFieldsSize;
+        }
+    }
+
+    std::sort(m_nameHashes.begin(), m_nameHashes.end());
+    m_nameHashes.erase(std::unique(m_nameHashes.begin(), m_nameHashes.end()), m_nameHashes.end());
+}
+
+bool RelevanceFilter::isRelevant(const QByteArray &message) const
+{
+    const auto size = static_cast<int>(message.size());
+
+    if (size < s_headerSize)
+        return false;
+
+    // reject queries from other hosts, and failed responses, by just looking at the header
+    const auto flags = u16(message, s_offsetFlags);
+
+    if ((flags & Message::IsResponse) == 0)
+        return false;
+    if ((flags & (Message::OperationCode | Message::ResponseCode)) != 0)
+        return false;
+
+    auto offset = s_headerSize;
+
+    for (auto i = u16(message, s_offsetQuestionCount); i > 0; --i) {
+        const auto hashes = hashName(message, offset);
+
+        if (!hashes)
+            return false;
+
+        offset = hashes->end + s_questionFieldsSize;
+    }
+
+    const auto recordCount = u16(message, s_offsetAnswerCount)
+            + u16(message, s_offsetAuthorityCount)
+            + u16(message, s_offsetAdditionalCount);
+
+    for (auto i = 0; i < recordCount; ++i) {
+        const auto hashes = hashName(message, offset);
+
+        if (!hashes || hashes->end + s_recordFieldsSize > size)
+            return false;
+
+        // the record's name is a subscribed name, or its child, like a service instance
+        if (contains(hashes->name) || contains(hashes->parent))
+            return true;
+
+        offset = hashes->end + s_recordFieldsSize + u16(message, hashes->end + s_recordOffsetLength);
+    }
+
+    return false;
+}
+
+bool RelevanceFilter::contains(quint64 nameHash) const
+{
+    return std::binary_search(m_nameHashes.cbegin(), m_nameHashes.cend(), nameHash);
+}
+
+} // namespace qnc::mdns
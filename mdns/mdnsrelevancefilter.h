@@ -0,0 +1,37 @@
+/* QtNetworkCrumbs - Some networking toys for Qt
+ * Copyright (C) 2019-2024 Mathias Hasselmann
+ */
+#ifndef QNCMDNS_MDNSRELEVANCEFILTER_H
+#define QNCMDNS_MDNSRELEVANCEFILTER_H
+
+// Qt headers
+#include <QByteArrayList>
+
+// STL headers
+#include <vector>
+
+namespace qnc::mdns {
+
+// Decides on the raw wire format, without decoding and without allocating memory,
+// whether a message concerns any of the names asked for by some queries: Only
+// successful responses get accepted, and only if the name of one of their records,
+// or the parent of that name, is the name of a question. Names get compared by
+// their hashes, ignoring case; collisions only cause some needless decoding.
+class RelevanceFilter
+{
+public:
+    RelevanceFilter() = default;
+    explicit RelevanceFilter(const QByteArrayList &queries);
+
+    [[nodiscard]] bool isEmpty() const { return m_nameHashes.empty(); }
+    [[nodiscard]] bool isRelevant(const QByteArray &message) const;
+
+private:
+    [[nodiscard]] bool contains(quint64 nameHash) const;
+
+    std::vector<quint64> m_nameHashes;
+};
+
+} // namespace qnc::mdns
+
+#endif // QNCMDNS_MDNSRELEVANCEFILTER_H
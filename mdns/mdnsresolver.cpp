@@ -5,18 +5,21 @@
 
 // QtNetworkCrumbs headers
 #include "mdnsmessage.h"
+#include "mdnsrelevancefilter.h"
 #include "mdnsurlfinder.h"
 #include "literals.h"
 
 // Qt headers
 #include <QHostAddress>
 #include <QLoggingCategory>
+#include <QMetaMethod>
 #include <QNetworkDatagram>
 #include <QNetworkInterface>
 #include <QTimer>
 #include <QUdpSocket>
 
 // STL headers
+#include <algorithm>
 #include <unordered_map>
 
 namespace qnc::mdns {
@@ -29,6 +32,18 @@ constexpr auto s_mdnsUnicastIPv4 = "224.0.0.251"_L1;
 constexpr auto s_mdnsUnicastIPv6 = "ff02::fb"_L1;
 constexpr auto s_mdnsPort = 5353;
 
+// offsets of the DNS header fields, relative to the UDP header as seen by socket filters
+constexpr auto s_filterOffsetFlags           = quint32{8 + 2};
+constexpr auto s_filterOffsetQuestionCount   = quint32{8 + 4};
+constexpr auto s_filterOffsetAnswerCount     = quint32{8 + 6};
+constexpr auto s_filterOffsetAuthorityCount  = quint32{8 + 8};
+constexpr auto s_filterOffsetAdditionalCount = quint32{8 + 10};
+constexpr auto s_filterOffsetFirstName       = quint32{8 + 12};
+
+// keeps the jumps within each name check short enough for classic BPF
+constexpr auto s_filterMaximumNameSize = 96;
+constexpr auto s_filterMaximumNameCount = 16;
+
 auto normalizedHostName(QByteArray name, QString domain)
 {
     auto normalizedName = QString::fromLatin1(name);
@@ -76,15 +91,143 @@ auto parseTxtRecord(const QByteArray &txtRecord)
     return stringList;
 }
 
+auto wireFormat(const QByteArray &name)
+{
+    auto wireName = QByteArray{};
+
+    for (const auto &label : name.toLower().split('.')) {
+        if (!label.isEmpty() && label.size() < 64) {
+            wireName += static_cast<char>(label.size());
+            wireName += label;
+        }
+    }
+
+    wireName += '\0';
+    return wireName;
+}
+
+void compareName(core::SocketFilter &filter, const QByteArray &wireName,
+                 quint32 offset, bool indexed, core::SocketFilter::Label mismatch)
+{
+    using Size = core::SocketFilter::Size;
+    using Label = core::SocketFilter::Label;
+
+    for (auto i = 0; i < wireName.size(); ) {
+        const auto remaining = wireName.size() - i;
+        const auto width = remaining >= 4 ? 4 : remaining >= 2 ? 2 : 1;
+        const auto size = width == 4 ? Size::Word : width == 2 ? Size::HalfWord : Size::Byte;
+
+        auto value = quint32{0};
+        auto caseMask = quint32{0};
+
+        for (auto j = 0; j < width; ++j) {
+            const auto ch = static_cast<quint8>(wireName[i + j]);
+            const auto isLetter = (ch >= 'a' && ch <= 'z');
+
+            value = (value << 8) | ch;
+            caseMask = (caseMask << 8) | (isLetter ? 0x20U : 0x00U);
+        }
+
+        const auto fieldOffset = offset + static_cast<quint32>(i);
+
+        if (indexed)
+            filter.loadIndexed(size, fieldOffset);
+        else
+            filter.load(size, fieldOffset);
+
+        if (caseMask)
+            filter.bitwiseOr(caseMask);
+
+        filter.jumpIfEqual(value, Label::next(), mismatch);
+        i += width;
+    }
+}
+
+struct DecodedService
+{
+    ServiceRecord record;
+    QStringList   info;
+    qint64        timeToLife;
+};
+
+struct DecodedHost
+{
+    QList<QHostAddress> addresses;
+    qint64              timeToLife; // the shortest one of the address records
+};
+
+struct DecodedMessage
+{
+    Message message;
+    std::unordered_map<QByteArray, DecodedHost> hosts;
+    std::unordered_map<QByteArray, DecodedService> services;
+};
+
+// does not touch any resolver state, so that it can run in a decoder pool
+DecodedMessage decodeMessage(const QByteArray &data, Resolver::Interests interests)
+{
+    auto decoded = DecodedMessage{Message{data}, {}, {}};
+    auto resolvedServices = std::unordered_map<QByteArray, std::pair<ServiceRecord, qint64>>{};
+    auto resolvedText = std::unordered_map<QByteArray, QByteArray>{};
+
+    for (auto i = 0; i < decoded.message.responseCount(); ++i) {
+        const auto response = decoded.message.response(i);
+
+        // check the record type first, as decoding names and addresses is not for free
+        switch (response.type()) {
+        case Message::A:
+        case Message::AAAA:
+            if (!interests.testFlag(Resolver::HostNames))
+                continue;
+
+            break;
+
+        case Message::SRV:
+        case Message::TXT:
+            if (!interests.testFlag(Resolver::Services))
+                continue;
+
+            break;
+
+        default:
+            continue;
+        }
+
+        if (const auto address = response.address(); !address.isNull()) {
+            const auto [it, isNewHost] = decoded.hosts.insert({response.name().toByteArray(),
+                                                               {{}, response.timeToLife()}});
+            auto &host = it->second;
+
+            if (!isNewHost)
+                host.timeToLife = std::min(host.timeToLife, response.timeToLife());
+            if (!host.addresses.contains(address))
+                host.addresses.append(address);
+        } else if (const auto service = response.service(); !service.isNull()) {
+            resolvedServices.insert({response.name().toByteArray(), {service, response.timeToLife()}});
+        } else if (const auto text = response.text(); !text.isNull()) {
+            resolvedText.insert({response.name().toByteArray(), text});
+        }
+    }
+
+    for (const auto &[name, service]: resolvedServices) {
+        auto info = parseTxtRecord(resolvedText[name]);
+        decoded.services.emplace(name, DecodedService{service.first, std::move(info), service.second});
+    }
+
+    return decoded;
+}
+
 } // namespace
 
-ServiceDescription::ServiceDescription(QString domain, QByteArray name, ServiceRecord service, QStringList info)
+ServiceDescription::ServiceDescription(QString domain, QByteArray name, ServiceRecord service,
+                                       QStringList info, QDateTime expires)
     : m_name{normalizedHostName(name, domain)}
     , m_target{qualifiedHostName(service.target().toString(), domain)}
     , m_port{service.port()}
     , m_priority{service.priority()}
     , m_weight{service.weight()}
     , m_info{std::move(info)}
+    , m_expires{std::move(expires)}
 {
     if (const auto separator = m_name.indexOf('.'_L1); separator >= 0) {
         m_type = m_name.mid(separator + 1);
@@ -112,8 +255,15 @@ QList<QUrl> ServiceDescription::locations() const
 Resolver::Resolver(QObject *parent)
     : core::MulticastResolver{parent}
     , m_domain{"local"_L1}
+    , m_interests{Interests{}}
 {}
 
+Resolver::~Resolver()
+{
+    // the decoders read the interests and the relevance filter
+    stopDecoders();
+}
+
 void Resolver::setDomain(QString domain)
 {
     if (std::exchange(m_domain, domain) != domain)
@@ -142,6 +292,163 @@ QHostAddress Resolver::multicastGroup(const QHostAddress &address) const
     return {};
 }
 
+core::SocketFilter Resolver::socketFilter() const
+{
+    using Label = core::SocketFilter::Label;
+    using Size = core::SocketFilter::Size;
+
+    // somebody wants to see every message, unless we are overloaded
+    if (!isOverloaded() && isReceivingAllMessages())
+        return {};
+
+    auto filter = core::SocketFilter{};
+
+    // only accept messages from mDNS responders
+    const auto isResponder = filter.createLabel();
+    filter.load(Size::HalfWord, 0);
+    filter.jumpIfEqual(port(), isResponder, Label::next());
+    filter.reject();
+    filter.bindLabel(isResponder);
+
+    // only accept successful standard responses
+    const auto isQuery = filter.createLabel();
+    const auto isSuccess = filter.createLabel();
+    filter.load(Size::HalfWord, s_filterOffsetFlags);
+    filter.jumpIfAnySet(Message::IsResponse, Label::next(), isQuery);
+    filter.bitwiseAnd(Message::OperationCode | Message::ResponseCode);
+    filter.jumpIfEqual(0, isSuccess, Label::next());
+    filter.bindLabel(isQuery);
+    filter.reject();
+    filter.bindLabel(isSuccess);
+
+    // The names of the records are only checked when there is only one record,
+    // because classic BPF cannot iterate over the compressed names of a message.
+    auto subscribedNames = QByteArrayList{};
+    const auto &queries = this->queries();
+
+    for (const auto &query : queries) {
+        const auto message = Message{query};
+
+        for (const auto &question : message.questions()) {
+            if (auto name = wireFormat(question.name().toByteArray()); !subscribedNames.contains(name))
+                subscribedNames.append(std::move(name));
+        }
+    }
+
+    const auto hasLongNames = std::any_of(subscribedNames.cbegin(), subscribedNames.cend(),
+                                          [](const auto &name) { return name.size() > s_filterMaximumNameSize; });
+
+    if (hasLongNames || subscribedNames.size() > s_filterMaximumNameCount) {
+        filter.accept();
+        return filter;
+    }
+
+    for (const auto &[offset, expectedCount] : {std::pair{s_filterOffsetQuestionCount,   0U},
+                                                std::pair{s_filterOffsetAnswerCount,     1U},
+                                                std::pair{s_filterOffsetAuthorityCount,  0U},
+                                                std::pair{s_filterOffsetAdditionalCount, 0U}}) {
+        const auto hasExpectedCount = filter.createLabel();
+        filter.load(Size::HalfWord, offset);
+        filter.jumpIfEqual(expectedCount, hasExpectedCount, Label::next());
+        filter.accept();
+        filter.bindLabel(hasExpectedCount);
+    }
+
+    for (const auto &name : std::as_const(subscribedNames)) {
+        const auto nameSize = static_cast<quint32>(name.size());
+
+        // the record's name is one of the subscribed names, e.g. a service type
+        const auto isOtherName = filter.createLabel();
+        filter.loadLength();
+        filter.jumpIfGreaterEqual(s_filterOffsetFirstName + nameSize, Label::next(), isOtherName);
+        compareName(filter, name, s_filterOffsetFirstName, false, isOtherName);
+        filter.accept();
+        filter.bindLabel(isOtherName);
+
+        // the record's name is a child of a subscribed name, e.g. a service instance
+        const auto isOtherParent = filter.createLabel();
+        filter.load(Size::Byte, s_filterOffsetFirstName);
+        filter.copyToIndex();
+        filter.loadLength();
+        filter.jumpIfGreaterEqual(s_filterOffsetFirstName + 1 + nameSize, Label::next(), isOtherParent);
+        filter.subtract(s_filterOffsetFirstName + 1 + nameSize);
+        filter.jumpIfGreaterEqualIndex(Label::next(), isOtherParent);
+        compareName(filter, name, s_filterOffsetFirstName + 1, true, isOtherParent);
+        filter.accept();
+        filter.bindLabel(isOtherParent);
+    }
+
+    filter.reject();
+    return filter;
+}
+
+void Resolver::updateSocketFilters()
+{
+    auto filter = std::shared_ptr<const RelevanceFilter>{};
+
+    // somebody wants to see every message, unless we are overloaded;
+    // without any queries there is nothing to tell relevant messages
+    if (isOverloaded() || !isReceivingAllMessages()) {
+        if (auto relevanceFilter = RelevanceFilter{queries()}; !relevanceFilter.isEmpty())
+            filter = std::make_shared<const RelevanceFilter>(std::move(relevanceFilter));
+    }
+
+    // the decoders might read the previous filter from other threads right now
+    std::atomic_store(&m_relevanceFilter, std::move(filter));
+
+    MulticastResolver::updateSocketFilters();
+}
+
+Resolver::Interests Resolver::interests() const
+{
+    return m_interests.load();
+}
+
+void Resolver::updateInterests()
+{
+    auto interests = Interests{};
+
+    if (isSignalConnected(QMetaMethod::fromSignal(&Resolver::hostNameFound))
+            || isSignalConnected(QMetaMethod::fromSignal(&Resolver::hostNamesFound)))
+        interests |= HostNames;
+    if (isSignalConnected(QMetaMethod::fromSignal(&Resolver::serviceFound))
+            || isSignalConnected(QMetaMethod::fromSignal(&Resolver::servicesFound))
+            || isSignalConnected(QMetaMethod::fromSignal(&Resolver::serviceIdentityChanged)))
+        interests |= Services;
+    if (isReceivingAllMessages())
+        interests |= Messages;
+
+    m_interests.store(interests);
+}
+
+bool Resolver::hasSubscribers() const
+{
+    return interests() != Interests{} || MulticastResolver::hasSubscribers();
+}
+
+void Resolver::connectNotify(const QMetaMethod &signal)
+{
+    updateInterests();
+
+    if (signal == QMetaMethod::fromSignal(&Resolver::messageReceived)
+            || signal == QMetaMethod::fromSignal(&Resolver::messagesReceived))
+        QMetaObject::invokeMethod(this, [this] { updateSocketFilters(); }, Qt::QueuedConnection);
+
+    MulticastResolver::connectNotify(signal);
+}
+
+void Resolver::disconnectNotify(const QMetaMethod &signal)
+{
+    // the connection might still be counted at this point
+    QMetaObject::invokeMethod(this, [this] { updateInterests(); }, Qt::QueuedConnection);
+
+    if (signal == QMetaMethod::fromSignal(&Resolver::messageReceived)
+            || signal == QMetaMethod::fromSignal(&Resolver::messagesReceived))
+        QMetaObject::invokeMethod(this, [this] { updateSocketFilters(); }, Qt::QueuedConnection);
+
+    MulticastResolver::disconnectNotify(signal);
+}
+
 bool Resolver::lookupServices(QStringList serviceTypes)
 {
     auto message = qnc::mdns::Message{};
@@ -174,37 +481,99 @@ bool Resolver::lookupHostNames(QStringList hostNames)
     return lookup(message);
 }
 
-void Resolver::processDatagram(const QNetworkDatagram &datagram)
+core::MulticastResolver::DatagramDecoder Resolver::datagramDecoder()
 {
-    const auto message = qnc::mdns::Message{datagram.data()};
+    return [this](const QNetworkDatagram &datagram) -> DecodedDatagram {
+        const auto interests = m_interests.load();
 
-    auto resolvedAddresses = std::unordered_map<QByteArray, QList<QHostAddress>>{};
-    auto resolvedServices = std::unordered_map<QByteArray, ServiceRecord>{};
-    auto resolvedText = std::unordered_map<QByteArray, QByteArray>{};
+        if (!interests)
+            return {};
 
-    for (auto i = 0; i < message.responseCount(); ++i) {
-        const auto response = message.response(i);
+        // cheaply drop messages about names nobody asked for, before decoding them
+        if (const auto filter = std::atomic_load(&m_relevanceFilter);
+                filter && !filter->isRelevant(datagram.data()))
+            return {};
 
-        if (const auto address = response.address(); !address.isNull()) {
-            auto &knownAddresses = resolvedAddresses[response.name().toByteArray()];
-            if (!knownAddresses.contains(address))
-                knownAddresses.append(address);
-        } else if (const auto service = response.service(); !service.isNull()) {
-            resolvedServices.insert({response.name().toByteArray(), service});
-        } else if (const auto text = response.text(); !text.isNull()) {
-            resolvedText.insert({response.name().toByteArray(), text});
-        }
-    }
+        auto decoded = decodeMessage(datagram.data(), interests);
 
-    for (const auto &[name, service]: resolvedServices) {
-        auto info = parseTxtRecord(resolvedText[name]);
-        emit serviceFound({m_domain, name, service, std::move(info)});
-    }
+        return [this, interests, decoded = std::move(decoded),
+                interfaceIndex = static_cast<int>(datagram.interfaceIndex()),
+                sender = datagram.senderAddress()] {
+            const auto batchServices = isSignalConnected(QMetaMethod::fromSignal(&Resolver::servicesFound));
+            const auto batchHostNames = isSignalConnected(QMetaMethod::fromSignal(&Resolver::hostNamesFound));
+
+            // replayed messages keep the time to life they had when they were received
+            const auto received = receivedTime(QDateTime::currentDateTimeUtc());
+
+            for (const auto &[name, record]: decoded.services) {
+                const auto expiry = received.addSecs(record.timeToLife);
+                const auto service = ServiceDescription{m_domain, name, record.record, record.info, expiry};
+                const auto serviceName = normalizedHostName(name, m_domain);
+
+                // a time to life of zero means the service is saying goodbye, which must not be cached
+                if (record.timeToLife > 0) {
+                    observeService(serviceName, interfaceIndex, sender, expiry);
+                    setDatagramExpiry(expiry, serviceName);
+                } else {
+                    forgetService(serviceName);
+                }
+
+                if (batchServices)
+                    m_pendingServices += service;
+
+                emit serviceFound(service);
+            }
 
-    for (const auto &[name, addresses]: resolvedAddresses)
-        emit hostNameFound(normalizedHostName(name, m_domain), addresses);
+            for (const auto &[name, host]: decoded.hosts) {
+                const auto &addresses = host.addresses;
+                const auto hostName = normalizedHostName(name, m_domain);
 
-    emit messageReceived(std::move(message));
+                if (host.timeToLife > 0)
+                    setDatagramExpiry(received.addSecs(host.timeToLife));
+
+                if (batchHostNames) {
+                    auto &knownAddresses = m_pendingHostNames[hostName];
+
+                    for (const auto &address : addresses) {
+                        if (!knownAddresses.contains(address))
+                            knownAddresses.append(address);
+                    }
+                }
+
+                emit hostNameFound(hostName, addresses);
+            }
+
+            if (interests.testFlag(Messages)) {
+                if (isSignalConnected(QMetaMethod::fromSignal(&Resolver::messagesReceived)))
+                    m_pendingMessages += decoded.message;
+
+                emit messageReceived(decoded.message);
+            }
+
+            scheduleBatchDelivery(pendingBatchSize());
+        };
+    };
+}
+
+void Resolver::deliverBatches()
+{
+    if (!m_pendingServices.isEmpty())
+        emit servicesFound(std::exchange(m_pendingServices, {}));
+    if (!m_pendingHostNames.isEmpty())
+        emit hostNamesFound(std::exchange(m_pendingHostNames, {}));
+    if (!m_pendingMessages.isEmpty())
+        emit messagesReceived(std::exchange(m_pendingMessages, {}));
+}
+
+bool Resolver::isReceivingAllMessages() const
+{
+    return isSignalConnected(QMetaMethod::fromSignal(&Resolver::messageReceived))
+            || isSignalConnected(QMetaMethod::fromSignal(&Resolver::messagesReceived));
+}
+
+qsizetype Resolver::pendingBatchSize() const
+{
+    return m_pendingServices.size() + m_pendingHostNames.size() + m_pendingMessages.size();
 }
 
 } // namespace qnc::mdns
@@ -224,6 +593,7 @@ QDebug operator<<(QDebug debug, const qnc::mdns::ServiceDescription &service)
             << ", priority=" << service.priority()
             << ", weight=" << service.weight()
             << ", info=" << service.info()
+            << ", expires=" << service.expires()
             << ")";
 }
 
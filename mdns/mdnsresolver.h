@@ -4,16 +4,23 @@
 #ifndef QNCMDNS_MDNSRESOLVER_H
 #define QNCMDNS_MDNSRESOLVER_H
 
+#include "mdnsmessage.h"
 #include "multicastresolver.h"
 
+// Qt headers
+#include <QDateTime>
+
+// STL headers
+#include <atomic>
+#include <memory>
+
 class QHostAddress;
 class QNetworkDatagram;
 class QUdpSocket;
 
 namespace qnc::mdns {
 
-class Message;
-class ServiceRecord;
+class RelevanceFilter;
 
 class ServiceDescription
 {
@@ -21,7 +28,8 @@ class ServiceDescription
 
 public:
     ServiceDescription() = default;
-    ServiceDescription(QString domain, QByteArray name, ServiceRecord service, QStringList info);
+    ServiceDescription(QString domain, QByteArray name, ServiceRecord service,
+                       QStringList info, QDateTime expires = {});
 
     auto name() const { return m_name; };
     auto type() const { return m_type; }
@@ -31,6 +39,10 @@ public:
     auto port() const { return m_port; }
     auto info() const { return m_info; }
 
+    // When the record expires; services saying goodbye with a time to life
+    // of zero already have expired when they get reported.
+    auto expires() const { return m_expires; }
+
     QString info(const QString &key) const;
     QList<QUrl> locations() const;
 
@@ -44,6 +56,7 @@ private:
     int m_weight;
 
     QStringList m_info;
+    QDateTime m_expires;
 };
 
 class Resolver : public core::MulticastResolver
@@ -52,10 +65,24 @@ class Resolver : public core::MulticastResolver
     Q_PROPERTY(QString domain READ domain WRITE setDomain NOTIFY domainChanged FINAL)
 
 public:
+    // The kinds of results somebody is connected to. Only those get decoded.
+    enum Interest
+    {
+        HostNames   = (1 << 0),
+        Services    = (1 << 1),
+        Messages    = (1 << 2),
+    };
+
+    Q_DECLARE_FLAGS(Interests, Interest)
+    Q_FLAG(Interests)
+
     explicit Resolver(QObject *parent = {});
+    ~Resolver() override;
 
     QString domain() const;
 
+    [[nodiscard]] Interests interests() const;
+
 public slots:
     void setDomain(QString domain);
 
@@ -70,17 +97,42 @@ signals:
     void serviceFound(qnc::mdns::ServiceDescription service);
     void messageReceived(qnc::mdns::Message message);
 
+    // batched variants of the signals above, see batchInterval() and batchSize()
+    void hostNamesFound(QHash<QString, QList<QHostAddress>> hostNames);
+    void servicesFound(QList<qnc::mdns::ServiceDescription> services);
+    void messagesReceived(QList<qnc::mdns::Message> messages);
+
 protected:
     [[nodiscard]] virtual quint16 port() const override;
     [[nodiscard]] QHostAddress multicastGroup(const QHostAddress &address) const override;
-    void processDatagram(const QNetworkDatagram &datagram) override;
+    [[nodiscard]] core::SocketFilter socketFilter() const override;
+    [[nodiscard]] DatagramDecoder datagramDecoder() override;
+    [[nodiscard]] bool hasSubscribers() const override;
+
+    void connectNotify(const QMetaMethod &signal) override;
+    void disconnectNotify(const QMetaMethod &signal) override;
+
+    void deliverBatches() override;
+    void updateSocketFilters() override;
 
 private:
+    void updateInterests();
+    [[nodiscard]] bool isReceivingAllMessages() const;
+    [[nodiscard]] qsizetype pendingBatchSize() const;
+
     QString m_domain;
+    std::atomic<Interests> m_interests;
+    std::shared_ptr<const RelevanceFilter> m_relevanceFilter;
+
+    QHash<QString, QList<QHostAddress>> m_pendingHostNames;
+    QList<ServiceDescription>           m_pendingServices;
+    QList<Message>                      m_pendingMessages;
 };
 
 } // namespace qnc::mdns
 
+Q_DECLARE_OPERATORS_FOR_FLAGS(qnc::mdns::Resolver::Interests)
+
 QDebug operator<<(QDebug debug, const qnc::mdns::ServiceDescription &service);
 
 #endif // QNCMDNS_MDNSRESOLVER_H
@@ -4,15 +4,21 @@
 #include "ssdpresolver.h"
 
 // QtNetworkCrumbs headers
+#include "bytetemplate.h"
 #include "httpparser.h"
 #include "literals.h"
 
 // Qt headers
 #include <QHostAddress>
 #include <QLoggingCategory>
+#include <QMetaMethod>
 #include <QNetworkDatagram>
 #include <QUrl>
 
+// STL headers
+#include <algorithm>
+#include <optional>
+
 namespace qnc::ssdp {
 
 namespace {
@@ -23,11 +29,28 @@ constexpr auto s_ssdpUnicastIPv4 = "239.255.255.250"_L1;
 constexpr auto s_ssdpUnicastIPv6 = "ff02::c"_L1;
 constexpr auto s_ssdpPort = quint16{1900};
 
-constexpr auto s_ssdpKeyMulticastGroup  = "{multicast-group}"_baview;
-constexpr auto s_ssdpKeyUdpPort         = "{udp-port}"_baview;
-constexpr auto s_ssdpKeyMinimumDelay    = "{minimum-delay}"_baview;
-constexpr auto s_ssdpKeyMaximumDelay    = "{maximum-delay}"_baview;
-constexpr auto s_ssdpKeyServiceType     = "{service-type}"_baview;
+// the devices that may respond within one second of MX without flooding receive buffers
+constexpr auto s_respondersPerSecond = 20;
+
+constexpr auto s_jitterPerResponder = std::chrono::milliseconds{5};
+constexpr auto s_minimumJitter      = std::chrono::milliseconds{20};
+constexpr auto s_maximumJitter      = std::chrono::milliseconds{500};
+
+// the first four bytes of the messages we are interested in, for socket filters
+constexpr auto s_ssdpFilterOffsetPayload = quint32{8};
+constexpr auto s_ssdpFilterPrefixHttp    = quint32{0x48545450}; // "HTTP"
+constexpr auto s_ssdpFilterPrefixNotify  = quint32{0x4e4f5449}; // "NOTI"
+
+// the HOST header needs brackets for IPv6 addresses
+constexpr char s_ssdpHostIPv4[] = "239.255.255.250";
+constexpr char s_ssdpHostIPv6[] = "[ff02::c]";
+
+constexpr char s_ssdpKeyHost[]           = "host";
+constexpr char s_ssdpKeyMulticastGroup[] = "multicast-group";
+constexpr char s_ssdpKeyUdpPort[]        = "udp-port";
+constexpr char s_ssdpKeyMinimumDelay[]   = "minimum-delay";
+constexpr char s_ssdpKeyMaximumDelay[]   = "maximum-delay";
+constexpr char s_ssdpKeyServiceType[]    = "service-type";
 
 constexpr auto s_ssdpQueryTemplate = "M-SEARCH * HTTP/1.1\r\n"
                                      "ST: {service-type}\r\n"
@@ -38,6 +61,174 @@ constexpr auto s_ssdpQueryTemplate = "M-SEARCH * HTTP/1.1\r\n"
                                      "Content-Length: 0\r\n"
                                      "\r\n"_baview;
 
+// UPnP 1.1 unicast searches don't carry MX, as the device responds immediately
+constexpr auto s_ssdpUnicastQueryTemplate = "M-SEARCH * HTTP/1.1\r\n"
+                                            "HOST: {host}:{udp-port}\r\n"
+                                            "MAN: \"ssdp:discover\"\r\n"
+                                            "ST: ssdp:all\r\n"
+                                            "Content-Length: 0\r\n"
+                                            "\r\n"_baview;
+
+// devices get refreshed once this part of their lifetime is left
+constexpr auto s_refreshLifetimeDivisor = 5;
+
+const core::ByteTemplate &queryTemplate()
+{
+    static const auto compiledTemplate = core::ByteTemplate{s_ssdpQueryTemplate.toByteArray()};
+    return compiledTemplate;
+}
+
+const core::ByteTemplate &unicastQueryTemplate()
+{
+    static const auto compiledTemplate = core::ByteTemplate{s_ssdpUnicastQueryTemplate.toByteArray()};
+    return compiledTemplate;
+}
+
+// A range of bytes within a received datagram, which must outlive it.
+struct Span
+{
+    const char *begin = nullptr;
+    const char *end   = nullptr;
+
+    [[nodiscard]] int length() const { return static_cast<int>(end - begin); }
+    [[nodiscard]] bool isEmpty() const { return begin == end; }
+
+    [[nodiscard]] bool operator==(compat::ByteArrayView text) const
+    {
+        return length() == text.size()
+                && std::equal(begin, end, text.data());
+    }
+
+    [[nodiscard]] bool operator!=(compat::ByteArrayView text) const { return !(*this == text); }
+
+    [[nodiscard]] bool startsWith(compat::ByteArrayView prefix) const
+    {
+        return length() >= prefix.size()
+                && std::equal(prefix.data(), prefix.data() + prefix.size(), begin);
+    }
+
+    [[nodiscard]] Span trimmed() const
+    {
+        const auto isSpace = [](char ch) { return ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n'; };
+
+        auto span = *this;
+
+        while (span.begin != span.end && isSpace(*span.begin))
+            ++span.begin;
+        while (span.begin != span.end && isSpace(*(span.end - 1)))
+            --span.end;
+
+        return span;
+    }
+
+    // no copy is made, which is fine as long as the datagram outlives the result
+    [[nodiscard]] QByteArray toRawByteArray() const
+    {
+        return QByteArray::fromRawData(begin, length());
+    }
+};
+
+// Returns the next line without its line break. Incomplete lines are ignored,
+// like QIODevice::canReadLine() does.
+std::optional<Span> readLine(const char *&position, const char *end)
+{
+    const auto lineBreak = std::find(position, end, '\n');
+
+    if (lineBreak == end)
+        return {};
+
+    return Span{std::exchange(position, lineBreak + 1), lineBreak};
+}
+
+// Splits off the text before the next space.
+Span nextField(Span &text)
+{
+    const auto space = std::find(text.begin, text.end, ' ');
+    const auto field = Span{text.begin, space};
+    text.begin = (space == text.end ? space : space + 1);
+    return field;
+}
+
+enum class Header {
+    Unknown,
+    AlternativeLocation,
+    CacheControl,
+    Expires,
+    Location,
+    NotifySubType,
+    NotifyType,
+    UniqueServiceName,
+    BootId,
+    ConfigId,
+    NextBootId,
+    SearchPort,
+};
+
+// Header names get dispatched by their length and first letter, so that
+// at most one of the known names must be compared with the actual name.
+Header headerFromName(Span name)
+{
+    const auto toLower = [](char ch) {
+        return (ch >= 'A' && ch <= 'Z') ? static_cast<char>(ch - 'A' + 'a') : ch;
+    };
+
+    const auto matches = [&name, toLower](compat::ByteArrayView lowerCaseName, Header header) {
+        const auto isEqual = std::equal(name.begin, name.end, lowerCaseName.data(), [toLower](char l, char r) {
+            return toLower(l) == r;
+        });
+
+        return isEqual ? header : Header::Unknown;
+    };
+
+    if (name.isEmpty())
+        return Header::Unknown;
+
+    switch (name.length()) {
+    case 2:
+        if (toLower(*name.begin) == 'a')
+            return matches("al"_baview, Header::AlternativeLocation);
+        else
+            return matches("nt"_baview, Header::NotifyType);
+
+    case 3:
+        if (toLower(*name.begin) == 'n')
+            return matches("nts"_baview, Header::NotifySubType);
+        else
+            return matches("usn"_baview, Header::UniqueServiceName);
+
+    case 7:
+        return matches("expires"_baview, Header::Expires);
+
+    case 8:
+        return matches("location"_baview, Header::Location);
+
+    case 13:
+        return matches("cache-control"_baview, Header::CacheControl);
+
+    case 15:
+        return matches("bootid.upnp.org"_baview, Header::BootId);
+
+    case 17:
+        return matches("configid.upnp.org"_baview, Header::ConfigId);
+
+    case 19:
+        if (toLower(*name.begin) == 'n')
+            return matches("nextbootid.upnp.org"_baview, Header::NextBootId);
+        else
+            return matches("searchport.upnp.org"_baview, Header::SearchPort);
+    }
+
+    return Header::Unknown;
+}
+
+// BOOTID.UPNP.ORG and friends are non-negative 31 bit integers.
+int parseIdentifier(const QByteArray &value)
+{
+    auto isValid = false;
+    const auto number = value.toInt(&isValid);
+    return isValid && number >= 0 ? number : -1;
+}
+
 QList<QUrl> parseAlternativeLocations(compat::ByteArrayView text)
 {
     auto locations = QList<QUrl>{};
@@ -60,19 +251,177 @@ QList<QUrl> parseAlternativeLocations(compat::ByteArrayView text)
     return locations;
 }
 
+// Splits unique service names like "uuid:device-UUID::urn:schemas-upnp-org:service:Foo:1"
+// into the device's id, and the service type; the type is empty for "uuid:device-UUID".
+std::pair<QStringView, QStringView> splitUniqueServiceName(const QString &name)
+{
+    constexpr auto s_ssdpUniqueServiceNameSeparator = "::"_L1;
+
+    const auto view = QStringView{name};
+    const auto separator = name.indexOf(s_ssdpUniqueServiceNameSeparator);
+
+    if (separator < 0)
+        return {view, {}};
+
+    return {view.left(separator), view.mid(separator + s_ssdpUniqueServiceNameSeparator.size())};
+}
+
+// The address of the first location that is given by IP address, for unicast searches.
+QHostAddress locationAddress(const QList<QUrl> &locations, int interfaceIndex)
+{
+    for (const auto &url : locations) {
+        auto address = QHostAddress{url.host()};
+
+        if (address.isNull())
+            continue;
+
+        if (address.protocol() == QAbstractSocket::IPv6Protocol
+                && address.isLinkLocal() && address.scopeId().isEmpty() && interfaceIndex > 0)
+            address.setScopeId(QString::number(interfaceIndex));
+
+        return address;
+    }
+
+    return {};
+}
+
+QDateTime earliestExpiry(const QHash<QString, ServiceDescription> &services)
+{
+    auto earliest = QDateTime{};
+
+    for (const auto &service : services) {
+        if (service.expires().isValid() && (!earliest.isValid() || service.expires() < earliest))
+            earliest = service.expires();
+    }
+
+    return earliest;
+}
+
+bool isSameService(const ServiceDescription &lhs, const ServiceDescription &rhs)
+{
+    // neither the expiry, which changes with each announcement, nor the locations,
+    // which are merged per device, are compared
+    return lhs.type() == rhs.type()
+            && lhs.configId() == rhs.configId();
+}
+
+ServiceDescription withLocations(const ServiceDescription &service, const QList<QUrl> &locations,
+                                 const QList<QUrl> &alternativeLocations)
+{
+    return {service.name(), service.type(), locations, alternativeLocations,
+            service.expires(), service.bootId(), service.configId()};
+}
+
+template<typename Key>
+bool mergeLocations(QList<QUrl> &locations, core::ExpiryTable<Key> &expiries, const QString &deviceId,
+                    const QList<QUrl> &received, const QDateTime &expiry)
+{
+    auto isAdded = false;
+
+    for (const auto &url : received) {
+        if (!locations.contains(url)) {
+            locations += url;
+            isAdded = true;
+        }
+
+        // a location lives as long as the longest lived announcement carrying it
+        const auto key = Key{deviceId, url};
+
+        if (const auto known = expiries.expiry(key); expiry.isValid() && (!known.isValid() || known < expiry))
+            expiries.insert(key, expiry);
+    }
+
+    return isAdded;
+}
+
 } // namespace
 
+Resolver::Resolver(QObject *parent)
+    : core::MulticastResolver{parent}
+    , m_refreshTimer{this, [this] { refreshDevices(); }}
+    , m_locationExpiries{this, [this](const QList<LocationKey> &keys) { expireLocations(keys); }}
+{}
+
+Resolver::~Resolver()
+{
+    stopDecoders();
+}
+
+bool Resolver::isUnicastRefresh() const
+{
+    return m_unicastRefresh;
+}
+
+void Resolver::setUnicastRefresh(bool enabled)
+{
+    if (std::exchange(m_unicastRefresh, enabled) == enabled)
+        return;
+
+    if (m_unicastRefresh)
+        refreshDevices();
+    else
+        m_refreshTimer.stop();
+
+    emit unicastRefreshChanged(m_unicastRefresh);
+}
+
+QString ServiceDescription::deviceId() const
+{
+    return splitUniqueServiceName(m_name).first.toString();
+}
+
+QList<ServiceDescription> Resolver::services() const
+{
+    auto services = QList<ServiceDescription>{};
+
+    for (const auto &device : m_devices) {
+        for (const auto &service : device.services)
+            services += withLocations(service, device.locations, device.alternativeLocations);
+    }
+
+    return services;
+}
+
+QList<DeviceDescription> Resolver::devices() const
+{
+    auto devices = QList<DeviceDescription>{};
+
+    for (auto it = m_devices.cbegin(); it != m_devices.cend(); ++it) {
+        auto serviceTypes = QStringList{};
+        auto expires = QDateTime{};
+
+        for (const auto &service : it->services) {
+            if (!service.type().isEmpty() && !serviceTypes.contains(service.type()))
+                serviceTypes += service.type();
+            if (service.expires().isValid() && (!expires.isValid() || expires < service.expires()))
+                expires = service.expires();
+        }
+
+        devices += DeviceDescription{it.key(), serviceTypes, it->locations,
+                                     it->alternativeLocations, expires,
+                                     it->bootId, it->configId};
+    }
+
+    return devices;
+}
+
 bool Resolver::lookupService(const ServiceLookupRequest &request)
 {
     const auto minimumDelaySeconds = static_cast<int>(request.minimumDelay.count());
     const auto maximumDelaySeconds = static_cast<int>(request.maximumDelay.count());
 
-    auto query =
-            s_ssdpQueryTemplate.toByteArray().
-            replace(s_ssdpKeyUdpPort,      QByteArray::number(s_ssdpPort)).
-            replace(s_ssdpKeyMinimumDelay, QByteArray::number(minimumDelaySeconds)).
-            replace(s_ssdpKeyMaximumDelay, QByteArray::number(maximumDelaySeconds)).
-            replace(s_ssdpKeyServiceType,  request.serviceType.toUtf8());
+    // the multicast group and MX only get known when sending the query
+    auto query = queryTemplate().render({
+        {s_ssdpKeyUdpPort,      QByteArray::number(s_ssdpPort)},
+        {s_ssdpKeyMinimumDelay, QByteArray::number(minimumDelaySeconds)},
+        {s_ssdpKeyServiceType,  request.serviceType.toUtf8()},
+    });
+
+    // MX gets chosen by finalizeQuery() from the number of devices that responded recently
+    if (const auto it = m_queryTemplates.find(query); it != m_queryTemplates.end())
+        it->delayRange.maximum = std::max(it->delayRange.maximum, maximumDelaySeconds);
+    else
+        m_queryTemplates.insert(query, {core::ByteTemplate{query}, {minimumDelaySeconds, maximumDelaySeconds}, {}});
 
     return addQuery(std::move(query));
 }
@@ -109,11 +458,75 @@ quint16 Resolver::port() const
 
 QByteArray Resolver::finalizeQuery(const QHostAddress &address, const QByteArray &query) const
 {
-    const auto &group = multicastGroup(address).toString();
+    const auto it = m_queryTemplates.constFind(query);
+
+    if (it == m_queryTemplates.cend())
+        return query;
+
+    // let many devices spread their responses over a longer time,
+    // but don't wait for nothing if only few devices respond; as long
+    // as nobody responded, the number of devices is unknown though
+    const auto minimumDelay = std::max(it->delayRange.minimum, 1);
+    const auto maximumDelay = std::max(it->delayRange.maximum, minimumDelay);
+    const auto delay = m_expectedResponders > 0
+            ? std::clamp((m_expectedResponders + s_respondersPerSecond - 1) / s_respondersPerSecond,
+                         minimumDelay, maximumDelay)
+            : maximumDelay;
+
+    // the packets only need rendering when MX changes, and are shared otherwise
+    const auto isIPv6 = (address.protocol() == QAbstractSocket::IPv6Protocol);
+    auto &packet = it->packets[isIPv6 ? 1 : 0];
+
+    if (packet.data.isEmpty() || packet.maximumDelay != delay) {
+        packet.maximumDelay = delay;
+        packet.data = it->compiledQuery.render({
+            {s_ssdpKeyMulticastGroup, isIPv6 ? s_ssdpHostIPv6 : s_ssdpHostIPv4},
+            {s_ssdpKeyMaximumDelay,   QByteArray::number(delay)},
+        });
+    }
+
+    return packet.data;
+}
+
+std::chrono::milliseconds Resolver::queryJitter() const
+{
+    return std::clamp(s_jitterPerResponder * m_expectedResponders, s_minimumJitter, s_maximumJitter);
+}
+
+void Resolver::submitQueries(const SocketTable &sockets)
+{
+    // each scan starts a new round of responses, but the sockets of new interfaces don't;
+    // growing numbers of responders are followed immediately, missing ones get forgotten slowly
+    if (sockets.size() >= this->sockets().size()) {
+        const auto responders = static_cast<int>(m_responders.size());
+        m_expectedResponders = std::max(responders, (m_expectedResponders + responders) / 2);
+        m_responders.clear();
+    }
 
-    auto finalizedQuery = QByteArray{query};
-    finalizedQuery.replace(s_ssdpKeyMulticastGroup, group.toLatin1());
-    return finalizedQuery;
+    MulticastResolver::submitQueries(sockets);
+}
+
+core::SocketFilter Resolver::socketFilter() const
+{
+    using Label = core::SocketFilter::Label;
+    using Size = core::SocketFilter::Size;
+
+    // only accept responses and notifications, but drop the M-SEARCH queries of other hosts;
+    // while overloaded only the responses to our own queries are accepted
+    auto filter = core::SocketFilter{};
+    const auto isInteresting = filter.createLabel();
+
+    filter.load(Size::Word, s_ssdpFilterOffsetPayload);
+    filter.jumpIfEqual(s_ssdpFilterPrefixHttp, isInteresting, Label::next());
+
+    if (!isOverloaded())
+        filter.jumpIfEqual(s_ssdpFilterPrefixNotify, isInteresting, Label::next());
+
+    filter.reject();
+    filter.bindLabel(isInteresting);
+    filter.accept();
+
+    return filter;
 }
 
 NotifyMessage NotifyMessage::parse(const QByteArray &data, const QDateTime &now)
@@ -121,49 +534,55 @@ NotifyMessage NotifyMessage::parse(const QByteArray &data, const QDateTime &now)
     constexpr auto s_ssdpVerbSearch                 = "M-SEARCH"_baview;
     constexpr auto s_ssdpVerbNotify                 = "NOTIFY"_baview;
     constexpr auto s_ssdpResourceAny                = "*"_baview;
+    constexpr auto s_ssdpStatusOk                   = "200"_baview;
+    constexpr auto s_ssdpProtocolPrefix             = "HTTP/"_baview;
     constexpr auto s_ssdpProtocolHttp11             = "HTTP/1.1"_baview;
-    constexpr auto s_ssdpHeaderCacheControl         = "Cache-Control"_baview;
-    constexpr auto s_ssdpHeaderExpires              = "Expires"_baview;
-    constexpr auto s_ssdpHeaderLocation             = "Location"_baview;
-    constexpr auto s_ssdpHeaderAlternativeLocation  = "AL"_baview;
-    constexpr auto s_ssdpHeaderNotifySubType        = "NTS"_baview;
-    constexpr auto s_ssdpHeaderNotifyType           = "NT"_baview;
-    constexpr auto s_ssdpHeaderUniqueServiceName    = "USN"_baview;
     constexpr auto s_ssdpNotifySubTypeAlive         = "ssdp:alive"_baview;
     constexpr auto s_ssdpNotifySubTypeByeBye        = "ssdp:byebye"_baview;
+    constexpr auto s_ssdpNotifySubTypeUpdate        = "ssdp:update"_baview;
 
-    const auto &message = http::Message::parse(data);
+    auto position = data.cbegin();
+    const auto end = data.cend();
 
-    if (message.isInvalid()) {
-        qCWarning(lcResolver, "Ignoring malformed HTTP message");
-        return {};
-    }
+    auto statusLine = readLine(position, end).value_or(Span{}).trimmed();
+    const auto first  = nextField(statusLine);
+    const auto second = nextField(statusLine);
+    const auto third  = statusLine;
 
-    if (message.protocol() != s_ssdpProtocolHttp11) {
-        qCWarning(lcResolver, "Ignoring unknown protocol: %s", message.protocol().constData());
-        return {};
-    }
+    auto isRequest = false;
 
-    if (message.type() == http::Message::Type::Request) {
-        if (message.verb() == s_ssdpVerbSearch)
+    if (first.startsWith(s_ssdpProtocolPrefix) && !second.isEmpty() && !third.isEmpty()) {
+        if (first != s_ssdpProtocolHttp11) {
+            qCWarning(lcResolver, "Ignoring unknown protocol: %.*s", first.length(), first.begin);
             return {};
+        }
 
-        if (message.verb() != s_ssdpVerbNotify) {
-            qCDebug(lcResolver, "Ignoring unsupported verb: %s", message.verb().constData());
+        if (second != s_ssdpStatusOk) {
+            qCDebug(lcResolver, "Ignoring unsupported status code: %.*s", second.length(), second.begin);
+            return {};
+        }
+    } else if (third.startsWith(s_ssdpProtocolPrefix) && !first.isEmpty() && !second.isEmpty()) {
+        if (third != s_ssdpProtocolHttp11) {
+            qCWarning(lcResolver, "Ignoring unknown protocol: %.*s", third.length(), third.begin);
             return {};
         }
 
-        if (message.resource() != s_ssdpResourceAny) {
-            qCDebug(lcResolver, "Ignoring unsupported resource: %s", message.resource().constData());
+        if (first == s_ssdpVerbSearch)
+            return {};
+
+        if (first != s_ssdpVerbNotify) {
+            qCDebug(lcResolver, "Ignoring unsupported verb: %.*s", first.length(), first.begin);
             return {};
         }
-    } else if (message.type() == http::Message::Type::Response) {
-        if (message.statusCode() != 200) {
-            qCDebug(lcResolver, "Ignoring unsupported status code: %d", message.statusCode().value());
+
+        if (second != s_ssdpResourceAny) {
+            qCDebug(lcResolver, "Ignoring unsupported resource: %.*s", second.length(), second.begin);
             return {};
         }
+
+        isRequest = true;
     } else {
-        qCWarning(lcResolver, "Ignoring unexpected HTTP message");
+        qCWarning(lcResolver, "Ignoring malformed HTTP message");
         return {};
     }
 
@@ -172,32 +591,98 @@ NotifyMessage NotifyMessage::parse(const QByteArray &data, const QDateTime &now)
     auto cacheControl = QByteArray{};
     auto expires      = QByteArray{};
 
-    for (const auto &[name, value] : message.headers()) {
-        if (name == s_ssdpHeaderUniqueServiceName)
+    const auto applyHeader = [&](Header header, const QByteArray &value) {
+        switch (header) {
+        case Header::UniqueServiceName:
             response.serviceName = QUrl::fromPercentEncoding(value);
-        else if (name == s_ssdpHeaderNotifyType)
+            break;
+        case Header::NotifyType:
             response.serviceType = QUrl::fromPercentEncoding(value);
-        else if (name == s_ssdpHeaderNotifySubType)
+            break;
+        case Header::NotifySubType:
             notifyType = value;
-        else if (name == s_ssdpHeaderCacheControl)
+            break;
+        case Header::CacheControl:
             cacheControl = value;
-        else if (name == s_ssdpHeaderExpires)
+            break;
+        case Header::Expires:
             expires = value;
-        else if (name == s_ssdpHeaderLocation)
+            break;
+        case Header::Location:
             response.locations += QUrl::fromEncoded(value);
-        else if (name == s_ssdpHeaderAlternativeLocation)
+            break;
+        case Header::AlternativeLocation:
             response.altLocations += parseAlternativeLocations(value);
+            break;
+        case Header::BootId:
+            response.bootId = parseIdentifier(value);
+            break;
+        case Header::ConfigId:
+            response.configId = parseIdentifier(value);
+            break;
+        case Header::NextBootId:
+            response.nextBootId = parseIdentifier(value);
+            break;
+        case Header::SearchPort:
+            if (const auto port = parseIdentifier(value); port > 0 && port <= 65535)
+                response.searchPort = static_cast<quint16>(port);
+            break;
+        case Header::Unknown:
+            break;
+        }
+    };
+
+    // headers get applied once the next line is known not to continue them
+    auto pendingHeader = Header::Unknown;
+    auto pendingValue  = QByteArray{};
+    auto hasHeaders    = false;
+
+    while (const auto line = readLine(position, end)) {
+        const auto trimmedLine = line->trimmed();
+
+        if (trimmedLine.isEmpty())
+            break;
+
+        if (*line->begin == ' ') {
+            if (!hasHeaders) {
+                qCWarning(lcResolver, "Ignoring invalid header line: %.*s", line->length(), line->begin);
+                continue;
+            }
+
+            if (pendingHeader != Header::Unknown)
+                pendingValue.append(trimmedLine.begin, trimmedLine.length());
+
+            continue;
+        }
+
+        const auto colon = std::find(line->begin, line->end, ':');
+
+        if (colon == line->begin || colon == line->end) {
+            qCWarning(lcResolver, "Ignoring invalid header line: %.*s", line->length(), line->begin);
+            continue;
+        }
+
+        applyHeader(pendingHeader, pendingValue);
+
+        pendingHeader = headerFromName(Span{line->begin, colon}.trimmed());
+        pendingValue  = Span{colon + 1, line->end}.trimmed().toRawByteArray();
+        hasHeaders    = true;
     }
 
-    if (message.type() == http::Message::Type::Request) {
+    applyHeader(pendingHeader, pendingValue);
+
+    if (isRequest) {
         if (notifyType == s_ssdpNotifySubTypeAlive)
             response.type = NotifyMessage::Type::Alive;
         else if (notifyType == s_ssdpNotifySubTypeByeBye)
             response.type = NotifyMessage::Type::ByeBye;
+        else if (notifyType == s_ssdpNotifySubTypeUpdate)
+            response.type = NotifyMessage::Type::Update;
         else
             return {};
-    } else if (message.type() == http::Message::Type::Response) {
+    } else {
         response.type = NotifyMessage::Type::Alive;
+        response.isSearchResponse = true;
     }
 
     response.expiry = http::expiryDateTime(cacheControl, expires, now);
@@ -210,24 +695,326 @@ NotifyMessage NotifyMessage::parse(const QByteArray &data)
     return parse(data, QDateTime::currentDateTimeUtc());
 }
 
-void Resolver::processDatagram(const QNetworkDatagram &datagram)
+core::MulticastResolver::DatagramDecoder Resolver::datagramDecoder()
 {
-    const auto response = NotifyMessage::parse(datagram.data());
+    return [this](const QNetworkDatagram &datagram) -> DecodedDatagram {
+        const auto decodedAt = QDateTime::currentDateTimeUtc();
+        auto response = NotifyMessage::parse(datagram.data(), decodedAt);
 
-    switch (response.type) {
-    case NotifyMessage::Type::Alive:
-        emit serviceFound({response.serviceName, response.serviceType,
-                           response.locations, response.altLocations,
-                           response.expiry});
-        break;
+        switch (response.type) {
+        case NotifyMessage::Type::Alive:
+            return [this, response = std::move(response), decodedAt,
+                    interfaceIndex = static_cast<int>(datagram.interfaceIndex()),
+                    sender = datagram.senderAddress()] {
+                // count devices, not their addresses or services, and only those answering searches
+                if (response.isSearchResponse)
+                    m_responders.insert(splitUniqueServiceName(response.serviceName).first.toString());
 
-    case NotifyMessage::Type::ByeBye:
-        emit serviceLost(response.serviceName);
-        break;
+                // replayed responses keep the max-age they had when they were received
+                const auto expiry = response.expiry.isValid()
+                        ? receivedTime(decodedAt).addMSecs(decodedAt.msecsTo(response.expiry))
+                        : response.expiry;
 
-    case NotifyMessage::Type::Invalid:
-        break;
+                observeService(response.serviceName, interfaceIndex, sender, expiry);
+                setDatagramExpiry(expiry, response.serviceName);
+                updateService({response.serviceName, response.serviceType,
+                               response.locations, response.altLocations,
+                               expiry, response.bootId, response.configId},
+                              interfaceIndex, response.searchPort);
+            };
+
+        case NotifyMessage::Type::ByeBye:
+            return [this, serviceName = std::move(response.serviceName)] {
+                forgetService(serviceName);
+                removeService(serviceName);
+            };
+
+        case NotifyMessage::Type::Update:
+            return [this, serviceName = std::move(response.serviceName),
+                    bootId = response.bootId, nextBootId = response.nextBootId] {
+                updateBootId(serviceName, bootId, nextBootId);
+            };
+
+        case NotifyMessage::Type::Invalid:
+            break;
+        }
+
+        return {};
+    };
+}
+
+bool Resolver::hasSubscribers() const
+{
+    return isSignalConnected(QMetaMethod::fromSignal(&Resolver::serviceFound))
+            || isSignalConnected(QMetaMethod::fromSignal(&Resolver::serviceLost))
+            || isSignalConnected(QMetaMethod::fromSignal(&Resolver::servicesFound))
+            || isSignalConnected(QMetaMethod::fromSignal(&Resolver::servicesLost))
+            || isSignalConnected(QMetaMethod::fromSignal(&Resolver::deviceRebooted))
+            || isSignalConnected(QMetaMethod::fromSignal(&Resolver::deviceConfigurationChanged))
+            || MulticastResolver::hasSubscribers();
+}
+
+QString Resolver::internServiceType(const QString &type) const
+{
+    if (const auto it = m_serviceTypes.constFind(type); it != m_serviceTypes.cend())
+        return it.key();
+
+    return type;
+}
+
+void Resolver::retainServiceType(const QString &type)
+{
+    ++m_serviceTypes[type];
+}
+
+void Resolver::releaseServiceType(const QString &type)
+{
+    // types of devices that are gone must not pile up
+    if (const auto it = m_serviceTypes.find(type); it != m_serviceTypes.end() && --*it == 0)
+        m_serviceTypes.erase(it);
+}
+
+void Resolver::updateService(const ServiceDescription &received, int interfaceIndex, quint16 searchPort)
+{
+    const auto name = received.name(); // keep alive for the string views
+    const auto &[deviceId, typeFromName] = splitUniqueServiceName(name);
+    auto &device = m_devices[deviceId.toString()];
+
+    // dual-stack and multi-homed devices announce a different location per address
+    // family or interface, so that the locations of all announcements get merged
+    auto isLocationAdded = mergeLocations(device.locations, m_locationExpiries, deviceId.toString(),
+                                          received.locations(), received.expires());
+
+    if (mergeLocations(device.alternativeLocations, m_locationExpiries, deviceId.toString(),
+                       received.alternativeLocations(), received.expires()))
+        isLocationAdded = true;
+
+    // only announcements carry SEARCHPORT.UPNP.ORG, but not the responses to searches
+    if (interfaceIndex > 0)
+        device.interfaceIndex = interfaceIndex;
+    if (searchPort > 0)
+        device.searchPort = searchPort;
+    if (received.expires().isValid())
+        device.lifetime = std::chrono::milliseconds{QDateTime::currentDateTimeUtc().msecsTo(received.expires())};
+
+    // responses to M-SEARCH only carry the type within the unique service name
+    const auto type = received.type().isEmpty() ? typeFromName.toString() : received.type();
+
+    // the services of a device share its location lists, instead of each keeping a copy
+    const auto service = ServiceDescription{name, internServiceType(type), {}, {},
+                                            received.expires(), received.bootId(),
+                                            received.configId()};
+
+    // the ids of UPnP 1.1 tell cheaply whether cached device state is still valid
+    const auto isKnownDevice = !device.services.isEmpty();
+    const auto isRebooted = isKnownDevice && service.bootId() >= 0
+            && device.bootId >= 0 && service.bootId() != device.bootId;
+    const auto isReconfigured = isKnownDevice && service.configId() >= 0
+            && device.configId >= 0 && service.configId() != device.configId;
+
+    if (service.bootId() >= 0)
+        device.bootId = service.bootId();
+    if (service.configId() >= 0)
+        device.configId = service.configId();
+
+    auto isChanged = true;
+
+    if (const auto it = device.services.find(service.name()); it != device.services.end()) {
+        isChanged = isLocationAdded || !isSameService(*it, service);
+
+        if (it->type() != service.type()) {
+            releaseServiceType(it->type());
+            retainServiceType(service.type());
+        }
+
+        *it = service;
+    } else {
+        retainServiceType(service.type());
+        device.services.insert(service.name(), service);
+    }
+
+    // the expiry of services is tracked by observeService()
+    if (service.expires().isValid() && m_unicastRefresh) {
+        const auto refreshLead = device.lifetime / s_refreshLifetimeDivisor;
+        m_refreshTimer.schedule(service.expires().addMSecs(-refreshLead.count()));
     }
+
+    if (isRebooted)
+        emit deviceRebooted(deviceId.toString());
+    if (isReconfigured)
+        emit deviceConfigurationChanged(deviceId.toString(), service.configId());
+
+    // repeated announcements only refresh the expiry
+    if (!isChanged)
+        return;
+
+    const auto found = withLocations(service, device.locations, device.alternativeLocations);
+
+    // batches report each service once, either as found or as lost,
+    // whichever of the two batch signals is connected
+    m_lostServices.removeAll(found.name());
+
+    if (isSignalConnected(QMetaMethod::fromSignal(&Resolver::servicesFound))) {
+        const auto isFound = [&found](const ServiceDescription &service) {
+            return service.name() == found.name();
+        };
+
+        if (const auto it = std::find_if(m_foundServices.begin(), m_foundServices.end(), isFound);
+                it != m_foundServices.end()) {
+            *it = found;
+        } else {
+            m_foundServices += found;
+        }
+    }
+
+    scheduleBatchDelivery(m_foundServices.size() + m_lostServices.size());
+
+    emit serviceFound(found);
+}
+
+void Resolver::updateBootId(const QString &name, int bootId, int nextBootId)
+{
+    const auto device = m_devices.find(splitUniqueServiceName(name).first.toString());
+
+    // multi-homed devices announce their next boot id when an interface changes,
+    // so that using the new id is not taken for a reboot
+    if (device != m_devices.end() && device->bootId == bootId && nextBootId >= 0)
+        device->bootId = nextBootId;
+}
+
+void Resolver::removeService(const QString &name)
+{
+    const auto device = m_devices.find(splitUniqueServiceName(name).first.toString());
+
+    // goodbyes of services never seen are not worth reporting
+    if (device == m_devices.end())
+        return;
+
+    const auto service = device->services.find(name);
+
+    if (service == device->services.end())
+        return;
+
+    releaseServiceType(service->type());
+    device->services.erase(service);
+
+    if (device->services.isEmpty()) {
+        for (const auto &url : std::as_const(device->locations))
+            m_locationExpiries.remove({device.key(), url});
+        for (const auto &url : std::as_const(device->alternativeLocations))
+            m_locationExpiries.remove({device.key(), url});
+
+        m_devices.erase(device);
+    }
+
+    const auto isLost = [&name](const ServiceDescription &service) {
+        return service.name() == name;
+    };
+
+    // a service found and lost within the same batch only gets reported as lost
+    m_foundServices.erase(std::remove_if(m_foundServices.begin(),
+                                         m_foundServices.end(), isLost),
+                          m_foundServices.end());
+
+    if (isSignalConnected(QMetaMethod::fromSignal(&Resolver::servicesLost))
+            && !m_lostServices.contains(name))
+        m_lostServices += name;
+
+    scheduleBatchDelivery(m_foundServices.size() + m_lostServices.size());
+
+    emit serviceLost(name);
+}
+
+void Resolver::expireService(const QString &name)
+{
+    // devices that lost power never say goodbye
+    removeService(name);
+    MulticastResolver::expireService(name);
+}
+
+void Resolver::expireLocations(const QList<LocationKey> &keys)
+{
+    for (const auto &[deviceId, url] : keys) {
+        if (const auto device = m_devices.find(deviceId); device != m_devices.end()) {
+            device->locations.removeAll(url);
+            device->alternativeLocations.removeAll(url);
+        }
+    }
+}
+
+QList<Resolver::RefreshTarget> Resolver::takeRefreshTargets(const QDateTime &now)
+{
+    auto targets = QList<RefreshTarget>{};
+    auto nextRefresh = QDateTime{};
+
+    for (auto it = m_devices.begin(); it != m_devices.end(); ++it) {
+        const auto expiry = earliestExpiry(it->services);
+
+        if (!expiry.isValid() || expiry == it->refreshedExpiry)
+            continue;
+
+        const auto refreshLead = it->lifetime / s_refreshLifetimeDivisor;
+
+        if (const auto due = expiry.addMSecs(-refreshLead.count()); due > now) {
+            if (!nextRefresh.isValid() || due < nextRefresh)
+                nextRefresh = due;
+
+            continue;
+        }
+
+        // there is one attempt per expiry, devices that don't respond expire as usual
+        it->refreshedExpiry = expiry;
+
+        if (const auto address = locationAddress(it->locations, it->interfaceIndex); !address.isNull()) {
+            const auto port = it->searchPort > 0 ? it->searchPort : s_ssdpPort;
+            targets += RefreshTarget{it.key(), address, port, it->interfaceIndex};
+        }
+    }
+
+    if (nextRefresh.isValid())
+        m_refreshTimer.schedule(nextRefresh);
+
+    return targets;
+}
+
+QByteArray Resolver::unicastQuery(const QHostAddress &address, quint16 port)
+{
+    auto host = address;
+    host.setScopeId({});
+
+    auto hostName = host.toString().toLatin1();
+
+    if (host.protocol() == QAbstractSocket::IPv6Protocol)
+        hostName = '[' + hostName + ']';
+
+    return unicastQueryTemplate().render({
+        {s_ssdpKeyHost,    hostName},
+        {s_ssdpKeyUdpPort, QByteArray::number(port)},
+    });
+}
+
+void Resolver::refreshDevices()
+{
+    if (!m_unicastRefresh)
+        return;
+
+    for (const auto &target : takeRefreshTargets(QDateTime::currentDateTimeUtc())) {
+        const auto query = unicastQuery(target.address, target.port);
+
+        if (!writeUnicastDatagram(query, target.address, target.port, target.interfaceIndex)) {
+            qCDebug(lcResolver, "Could not refresh %ls at %ls",
+                    qUtf16Printable(target.deviceId),
+                    qUtf16Printable(target.address.toString()));
+        }
+    }
+}
+
+void Resolver::deliverBatches()
+{
+    if (!m_foundServices.isEmpty())
+        emit servicesFound(std::exchange(m_foundServices, {}));
+    if (!m_lostServices.isEmpty())
+        emit servicesLost(std::exchange(m_lostServices, {}));
 }
 
 // namespace
@@ -249,6 +1036,28 @@ QDebug operator<<(QDebug debug, const qnc::ssdp::NotifyMessage &message)
             << ", locations="    << message.locations
             << ", altLocations=" << message.altLocations
             << ", expiry="       << message.expiry
+            << ", bootId="       << message.bootId
+            << ", configId="     << message.configId
+            << ", nextBootId="   << message.nextBootId
+            << ", searchPort="   << message.searchPort
+            << ")";
+}
+
+QDebug operator<<(QDebug debug, const qnc::ssdp::DeviceDescription &device)
+{
+    const auto _ = QDebugStateSaver{debug};
+
+    if (debug.verbosity() >= QDebug::DefaultVerbosity)
+        debug.nospace() << device.staticMetaObject.className();
+
+    return debug.nospace()
+            << "("               << device.id()
+            << ", services="     << device.serviceTypes()
+            << ", location="     << device.locations()
+            << ", alt-location=" << device.alternativeLocations()
+            << ", expires="      << device.expires()
+            << ", boot-id="      << device.bootId()
+            << ", config-id="    << device.configId()
             << ")";
 }
 
@@ -265,5 +1074,7 @@ QDebug operator<<(QDebug debug, const qnc::ssdp::ServiceDescription &service)
             << ", location="     << service.locations()
             << ", alt-location=" << service.alternativeLocations()
             << ", expires="      << service.expires()
+            << ", boot-id="      << service.bootId()
+            << ", config-id="    << service.configId()
             << ")";
 }
@@ -4,12 +4,17 @@
 #ifndef QNCSSDP_RESOLVER_H
 #define QNCSSDP_RESOLVER_H
 
+#include "bytetemplate.h"
+#include "expirytable.h"
 #include "multicastresolver.h"
 
 #include <QDateTime>
 #include <QPointer>
+#include <QSet>
 #include <QUrl>
 
+#include <array>
+
 namespace qnc::ssdp {
 
 class ServiceDescription
@@ -20,18 +25,24 @@ class ServiceDescription
     Q_PROPERTY(QList<QUrl> locations            READ locations            CONSTANT FINAL)
     Q_PROPERTY(QList<QUrl> alternativeLocations READ alternativeLocations CONSTANT FINAL)
     Q_PROPERTY(QDateTime   expires              READ expires              CONSTANT FINAL)
+    Q_PROPERTY(int         bootId               READ bootId               CONSTANT FINAL)
+    Q_PROPERTY(int         configId             READ configId             CONSTANT FINAL)
 
 public:
     ServiceDescription(const QString     &name,
                        const QString     &type,
                        const QList<QUrl> &locations,
                        const QList<QUrl> &alternativeLocations,
-                       const QDateTime   &expires)
+                       const QDateTime   &expires,
+                       int                bootId   = -1,
+                       int                configId = -1)
         : m_name                {name}
         , m_type                {type}
         , m_locations           {locations}
         , m_alternativeLocations{alternativeLocations}
         , m_expires             {expires}
+        , m_bootId              {bootId}
+        , m_configId            {configId}
     {}
 
 
@@ -41,12 +52,69 @@ public:
     QList<QUrl> alternativeLocations() const { return m_alternativeLocations; }
     QDateTime   expires()              const { return m_expires; }
 
+    // BOOTID.UPNP.ORG and CONFIGID.UPNP.ORG of UPnP 1.1 devices, or -1 if not announced.
+    int         bootId()               const { return m_bootId; }
+    int         configId()             const { return m_configId; }
+
+    // The device's part of the unique service name, like "uuid:device-UUID".
+    QString     deviceId()             const;
+
 private:
     QString     m_name;
     QString     m_type;
     QList<QUrl> m_locations;
     QList<QUrl> m_alternativeLocations;
     QDateTime   m_expires;
+    int         m_bootId   = -1;
+    int         m_configId = -1;
+};
+
+// All the services of one UPnP device, which usually are a root device,
+// some embedded devices, and several services, all sharing the same locations.
+class DeviceDescription
+{
+    Q_GADGET
+    Q_PROPERTY(QString     id                   READ id                   CONSTANT FINAL)
+    Q_PROPERTY(QStringList serviceTypes         READ serviceTypes         CONSTANT FINAL)
+    Q_PROPERTY(QList<QUrl> locations            READ locations            CONSTANT FINAL)
+    Q_PROPERTY(QList<QUrl> alternativeLocations READ alternativeLocations CONSTANT FINAL)
+    Q_PROPERTY(QDateTime   expires              READ expires              CONSTANT FINAL)
+    Q_PROPERTY(int         bootId               READ bootId               CONSTANT FINAL)
+    Q_PROPERTY(int         configId             READ configId             CONSTANT FINAL)
+
+public:
+    DeviceDescription(const QString     &id,
+                      const QStringList &serviceTypes,
+                      const QList<QUrl> &locations,
+                      const QList<QUrl> &alternativeLocations,
+                      const QDateTime   &expires,
+                      int                bootId   = -1,
+                      int                configId = -1)
+        : m_id                  {id}
+        , m_serviceTypes        {serviceTypes}
+        , m_locations           {locations}
+        , m_alternativeLocations{alternativeLocations}
+        , m_expires             {expires}
+        , m_bootId              {bootId}
+        , m_configId            {configId}
+    {}
+
+    QString     id()                   const { return m_id; }
+    QStringList serviceTypes()         const { return m_serviceTypes; }
+    QList<QUrl> locations()            const { return m_locations; }
+    QList<QUrl> alternativeLocations() const { return m_alternativeLocations; }
+    QDateTime   expires()              const { return m_expires; }
+    int         bootId()               const { return m_bootId; }
+    int         configId()             const { return m_configId; }
+
+private:
+    QString     m_id;
+    QStringList m_serviceTypes;
+    QList<QUrl> m_locations;
+    QList<QUrl> m_alternativeLocations;
+    QDateTime   m_expires;
+    int         m_bootId   = -1;
+    int         m_configId = -1;
 };
 
 struct NotifyMessage
@@ -55,16 +123,22 @@ struct NotifyMessage
         Invalid,
         Alive,
         ByeBye,
+        Update,
     };
 
     Q_ENUM(Type)
 
-    Type        type         = Type::Invalid;
-    QString     serviceName  = {};
-    QString     serviceType  = {};
-    QList<QUrl> locations    = {};
-    QList<QUrl> altLocations = {};
-    QDateTime   expiry       = {};
+    Type        type             = Type::Invalid;
+    QString     serviceName      = {};
+    QString     serviceType      = {};
+    QList<QUrl> locations        = {};
+    QList<QUrl> altLocations     = {};
+    QDateTime   expiry           = {};
+    int         bootId           = -1;     // BOOTID.UPNP.ORG
+    int         configId         = -1;     // CONFIGID.UPNP.ORG
+    int         nextBootId       = -1;     // NEXTBOOTID.UPNP.ORG, sent with ssdp:update
+    quint16     searchPort       = 0;      // SEARCHPORT.UPNP.ORG, if unicast searches don't use port 1900
+    bool        isSearchResponse = false;  // a response to M-SEARCH, instead of a NOTIFY
 
     static NotifyMessage parse(const QByteArray &data, const QDateTime &now);
     static NotifyMessage parse(const QByteArray &data);
@@ -78,15 +152,33 @@ struct ServiceLookupRequest
 
     QString serviceType;
     seconds minimumDelay = seconds{0};
+    // the upper bound for MX: the resolver sends smaller values if only few devices respond
     seconds maximumDelay = seconds{5};
 };
 
 class Resolver : public core::MulticastResolver
 {
     Q_OBJECT
+    Q_PROPERTY(bool unicastRefresh READ isUnicastRefresh WRITE setUnicastRefresh NOTIFY unicastRefreshChanged FINAL)
 
 public:
-    using core::MulticastResolver::MulticastResolver;
+    explicit Resolver(QObject *parent = nullptr);
+    ~Resolver() override;
+
+    // Refreshes known devices shortly before their services expire, by sending unicast
+    // M-SEARCH queries to the hosts of their locations, as UPnP 1.1 permits. Multicast
+    // queries then are only needed for discovering new devices, so consider a longer
+    // scanInterval() in that case. Devices not responding expire as usual.
+    [[nodiscard]] bool isUnicastRefresh() const;
+    void setUnicastRefresh(bool enabled);
+
+    // The services that were seen, and that neither said goodbye nor expired since.
+    // Repeated announcements of these services only refresh their expiry, while
+    // serviceFound() is emitted for new services, and for services that changed.
+    [[nodiscard]] QList<ServiceDescription> services() const;
+
+    // The services of services(), grouped by their device.
+    [[nodiscard]] QList<DeviceDescription> devices() const;
 
 public slots:
     bool lookupService(const ServiceLookupRequest &request);
@@ -96,16 +188,117 @@ signals:
     void serviceFound(const qnc::ssdp::ServiceDescription &service);
     void serviceLost(const QString &uniqueServiceName);
 
+    // batched variants of the signals above, see batchInterval() and batchSize()
+    void servicesFound(const QList<qnc::ssdp::ServiceDescription> &services);
+    void servicesLost(const QStringList &uniqueServiceNames);
+
+    // Emitted when a known device announces a new BOOTID.UPNP.ORG without having
+    // announced it by ssdp:update before, which means it has lost all its state.
+    void deviceRebooted(const QString &deviceId);
+
+    // Emitted when a known device announces a new CONFIGID.UPNP.ORG,
+    // so that cached device and service descriptions must be fetched again.
+    void deviceConfigurationChanged(const QString &deviceId, int configId);
+
+    void unicastRefreshChanged(bool enabled);
+
 protected:
     [[nodiscard]] quint16 port() const override;
     [[nodiscard]] QHostAddress multicastGroup(const QHostAddress &address) const override;
     [[nodiscard]] QByteArray finalizeQuery(const QHostAddress &address, const QByteArray &query) const override;
+    [[nodiscard]] std::chrono::milliseconds queryJitter() const override;
+    [[nodiscard]] core::SocketFilter socketFilter() const override;
+
+    void submitQueries(const SocketTable &sockets) override;
+
+    // The number of devices that most probably will respond to the next round of queries.
+    [[nodiscard]] int expectedResponders() const { return m_expectedResponders; }
+
+    // The interned types of the known services.
+    [[nodiscard]] QStringList internedServiceTypes() const { return m_serviceTypes.keys(); }
+
+    [[nodiscard]] DatagramDecoder datagramDecoder() override;
+    [[nodiscard]] bool hasSubscribers() const override;
+
+    void deliverBatches() override;
+
+    struct RefreshTarget
+    {
+        QString      deviceId       = {};
+        QHostAddress address        = {};
+        quint16      port           = 0;
+        int          interfaceIndex = 0;
+    };
+
+    // Returns the devices whose services are about to expire, and which were not
+    // refreshed for their current expiry yet, and schedules the next refresh.
+    [[nodiscard]] QList<RefreshTarget> takeRefreshTargets(const QDateTime &now);
+    [[nodiscard]] static QByteArray unicastQuery(const QHostAddress &address, quint16 port);
+
+    void expireService(const QString &name) override;
+
+private:
+    struct DelayRange
+    {
+        int minimum = 0;
+        int maximum = 5;
+    };
+
+    struct FinalizedQuery
+    {
+        QByteArray data         = {};
+        int        maximumDelay = 0;
+    };
+
+    struct QueryTemplate
+    {
+        core::ByteTemplate                    compiledQuery = {};
+        DelayRange                            delayRange    = {};
+        mutable std::array<FinalizedQuery, 2> packets       = {}; // for IPv4 and IPv6
+    };
+
+    using LocationKey = std::pair<QString, QUrl>; // device id and location
+
+    // The services of one device. Services share the device's location lists, which
+    // merge the locations of all announcements, each expiring on its own. The type
+    // strings of services are interned, as there are many of them.
+    struct DeviceRecord
+    {
+        QList<QUrl>                        locations            = {};
+        QList<QUrl>                        alternativeLocations = {};
+        QHash<QString, ServiceDescription> services             = {}; // without locations
+        int                                bootId               = -1;
+        int                                configId             = -1;
+        int                                interfaceIndex       = 0;
+        quint16                            searchPort           = 0;
+        std::chrono::milliseconds          lifetime             = {}; // of the latest announcement
+        QDateTime                          refreshedExpiry      = {}; // a unicast search was sent for
+    };
+
+    [[nodiscard]] QString internServiceType(const QString &type) const;
+    void retainServiceType(const QString &type);
+    void releaseServiceType(const QString &type);
+    void updateService(const ServiceDescription &service, int interfaceIndex = 0, quint16 searchPort = 0);
+    void updateBootId(const QString &name, int bootId, int nextBootId);
+    void removeService(const QString &name);
+    void expireLocations(const QList<LocationKey> &keys);
+    void refreshDevices();
 
-    void processDatagram(const QNetworkDatagram &message) override;
+    core::ExpiryTimer                  m_refreshTimer;
+    core::ExpiryTable<LocationKey>     m_locationExpiries;
+    QHash<QString, DeviceRecord>       m_devices;
+    QHash<QString, int>                m_serviceTypes; // shared by services of the same type, with their count
+    QList<ServiceDescription>          m_foundServices;
+    QStringList                        m_lostServices;
+    QHash<QByteArray, QueryTemplate>   m_queryTemplates;
+    QSet<QString>                      m_responders;
+    int                                m_expectedResponders = 0;
+    bool                               m_unicastRefresh     = false;
 };
 
 } // namespace qnc::ssdp
 
+QDebug operator<<(QDebug debug, const qnc::ssdp::DeviceDescription  &device);
 QDebug operator<<(QDebug debug, const qnc::ssdp::NotifyMessage      &message);
 QDebug operator<<(QDebug debug, const qnc::ssdp::ServiceDescription &service);
 
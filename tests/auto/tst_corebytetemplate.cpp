@@ -0,0 +1,56 @@
+/* QtNetworkCrumbs - Some networking toys for Qt
+ * Copyright (C) 2019-2024 Mathias Hasselmann
+ */
+
+// QtNetworkCrumbs headers
+#include "bytetemplate.h"
+#include "literals.h"
+
+// Qt headers
+#include <QTest>
+
+namespace qnc::core::tests {
+
+class ByteTemplateTest : public QObject
+{
+    Q_OBJECT
+
+public:
+    using QObject::QObject;
+
+private slots:
+    void render()
+    {
+        const auto text = ByteTemplate{"HOST: {host}:{port}\r\nMX: {delay}\r\n{host}"};
+
+        QCOMPARE(text.placeholders(), (QByteArrayList{"host", "port", "delay"}));
+        QCOMPARE(text.render({{"host", "239.255.255.250"}, {"port", "1900"}, {"delay", "5"}}),
+                 "HOST: 239.255.255.250:1900\r\nMX: 5\r\n239.255.255.250"_ba);
+        QCOMPARE(text.render({{"delay", ""}, {"unused", "value"}}),
+                 "HOST: {host}:{port}\r\nMX: \r\n{host}"_ba);
+    }
+
+    void partialRendering()
+    {
+        const auto text = ByteTemplate{"{greeting}, {name}!"};
+        const auto partial = ByteTemplate{text.render({{"greeting", "Hello"}})};
+
+        QCOMPARE(partial.placeholders(), QByteArrayList{"name"});
+        QCOMPARE(partial.render({{"name", "World"}}), "Hello, World!"_ba);
+    }
+
+    void unbalanced()
+    {
+        QCOMPARE(ByteTemplate{}.render({}), QByteArray{});
+        QCOMPARE(ByteTemplate{"plain text"}.render({}), "plain text"_ba);
+        QCOMPARE(ByteTemplate{"open {brace"}.render({{"brace", "x"}}), "open {brace"_ba);
+        QCOMPARE(ByteTemplate{"close} {x}"}.render({{"x", "y"}}), "close} y"_ba);
+        QCOMPARE(ByteTemplate{"{x}{x}"}.placeholders(), QByteArrayList{"x"});
+    }
+};
+
+} // namespace qnc::core::tests
+
+QTEST_GUILESS_MAIN(qnc::core::tests::ByteTemplateTest)
+
+#include "tst_corebytetemplate.moc"
@@ -0,0 +1,122 @@
+/* QtNetworkCrumbs - Some networking toys for Qt
+ * Copyright (C) 2019-2024 Mathias Hasselmann
+ */
+
+// QtNetworkCrumbs headers
+#include "duplicatefilter.h"
+#include "literals.h"
+
+// Qt headers
+#include <QNetworkDatagram>
+#include <QTest>
+
+namespace qnc::core::tests {
+
+using namespace std::chrono_literals;
+
+namespace {
+
+auto datagram(const QByteArray &payload, const QHostAddress &sender = QHostAddress{0xc0a80001U},
+              uint interfaceIndex = 2)
+{
+    auto datagram = QNetworkDatagram{payload};
+    datagram.setSender(sender, 5353);
+    datagram.setInterfaceIndex(interfaceIndex);
+    return datagram;
+}
+
+} // namespace
+
+class DuplicateFilterTest : public QObject
+{
+    Q_OBJECT
+
+public:
+    using QObject::QObject;
+
+private slots:
+    void duplicates()
+    {
+        const auto start = DuplicateFilter::clock::now();
+        auto filter = DuplicateFilter{100ms};
+
+        QVERIFY(!filter.isDuplicate(datagram("first"), start));
+        QVERIFY(!filter.isDuplicate(datagram("second"), start));
+        QVERIFY(!filter.isDuplicate(datagram("firs"), start));
+
+        QVERIFY(filter.isDuplicate(datagram("first"), start + 50ms));
+        QVERIFY(filter.isDuplicate(datagram("second"), start + 99ms));
+
+        // copies are only dropped within the window
+        QVERIFY(!filter.isDuplicate(datagram("first"), start + 100ms));
+        QVERIFY(filter.isDuplicate(datagram("first"), start + 150ms));
+    }
+
+    void senders()
+    {
+        const auto now = DuplicateFilter::clock::now();
+        auto filter = DuplicateFilter{};
+
+        QVERIFY(!filter.isDuplicate(datagram("first"), now));
+        QVERIFY(filter.isDuplicate(datagram("first"), now));
+
+        // copies from other senders tell how the sender is reachable
+        QVERIFY(!filter.isDuplicate(datagram("first", QHostAddress{"fe80::1"_L1}), now));
+        QVERIFY(!filter.isDuplicate(datagram("first", QHostAddress{0xc0a80002U}), now));
+        QVERIFY(filter.isDuplicate(datagram("first", QHostAddress{"fe80::1"_L1}), now));
+    }
+
+    void interfaces()
+    {
+        using Verdict = DuplicateFilter::Verdict;
+
+        const auto now = DuplicateFilter::clock::now();
+        const auto sender = QHostAddress{0xc0a80001U};
+        auto filter = DuplicateFilter{};
+
+        QCOMPARE(filter.check(datagram("first", sender, 2), now), Verdict::Unique);
+        QCOMPARE(filter.check(datagram("first", sender, 2), now), Verdict::Repeated);
+
+        // copies via other interfaces are reported once per interface
+        QCOMPARE(filter.check(datagram("first", sender, 3), now), Verdict::ViaOtherInterface);
+        QCOMPARE(filter.check(datagram("first", sender, 3), now), Verdict::Repeated);
+        QCOMPARE(filter.check(datagram("first", sender, 2), now), Verdict::Repeated);
+        QCOMPARE(filter.check(datagram("first", sender, 0), now), Verdict::Repeated);
+        QVERIFY(filter.isDuplicate(datagram("first", sender, 4), now));
+        QCOMPARE(filter.check(datagram("first", sender, 4), now), Verdict::Repeated);
+    }
+
+    void eviction()
+    {
+        const auto now = DuplicateFilter::clock::now();
+        auto filter = DuplicateFilter{};
+
+        for (auto i = 0; i < 1000; ++i)
+            QVERIFY(!filter.isDuplicate(datagram(QByteArray::number(i)), now));
+
+        // only the most recent payloads are remembered
+        QVERIFY(filter.isDuplicate(datagram(QByteArray::number(999)), now));
+        QVERIFY(!filter.isDuplicate(datagram(QByteArray::number(0)), now));
+    }
+
+    void disabled()
+    {
+        const auto now = DuplicateFilter::clock::now();
+        auto filter = DuplicateFilter{};
+
+        QVERIFY(!filter.isDuplicate(datagram("first"), now));
+        QVERIFY(filter.isDuplicate(datagram("first"), now));
+
+        filter.setWindow(0ms);
+        QCOMPARE(filter.window(), 0ms);
+
+        QVERIFY(!filter.isDuplicate(datagram("first"), now));
+        QVERIFY(!filter.isDuplicate(datagram("first"), now));
+    }
+};
+
+} // namespace qnc::core::tests
+
+QTEST_GUILESS_MAIN(qnc::core::tests::DuplicateFilterTest)
+
+#include "tst_coreduplicatefilter.moc"
@@ -0,0 +1,119 @@
+/* QtNetworkCrumbs - Some networking toys for Qt
+ * Copyright (C) 2019-2024 Mathias Hasselmann
+ */
+
+// QtNetworkCrumbs headers
+#include "expirytable.h"
+#include "literals.h"
+
+// Qt headers
+#include <QTest>
+
+namespace qnc::core::tests {
+
+class ExpiryTableTest : public QObject
+{
+    Q_OBJECT
+
+public:
+    using QObject::QObject;
+
+private slots:
+    void expiry()
+    {
+        const auto now = QDateTime::currentDateTimeUtc();
+        auto expired = QList<QString>{};
+
+        auto context = QObject{};
+        auto table = ExpiryTable<QString>{&context, [&expired](const QList<QString> &keys) {
+            expired += keys;
+        }};
+
+        table.insert("late"_L1, now.addMSecs(1000));
+        table.insert("early"_L1, now.addMSecs(50));
+        table.insert("removed"_L1, now.addMSecs(50));
+        table.insert("never"_L1, {});
+
+        QVERIFY(table.contains("early"_L1));
+        QVERIFY(!table.contains("never"_L1));
+        QCOMPARE(table.expiry("late"_L1), now.addMSecs(1000));
+
+        QVERIFY(table.remove("removed"_L1));
+        QVERIFY(!table.remove("removed"_L1));
+
+        // each key expires at its own time, from a single timer
+        QTRY_COMPARE(expired, QList<QString>{"early"_L1});
+        QVERIFY(table.contains("late"_L1));
+        QTRY_COMPARE(expired, (QList<QString>{"early"_L1, "late"_L1}));
+        QVERIFY(!table.contains("late"_L1));
+    }
+
+    void refresh()
+    {
+        const auto now = QDateTime::currentDateTimeUtc();
+        auto expired = QList<QString>{};
+
+        auto context = QObject{};
+        auto table = ExpiryTable<QString>{&context, [&expired](const QList<QString> &keys) {
+            expired += keys;
+        }};
+
+        table.insert("service"_L1, now.addMSecs(50));
+        table.insert("service"_L1, now.addMSecs(300));
+
+        // the timer still fires for the replaced expiry, but nothing expires yet
+        QTest::qWait(150);
+        QVERIFY(expired.isEmpty());
+        QVERIFY(table.contains("service"_L1));
+
+        QTRY_COMPARE(expired, QList<QString>{"service"_L1});
+    }
+
+    void timer()
+    {
+        const auto now = QDateTime::currentDateTimeUtc();
+        auto context = QObject{};
+        auto count = 0;
+
+        auto timer = ExpiryTimer{&context, [&count] { ++count; }};
+        QVERIFY(!timer.isActive());
+
+        // only earlier due times rearm the timer
+        timer.schedule(now.addSecs(60));
+        timer.schedule(now.addMSecs(50));
+        timer.schedule(now.addSecs(30));
+        QVERIFY(timer.isActive());
+
+        QTRY_COMPARE(count, 1);
+        QVERIFY(!timer.isActive());
+
+        timer.schedule(now.addSecs(60));
+        timer.stop();
+        QVERIFY(!timer.isActive());
+    }
+
+    void distantTimer()
+    {
+        const auto now = QDateTime::currentDateTimeUtc();
+        auto context = QObject{};
+        auto count = 0;
+
+        auto timer = ExpiryTimer{&context, [&count] { ++count; }};
+
+        // intervals beyond the range of QTimer must neither overflow, nor fire immediately
+        timer.schedule(now.addDays(40));
+        QVERIFY(timer.isActive());
+        QTest::qWait(50);
+        QCOMPARE(count, 0);
+        QVERIFY(timer.isActive());
+
+        timer.schedule(now.addMSecs(100));
+        QTRY_COMPARE(count, 1);
+    }
+};
+
+} // namespace qnc::core::tests
+
+QTEST_GUILESS_MAIN(qnc::core::tests::ExpiryTableTest)
+
+#include "tst_coreexpirytable.moc"
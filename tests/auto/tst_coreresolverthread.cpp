@@ -0,0 +1,261 @@
+/* QtNetworkCrumbs - Some networking toys for Qt
+ * Copyright (C) 2019-2024 Mathias Hasselmann
+ */
+
+// QtNetworkCrumbs headers
+#include "abstractresolver.h"
+#include "batchqueue.h"
+#include "decoderpool.h"
+#include "resolverthread.h"
+
+// Qt headers
+#include <QHostAddress>
+#include <QNetworkDatagram>
+#include <QNetworkInterface>
+#include <QPointer>
+#include <QSet>
+#include <QTest>
+
+// STL headers
+#include <algorithm>
+#include <atomic>
+
+namespace qnc::core::tests {
+namespace {
+
+class TestResolver : public AbstractResolver
+{
+    Q_OBJECT
+
+public:
+    using AbstractResolver::AbstractResolver;
+    using AbstractResolver::isMonitoringNetworkInterfaces;
+    using AbstractResolver::isScanning;
+    using AbstractResolver::sockets;
+
+    void setScanningNeeded(bool needed)
+    {
+        m_scanningNeeded = needed;
+        updateScanning();
+    }
+
+signals:
+    void queriesSubmitted(QThread *thread);
+
+protected:
+    // the loopback interface makes sure there always is some usable interface
+    bool isSupportedInterface(const QNetworkInterface &iface) const override
+    { return iface.flags().testFlag(QNetworkInterface::IsLoopBack); }
+
+    bool isSupportedAddress(const QHostAddress &) const override { return true; }
+    SocketPointer createSocket(const QNetworkInterface &, const QHostAddress &) override { return std::make_shared<QObject>(); }
+    void submitQueries(const SocketTable &) override { emit queriesSubmitted(QThread::currentThread()); }
+    bool isScanningNeeded() const override { return m_scanningNeeded; }
+
+private:
+    bool m_scanningNeeded = true;
+};
+
+} // namespace
+
+class ResolverThreadTest : public QObject
+{
+    Q_OBJECT
+
+public:
+    using QObject::QObject;
+
+private slots:
+    void batchQueue()
+    {
+        constexpr auto valueCount = 10000;
+
+        auto context = QObject{};
+        auto received = QList<int>{};
+        auto batchCount = 0;
+
+        const auto queue = BatchQueue<int>{&context, [&](QList<int> batch) {
+            QCOMPARE(QThread::currentThread(), thread());
+            received += batch;
+            ++batchCount;
+        }};
+
+        const auto producer = std::unique_ptr<QThread>{QThread::create([queue] {
+            for (auto i = 0; i < valueCount; ++i)
+                queue.post(i);
+        })};
+
+        // the producer waits for this thread once the queue is full
+        producer->start();
+        QTRY_COMPARE(received.size(), valueCount);
+        QVERIFY(producer->wait());
+
+        for (auto i = 0; i < valueCount; ++i)
+            QCOMPARE(received[i], i);
+
+        QVERIFY(batchCount > 0);
+        QVERIFY(batchCount < valueCount);
+    }
+
+    void batchQueueOverflow()
+    {
+        auto context = QObject{};
+        auto received = QList<int>{};
+
+        const auto queue = BatchQueue<int>{&context, [&](QList<int> batch) {
+            received += batch;
+        }, 4};
+
+        for (auto i = 0; i < 4; ++i)
+            QVERIFY(queue.tryPost(i));
+
+        QVERIFY(!queue.tryPost(4));
+
+        // posting from the context's thread delivers the full queue immediately
+        queue.post(5);
+        QCOMPARE(received, (QList<int>{0, 1, 2, 3}));
+
+        QTRY_COMPARE(received, (QList<int>{0, 1, 2, 3, 5}));
+    }
+
+    void batchQueueInterruption()
+    {
+        auto context = QObject{};
+        auto result = std::atomic<int>{-1};
+
+        const auto queue = BatchQueue<int>{&context, [](QList<int>) {}, 4};
+
+        for (auto i = 0; i < 4; ++i)
+            QVERIFY(queue.tryPost(i));
+
+        const auto producer = std::unique_ptr<QThread>{QThread::create([queue, &result] {
+            result = queue.post(4) ? 1 : 0;
+        })};
+
+        // without events getting processed here the producer stays blocked
+        producer->start();
+        QVERIFY(!producer->wait(200));
+        QCOMPARE(result.load(), -1);
+
+        producer->requestInterruption();
+        QVERIFY(producer->wait(1000));
+        QCOMPARE(result.load(), 0);
+    }
+
+    void decoderPool()
+    {
+        constexpr auto senderCount = 8;
+        constexpr auto datagramCount = 1000;
+
+        auto context = QObject{};
+        auto received = QHash<quint32, QList<int>>{};
+        auto decodingThreads = QSet<QThread *>{};
+        auto resultCount = 0;
+
+        const auto pool = DecoderPool{4, [&](const QNetworkDatagram &datagram) {
+            return [&, sender = datagram.senderAddress().toIPv4Address() & 0xff,
+                    value = datagram.data().toInt(), decodingThread = QThread::currentThread()] {
+                QCOMPARE(QThread::currentThread(), context.thread());
+                received[sender] += value;
+                decodingThreads.insert(decodingThread);
+                ++resultCount;
+            };
+        }, &context};
+
+        QCOMPARE(pool.threadCount(), 4);
+
+        for (auto i = 0; i < datagramCount; ++i) {
+            auto datagram = QNetworkDatagram{QByteArray::number(i / senderCount)};
+            datagram.setSender(QHostAddress{static_cast<quint32>(0x0a000000 + i % senderCount)});
+            QVERIFY(pool.decode(datagram));
+        }
+
+        QTRY_COMPARE(resultCount, datagramCount);
+
+        QCOMPARE(received.size(), senderCount);
+
+        for (const auto &values : received) {
+            QCOMPARE(values.size(), datagramCount / senderCount);
+
+            for (auto i = 0; i < values.size(); ++i)
+                QCOMPARE(values[i], i);
+        }
+
+        QVERIFY(!decodingThreads.contains(thread()));
+    }
+
+    void resolverThread()
+    {
+        auto ioThread = ResolverThread{};
+        auto context = QObject{};
+        auto submittingThreads = QList<QThread *>{};
+
+        const auto resolver = QPointer<TestResolver>{new TestResolver};
+        resolver->setScanInterval(10);
+
+        connectBatched(resolver.data(), &TestResolver::queriesSubmitted,
+                       &context, [&](QList<QThread *> threads) {
+            QCOMPARE(QThread::currentThread(), thread());
+            submittingThreads += threads;
+        });
+
+        ioThread.addResolver(resolver);
+        QCOMPARE(resolver->thread(), &ioThread);
+
+        ioThread.start();
+
+        QTRY_VERIFY(submittingThreads.size() >= 3);
+        QVERIFY(std::all_of(submittingThreads.cbegin(), submittingThreads.cend(),
+                            [&ioThread](QThread *thread) { return thread == &ioThread; }));
+
+        ioThread.quit();
+        QVERIFY(ioThread.wait());
+        QVERIFY(resolver.isNull());
+    }
+
+    void demandAwareScanning()
+    {
+        auto resolver = TestResolver{};
+        auto submissionCount = 0;
+
+        connect(&resolver, &TestResolver::queriesSubmitted, this, [&submissionCount] { ++submissionCount; });
+
+        // scanning starts lazily
+        resolver.setScanningNeeded(false);
+        QVERIFY(!resolver.isScanning());
+        QTest::qWait(50);
+        QVERIFY(!resolver.isScanning());
+        QCOMPARE(submissionCount, 0);
+
+        // the first scan happens immediately
+        resolver.setScanningNeeded(true);
+        QVERIFY(resolver.isScanning());
+        QTRY_COMPARE(submissionCount, 1);
+        QCOMPARE(resolver.scanInterval(), 15'000);
+
+        // no more scans while paused
+        resolver.setScanInterval(10);
+        QTRY_VERIFY(submissionCount >= 3);
+        QVERIFY(!resolver.sockets().isEmpty());
+        resolver.setScanningNeeded(false);
+
+        const auto pausedCount = submissionCount;
+        QTest::qWait(50);
+        QCOMPARE(submissionCount, pausedCount);
+
+        // sockets and the network monitor are closed while paused
+        QVERIFY(resolver.sockets().isEmpty());
+        QVERIFY(!resolver.isMonitoringNetworkInterfaces());
+
+        // ...and come back when resuming
+        resolver.setScanningNeeded(true);
+        QTRY_VERIFY(submissionCount > pausedCount);
+        QVERIFY(!resolver.sockets().isEmpty());
+    }
+};
+
+} // namespace qnc::core::tests
+
+QTEST_GUILESS_MAIN(qnc::core::tests::ResolverThreadTest)
+
+#include "tst_coreresolverthread.moc"
@@ -0,0 +1,119 @@
+/* QtNetworkCrumbs - Some networking toys for Qt
+ * Copyright (C) 2019-2024 Mathias Hasselmann
+ */
+
+// QtNetworkCrumbs headers
+#include "ringbuffer.h"
+
+// Qt headers
+#include <QTest>
+#include <QThread>
+
+// STL headers
+#include <memory>
+#include <vector>
+
+namespace qnc::core::tests {
+
+class RingBufferTest : public QObject
+{
+    Q_OBJECT
+
+public:
+    using QObject::QObject;
+
+private slots:
+    void capacity_data()
+    {
+        QTest::addColumn<int>("requested");
+        QTest::addColumn<int>("expected");
+
+        QTest::newRow("zero")   << 0    << 2;
+        QTest::newRow("one")    << 1    << 2;
+        QTest::newRow("three")  << 3    << 4;
+        QTest::newRow("exact")  << 64   << 64;
+        QTest::newRow("odd")    << 1000 << 1024;
+    }
+
+    void capacity()
+    {
+        const QFETCH(int, requested);
+        const QFETCH(int, expected);
+
+        const auto buffer = RingBuffer<int>{static_cast<std::size_t>(requested)};
+        QCOMPARE(buffer.capacity(), static_cast<std::size_t>(expected));
+    }
+
+    void pushAndPop()
+    {
+        auto buffer = RingBuffer<QString>{4};
+        auto value = QString{};
+
+        QVERIFY(!buffer.pop(value));
+
+        for (auto round = 0; round < 3; ++round) {
+            for (auto i = 0; i < 4; ++i)
+                QVERIFY(buffer.push(QString::number(round * 10 + i)));
+
+            auto rejected = QString::number(99);
+            QVERIFY(!buffer.push(std::move(rejected)));
+            QCOMPARE(rejected, QString::number(99));
+
+            for (auto i = 0; i < 4; ++i) {
+                QVERIFY(buffer.pop(value));
+                QCOMPARE(value, QString::number(round * 10 + i));
+            }
+
+            QVERIFY(!buffer.pop(value));
+        }
+    }
+
+    void multipleProducers()
+    {
+        constexpr auto producerCount = 4;
+        constexpr auto valueCount = 100000;
+
+        auto buffer = RingBuffer<qint64>{64};
+        auto producers = std::vector<std::unique_ptr<QThread>>{};
+
+        for (auto producer = 0; producer < producerCount; ++producer) {
+            producers.emplace_back(QThread::create([&buffer, producer] {
+                for (auto i = 0; i < valueCount; ++i) {
+                    while (!buffer.push(qint64{producer} * valueCount + i))
+                        QThread::yieldCurrentThread();
+                }
+            }));
+
+            producers.back()->start();
+        }
+
+        auto lastValues = QList<qint64>{};
+
+        for (auto producer = 0; producer < producerCount; ++producer)
+            lastValues += -1;
+
+        for (auto received = 0; received < producerCount * valueCount; ) {
+            auto value = qint64{};
+
+            if (!buffer.pop(value)) {
+                QThread::yieldCurrentThread();
+                continue;
+            }
+
+            // the values of each producer must arrive in order
+            const auto producer = static_cast<int>(value / valueCount);
+            QCOMPARE(value % valueCount, lastValues[producer] + 1);
+            lastValues[producer] = value % valueCount;
+            ++received;
+        }
+
+        for (const auto &producer : producers)
+            QVERIFY(producer->wait());
+    }
+};
+
+} // namespace qnc::core::tests
+
+QTEST_GUILESS_MAIN(qnc::core::tests::RingBufferTest)
+
+#include "tst_coreringbuffer.moc"
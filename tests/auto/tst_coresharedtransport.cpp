@@ -0,0 +1,149 @@
+/* QtNetworkCrumbs - Some networking toys for Qt
+ * Copyright (C) 2019-2024 Mathias Hasselmann
+ */
+
+// QtNetworkCrumbs headers
+#include "literals.h"
+#include "sharedtransport.h"
+
+// Qt headers
+#include <QNetworkDatagram>
+#include <QNetworkInterface>
+#include <QSignalSpy>
+#include <QTest>
+#include <QThread>
+
+namespace qnc::core::tests {
+namespace {
+
+class FakeEngine : public DatagramEngine
+{
+    Q_OBJECT
+
+public:
+    using DatagramEngine::DatagramEngine;
+
+    SocketPointer createSocket(const QNetworkInterface &, const QHostAddress &,
+                               const QHostAddress &, quint16) override
+    {
+        ++socketCount;
+        return std::make_shared<QObject>();
+    }
+
+    qintptr socketDescriptor(const SocketPointer &) const override { return -1; }
+    void setReceiveBufferSize(const SocketPointer &, int size) override { receiveBufferSize = size; }
+
+    void writeDatagram(const SocketPointer &, const QByteArray &data,
+                       const QHostAddress &, quint16) override
+    {
+        emit datagramReceived(QNetworkDatagram{data});
+    }
+
+    static int socketCount;
+    int receiveBufferSize = 0;
+};
+
+int FakeEngine::socketCount = 0;
+
+auto makeKey(quint16 port, int interfaceIndex = 1)
+{
+    return SharedTransport::Key{0, QHostAddress{"224.0.0.251"_L1}, port,
+                                interfaceIndex, QHostAddress{"192.168.0.2"_L1}, 0};
+}
+
+auto acquire(const SharedTransport::Key &key)
+{
+    return SharedTransport::acquire(key, QNetworkInterface{}, [] {
+        return std::make_unique<FakeEngine>();
+    });
+}
+
+} // namespace
+
+class SharedTransportTest : public QObject
+{
+    Q_OBJECT
+
+public:
+    using QObject::QObject;
+
+private slots:
+    void initTestCase()
+    {
+        qRegisterMetaType<QNetworkDatagram>();
+    }
+
+    void init()
+    {
+        FakeEngine::socketCount = 0;
+    }
+
+    void sharing()
+    {
+        const auto first = acquire(makeKey(5353));
+        const auto second = acquire(makeKey(5353));
+        const auto otherPort = acquire(makeKey(1900));
+        const auto otherInterface = acquire(makeKey(5353, 2));
+
+        QVERIFY(first);
+        QCOMPARE(second, first);
+        QVERIFY(otherPort != first);
+        QVERIFY(otherInterface != first);
+        QVERIFY(otherInterface != otherPort);
+        QCOMPARE(FakeEngine::socketCount, 3);
+
+        QCOMPARE(first->key(), makeKey(5353));
+        QCOMPARE(otherPort->key(), makeKey(1900));
+    }
+
+    void release()
+    {
+        auto transport = acquire(makeKey(5353));
+        const auto observer = std::weak_ptr<SharedTransport>{transport};
+
+        transport.reset();
+        QVERIFY(observer.expired());
+
+        // the socket gets reopened once needed again
+        transport = acquire(makeKey(5353));
+        QVERIFY(transport);
+        QCOMPARE(FakeEngine::socketCount, 2);
+    }
+
+    void threads()
+    {
+        const auto transport = acquire(makeKey(5353));
+        auto otherTransport = SharedTransport::Pointer{};
+
+        const auto thread = std::unique_ptr<QThread>{QThread::create([&otherTransport] {
+            otherTransport = acquire(makeKey(5353));
+            otherTransport.reset();
+        })};
+
+        thread->start();
+        QVERIFY(thread->wait());
+
+        // sockets are only shared within the same thread
+        QVERIFY(transport);
+        QCOMPARE(FakeEngine::socketCount, 2);
+    }
+
+    void fanOut()
+    {
+        const auto transport = acquire(makeKey(5353));
+        auto firstSpy = QSignalSpy{transport.get(), &SharedTransport::datagramReceived};
+        auto secondSpy = QSignalSpy{transport.get(), &SharedTransport::datagramReceived};
+
+        transport->writeDatagram("hello", QHostAddress{"224.0.0.251"_L1}, 5353);
+
+        QCOMPARE(firstSpy.count(), 1);
+        QCOMPARE(secondSpy.count(), 1);
+        QCOMPARE(firstSpy.first().first().value<QNetworkDatagram>().data(), QByteArray{"hello"});
+    }
+};
+
+} // namespace qnc::core::tests
+
+QTEST_GUILESS_MAIN(qnc::core::tests::SharedTransportTest)
+
+#include "tst_coresharedtransport.moc"
@@ -0,0 +1,88 @@
+/* QtNetworkCrumbs - Some networking toys for Qt
+ * Copyright (C) 2019-2024 Mathias Hasselmann
+ */
+
+// QtNetworkCrumbs headers
+#include "tokenbucket.h"
+
+// Qt headers
+#include <QTest>
+
+namespace qnc::core::tests {
+
+using namespace std::chrono_literals;
+
+namespace {
+
+auto delay(const TokenBucket &bucket, TokenBucket::clock::time_point now)
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(bucket.delay(now));
+}
+
+} // namespace
+
+class TokenBucketTest : public QObject
+{
+    Q_OBJECT
+
+public:
+    using QObject::QObject;
+
+private slots:
+    void burst()
+    {
+        const auto start = TokenBucket::clock::now();
+        auto bucket = TokenBucket{10, 3};
+
+        QVERIFY(bucket.isLimited());
+        QCOMPARE(delay(bucket, start), 0ms);
+
+        QVERIFY(bucket.take(start));
+        QVERIFY(bucket.take(start));
+        QVERIFY(bucket.take(start));
+
+        // the burst is exhausted, tokens get refilled every 100 ms
+        QVERIFY(!bucket.take(start));
+        QCOMPARE(delay(bucket, start), 100ms);
+        QCOMPARE(delay(bucket, start + 40ms), 60ms);
+
+        QVERIFY(!bucket.take(start + 99ms));
+        QVERIFY(bucket.take(start + 100ms));
+        QVERIFY(!bucket.take(start + 100ms));
+        QCOMPARE(delay(bucket, start + 100ms), 100ms);
+    }
+
+    void refill()
+    {
+        const auto start = TokenBucket::clock::now();
+        auto bucket = TokenBucket{10, 2};
+
+        QVERIFY(bucket.take(start));
+        QVERIFY(bucket.take(start));
+        QVERIFY(!bucket.take(start));
+
+        // idle time refills the bucket, but never beyond its burst
+        QVERIFY(bucket.take(start + 1s));
+        QVERIFY(bucket.take(start + 1s));
+        QVERIFY(!bucket.take(start + 1s));
+    }
+
+    void unlimited()
+    {
+        const auto now = TokenBucket::clock::now();
+        auto bucket = TokenBucket{};
+
+        QVERIFY(!bucket.isLimited());
+
+        for (auto i = 0; i < 1000; ++i)
+            QVERIFY(bucket.take(now));
+
+        QCOMPARE(delay(bucket, now), 0ms);
+    }
+};
+
+} // namespace qnc::core::tests
+
+QTEST_GUILESS_MAIN(qnc::core::tests::TokenBucketTest)
+
+#include "tst_coretokenbucket.moc"
@@ -0,0 +1,168 @@
+/* QtNetworkCrumbs - Some networking toys for Qt
+ * Copyright (C) 2019-2024 Mathias Hasselmann
+ */
+
+// QtNetworkCrumbs headers
+#include "literals.h"
+#include "warmcache.h"
+
+// Qt headers
+#include <QTemporaryDir>
+#include <QTest>
+
+namespace qnc::core::tests {
+namespace {
+
+auto makeDatagram(const QByteArray &payload, const QHostAddress &sender, uint interfaceIndex = 2)
+{
+    auto datagram = QNetworkDatagram{payload};
+    datagram.setSender(sender, 5353);
+    datagram.setInterfaceIndex(interfaceIndex);
+    return datagram;
+}
+
+auto payloads(const QList<WarmCache::Entry> &entries)
+{
+    auto payloads = QByteArrayList{};
+
+    for (const auto &entry : entries)
+        payloads += entry.datagram.data();
+
+    return payloads;
+}
+
+} // namespace
+
+class WarmCacheTest : public QObject
+{
+    Q_OBJECT
+
+public:
+    using QObject::QObject;
+
+private slots:
+    void storeAndLoad()
+    {
+        const auto dir = QTemporaryDir{};
+        const auto fileName = dir.filePath("cache"_L1);
+        const auto now = QDateTime::currentDateTimeUtc();
+        const auto expiry = now.addSecs(60);
+
+        {
+            auto cache = WarmCache{fileName};
+            QVERIFY(cache.load(now).isEmpty());
+
+            QVERIFY(cache.store(makeDatagram("first", QHostAddress{0xc0a80001U}), expiry, {"a"_L1}, now));
+            QVERIFY(cache.store(makeDatagram("second", QHostAddress{"fe80::1"_L1}, 3), expiry,
+                                {"b"_L1, "c"_L1}, now.addSecs(-10)));
+        }
+
+        auto cache = WarmCache{fileName};
+        const auto entries = cache.load(now);
+
+        QCOMPARE(payloads(entries), (QByteArrayList{"first", "second"}));
+        QCOMPARE(entries[0].datagram.senderAddress(), QHostAddress{0xc0a80001U});
+        QCOMPARE(entries[0].datagram.senderPort(), 5353);
+        QCOMPARE(entries[0].datagram.interfaceIndex(), 2U);
+        QCOMPARE(entries[1].datagram.senderAddress(), QHostAddress{"fe80::1"_L1});
+        QCOMPARE(entries[1].datagram.interfaceIndex(), 3U);
+        QCOMPARE(entries[0].expiry, expiry);
+        QCOMPARE(entries[0].received, now);
+        QCOMPARE(entries[0].keys, QStringList{"a"_L1});
+        QCOMPARE(entries[1].received, now.addSecs(-10));
+        QCOMPARE(entries[1].keys, (QStringList{"b"_L1, "c"_L1}));
+
+        // expired entries are skipped
+        QVERIFY(cache.load(expiry).isEmpty());
+    }
+
+    void refresh()
+    {
+        const auto dir = QTemporaryDir{};
+        const auto fileName = dir.filePath("cache"_L1);
+        const auto now = QDateTime::currentDateTimeUtc();
+        const auto datagram = makeDatagram("payload", QHostAddress{0xc0a80001U});
+
+        auto cache = WarmCache{fileName};
+
+        // identical datagrams are only stored again after half of their lifetime
+        QVERIFY(cache.store(datagram, now.addSecs(100), {}, now));
+        QVERIFY(!cache.store(datagram, now.addSecs(110), {}, now.addSecs(10)));
+        QVERIFY(cache.store(datagram, now.addSecs(160), {}, now.addSecs(60)));
+
+        const auto entries = WarmCache{fileName}.load(now);
+        QCOMPARE(entries.size(), 1);
+        QCOMPARE(entries[0].expiry, now.addSecs(160));
+        QCOMPARE(entries[0].received, now.addSecs(60));
+    }
+
+    void remove()
+    {
+        const auto dir = QTemporaryDir{};
+        const auto fileName = dir.filePath("cache"_L1);
+        const auto now = QDateTime::currentDateTimeUtc();
+        const auto expiry = now.addSecs(60);
+
+        {
+            auto cache = WarmCache{fileName};
+            QVERIFY(cache.store(makeDatagram("first", QHostAddress{0xc0a80001U}), expiry, {"a"_L1}, now));
+            QVERIFY(cache.store(makeDatagram("second", QHostAddress{0xc0a80001U}), expiry, {"a"_L1, "b"_L1}, now));
+            QVERIFY(cache.store(makeDatagram("third", QHostAddress{0xc0a80001U}), expiry, {"c"_L1}, now));
+
+            // tombstones only get written for keys of valid entries
+            QVERIFY(cache.remove("a"_L1, now));
+            QVERIFY(!cache.remove("a"_L1, now));
+            QVERIFY(!cache.remove("unknown"_L1, now));
+
+            // tombstones don't suppress entries written after them
+            QVERIFY(cache.store(makeDatagram("fourth", QHostAddress{0xc0a80001U}), expiry, {"a"_L1}, now));
+        }
+
+        auto cache = WarmCache{fileName};
+        QCOMPARE(payloads(cache.load(now)), (QByteArrayList{"third", "fourth"}));
+
+        // entries can also be removed after loading them
+        QVERIFY(cache.remove("c"_L1, now));
+        QCOMPARE(payloads(WarmCache{fileName}.load(now)), QByteArrayList{"fourth"});
+
+        // compaction drops the suppressed entries, and with them the tombstones
+        auto file = QFile{fileName};
+        QCOMPARE(file.size(), qint64{8 + 48 + 6 + 1});
+    }
+
+    void corruptFile()
+    {
+        const auto dir = QTemporaryDir{};
+        const auto fileName = dir.filePath("cache"_L1);
+        const auto now = QDateTime::currentDateTimeUtc();
+
+        {
+            auto cache = WarmCache{fileName};
+            QVERIFY(cache.store(makeDatagram("intact", QHostAddress{0xc0a80001U}), now.addSecs(60), {"a"_L1}, now));
+        }
+
+        // simulate an interrupted write
+        auto file = QFile{fileName};
+        QVERIFY(file.open(QFile::Append));
+        file.write("\x01\x02\x03");
+        file.close();
+
+        QCOMPARE(payloads(WarmCache{fileName}.load(now)), QByteArrayList{"intact"});
+
+        // the corrupt tail got dropped by rewriting the file
+        QCOMPARE(payloads(WarmCache{fileName}.load(now)), QByteArrayList{"intact"});
+        QCOMPARE(file.size(), qint64{8 + 48 + 6 + 1});
+
+        QVERIFY(file.open(QFile::WriteOnly | QFile::Truncate));
+        file.write("garbage");
+        file.close();
+
+        QCOMPARE(WarmCache{fileName}.load(now).size(), 0);
+    }
+};
+
+} // namespace qnc::core::tests
+
+QTEST_GUILESS_MAIN(qnc::core::tests::WarmCacheTest)
+
+#include "tst_corewarmcache.moc"
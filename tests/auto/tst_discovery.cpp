@@ -0,0 +1,189 @@
+/* QtNetworkCrumbs - Some networking toys for Qt
+ * Copyright (C) 2019-2024 Mathias Hasselmann
+ */
+
+// QtNetworkCrumbs headers
+#include "discoveryclient.h"
+#include "discoveryprotocol.h"
+#include "discoveryserver.h"
+#include "literals.h"
+
+// Qt headers
+#include <QCoreApplication>
+#include <QRegularExpression>
+#include <QSignalSpy>
+#include <QTest>
+
+namespace qnc::discovery::tests {
+namespace {
+
+auto hostRecord()
+{
+    return Record{Record::Kind::HostName, "printer.local"_L1, {},
+                  {QHostAddress{0xc0a80001U}, QHostAddress{"fe80::1"_L1}}};
+}
+
+auto serviceRecord()
+{
+    return Record{Record::Kind::SsdpService, "uuid:1234::upnp:rootdevice"_L1, "upnp:rootdevice"_L1,
+                  {}, {QUrl{"http://192.168.0.1/desc.xml"_L1}}, {"vendor=test"_L1},
+                  QDateTime::currentDateTimeUtc().addSecs(1800)};
+}
+
+auto uniqueServerName()
+{
+    return "qnc-discovery-test-%1"_L1.arg(QCoreApplication::applicationPid());
+}
+
+} // namespace
+
+class DiscoveryTest : public QObject
+{
+    Q_OBJECT
+
+public:
+    using QObject::QObject;
+
+private slots:
+    void initTestCase()
+    {
+        qRegisterMetaType<Record>();
+        qRegisterMetaType<QList<Record>>();
+        qRegisterMetaType<Record::Kind>();
+    }
+
+    void messages()
+    {
+        const auto records = QList<Record>{hostRecord(), serviceRecord()};
+
+        auto reader = protocol::MessageReader{};
+        const auto data = protocol::encodeSnapshot(records)
+                + protocol::encodeRecordFound(records[1])
+                + protocol::encodeRecordLost(records[0].key());
+
+        // messages can arrive in arbitrary fragments
+        for (auto i = 0; i < data.size(); i += 7)
+            reader.append(data.mid(i, 7));
+
+        const auto snapshot = reader.next();
+        QVERIFY(snapshot);
+        QCOMPARE(snapshot->type, protocol::MessageType::Snapshot);
+        QCOMPARE(protocol::decodeSnapshot(snapshot->payload), std::make_optional(records));
+
+        const auto found = reader.next();
+        QVERIFY(found);
+        QCOMPARE(found->type, protocol::MessageType::RecordFound);
+        QCOMPARE(protocol::decodeRecordFound(found->payload), std::make_optional(records[1]));
+
+        const auto lost = reader.next();
+        QVERIFY(lost);
+        QCOMPARE(lost->type, protocol::MessageType::RecordLost);
+        QCOMPARE(protocol::decodeRecordLost(lost->payload), std::make_optional(records[0].key()));
+
+        QVERIFY(!reader.next());
+        QVERIFY(reader.isValid());
+    }
+
+    void corruptStream()
+    {
+        auto reader = protocol::MessageReader{};
+        reader.append(QByteArray::fromHex("ffffffff01"));
+
+        QVERIFY(!reader.next());
+        QVERIFY(!reader.isValid());
+
+        QVERIFY(!protocol::decodeRecordFound("garbage"));
+        QVERIFY(!protocol::decodeRecordLost({}));
+    }
+
+    void snapshotAndDeltas()
+    {
+        auto server = Server{};
+        QVERIFY(server.listen(uniqueServerName()));
+        server.publish(hostRecord());
+
+        auto client = Client{};
+        auto snapshots = QSignalSpy{&client, &Client::snapshotReceived};
+        auto foundRecords = QSignalSpy{&client, &Client::recordFound};
+        auto lostRecords = QSignalSpy{&client, &Client::recordLost};
+
+        client.connectToServer(server.serverName());
+
+        QTRY_COMPARE(snapshots.count(), 1);
+        QCOMPARE(client.isConnected(), true);
+        QCOMPARE(server.clientCount(), 1);
+        QCOMPARE(client.records(), QList<Record>{hostRecord()});
+
+        // unchanged records are not sent again
+        server.publish(hostRecord());
+        server.publish(serviceRecord());
+
+        QTRY_COMPARE(foundRecords.count(), 1);
+        QCOMPARE(client.records().size(), 2);
+
+        server.withdraw(Record::Kind::HostName, hostRecord().name());
+
+        QTRY_COMPARE(lostRecords.count(), 1);
+        QCOMPARE(lostRecords.first().at(1).toString(), hostRecord().name());
+        QCOMPARE(client.records(), server.records());
+
+        client.disconnectFromServer();
+        QTRY_COMPARE(server.clientCount(), 0);
+    }
+
+    void refreshedExpiry()
+    {
+        auto server = Server{};
+        QVERIFY(server.listen(uniqueServerName()));
+
+        auto client = Client{};
+        auto foundRecords = QSignalSpy{&client, &Client::recordFound};
+        client.connectToServer(server.serverName());
+        QTRY_VERIFY(client.isConnected());
+
+        const auto record = serviceRecord();
+        server.publish(record);
+        QTRY_COMPARE(foundRecords.count(), 1);
+
+        // a new expiry alone is no news for the clients, but the server keeps it
+        const auto refreshedRecord = Record{record.kind(), record.name(), record.type(), record.addresses(),
+                                            record.locations(), record.info(), record.expiry().addSecs(60)};
+
+        server.publish(refreshedRecord);
+        QCOMPARE(server.records().constFirst().expiry(), refreshedRecord.expiry());
+
+        const auto changedRecord = Record{record.kind(), record.name(), record.type(), record.addresses(),
+                                          {QUrl{"http://192.168.0.2/desc.xml"_L1}}, record.info(),
+                                          record.expiry().addSecs(60)};
+
+        server.publish(changedRecord);
+        QTRY_COMPARE(foundRecords.count(), 2);
+        QCOMPARE(client.records().constFirst().locations(), changedRecord.locations());
+    }
+
+    void runningServer()
+    {
+        auto server = Server{};
+        QVERIFY(server.listen(uniqueServerName()));
+
+        // a second instance must not take over the socket of a running one
+        auto secondServer = Server{};
+        QTest::ignoreMessage(QtWarningMsg, QRegularExpression{"Another server already listens on .*"_L1});
+        QVERIFY(!secondServer.listen(uniqueServerName()));
+
+        server.publish(hostRecord());
+
+        auto client = Client{};
+        auto snapshots = QSignalSpy{&client, &Client::snapshotReceived};
+        client.connectToServer(uniqueServerName());
+
+        QTRY_COMPARE(snapshots.count(), 1);
+        QCOMPARE(client.records(), QList<Record>{hostRecord()});
+    }
+};
+
+} // namespace qnc::discovery::tests
+
+QTEST_GUILESS_MAIN(qnc::discovery::tests::DiscoveryTest)
+
+#include "tst_discovery.moc"
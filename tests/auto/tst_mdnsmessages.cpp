@@ -6,6 +6,7 @@
 
 // QtNetworkCrumbs headers
 #include "literals.h"
+#include "mdnsrelevancefilter.h"
 
 // Qt headers
 #include <QHostAddress>
@@ -506,6 +507,84 @@ private slots:
         QCOMPARE(name.endsWith(prefix), expectedResult);
     }
 
+    void relevanceFilter_data()
+    {
+        QTest::addColumn<QByteArray>("message");
+        QTest::addColumn<bool>("expectedResult");
+
+        QTest::newRow("service type")
+                << QByteArray::fromHex("0000 8400 0000 0001 0000 0000"
+                                       "05 5f68747470 04 5f746370 05 6c6f63616c 00"         // _http._tcp.local
+                                       "000c 0001 00000078 0002 c00c")
+                << true;
+
+        QTest::newRow("service type, other case")
+                << QByteArray::fromHex("0000 8400 0000 0001 0000 0000"
+                                       "05 5f48545450 04 5f544350 05 4c4f43414c 00"         // _HTTP._TCP.LOCAL
+                                       "000c 0001 00000078 0002 c00c")
+                << true;
+
+        QTest::newRow("service instance")
+                << QByteArray::fromHex("0000 8400 0000 0000 0000 0002"
+                                       "04 686f7374 05 6c6f63616c 00"                       // host.local
+                                       "0001 8001 00000078 0004 c0a80001"
+                                       "03 666f6f 05 5f68747470 04 5f746370 c011"           // foo._http._tcp.local
+                                       "0010 8001 00000078 0000")
+                << true;
+
+        QTest::newRow("host name")
+                << QByteArray::fromHex("0000 8400 0000 0001 0000 0000"
+                                       "05 6e61737331 05 6c6f63616c 00"                     // nass1.local
+                                       "0001 8001 00000078 0004 c0a80001")
+                << true;
+
+        QTest::newRow("other service")
+                << QByteArray::fromHex("0000 8400 0000 0001 0000 0000"
+                                       "05 5f69707073 04 5f746370 05 6c6f63616c 00"         // _ipps._tcp.local
+                                       "000c 0001 00000078 0002 c00c")
+                << false;
+
+        QTest::newRow("query")
+                << QByteArray::fromHex("0000 0000 0001 0000 0000 0000"
+                                       "05 5f68747470 04 5f746370 05 6c6f63616c 00"
+                                       "000c 0001")
+                << false;
+
+        QTest::newRow("failed response")
+                << QByteArray::fromHex("0000 8403 0000 0001 0000 0000"
+                                       "05 5f68747470 04 5f746370 05 6c6f63616c 00"
+                                       "000c 0001 00000078 0002 c00c")
+                << false;
+
+        QTest::newRow("pointer loop")
+                << QByteArray::fromHex("0000 8400 0000 0001 0000 0000"
+                                       "c00c 000c 0001 00000078 0000")
+                << false;
+
+        QTest::newRow("truncated")
+                << QByteArray::fromHex("0000 8400 0000 0001 0000 0000"
+                                       "05 5f68747470 04 5f74")
+                << false;
+    }
+
+    void relevanceFilter()
+    {
+        const QFETCH(QByteArray, message);
+        const QFETCH(bool, expectedResult);
+
+        auto serviceQuery = Message{};
+        serviceQuery.addQuestion({"_http._tcp.local", Message::PTR});
+
+        auto hostQuery = Message{};
+        hostQuery.addQuestion({"nass1.local", Message::A});
+        hostQuery.addQuestion({"nass1.local", Message::AAAA});
+
+        const auto filter = RelevanceFilter{{serviceQuery.data(), hostQuery.data()}};
+
+        QVERIFY(!filter.isEmpty());
+        QCOMPARE(filter.isRelevant(message), expectedResult);
+    }
+
 private:
     using RecordList = QList<QVariantList>;
 };
@@ -7,10 +7,25 @@
 #include "mdnsresolver.h"
 #include "mdnsurlfinder.h"
 #include "literals.h"
+#include "socketfilter.h"
+#include "warmcache.h"
 
 // Qt headers
+#include <QElapsedTimer>
+#include <QMetaEnum>
+#include <QNetworkDatagram>
+#include <QNetworkInterface>
 #include <QSignalSpy>
+#include <QTemporaryDir>
 #include <QTest>
+#include <QUdpSocket>
+
+#ifdef Q_OS_LINUX
+
+// POSIX headers
+#include <sys/socket.h>
+
+#endif // Q_OS_LINUX
 
 namespace QTest {
 
@@ -38,6 +53,124 @@ constexpr int ms(const duration<Ts...> &duration)
     return static_cast<int>(duration_cast<milliseconds>(duration).count());
 }
 
+class FilterTestResolver : public Resolver
+{
+public:
+    explicit FilterTestResolver(quint16 responderPort)
+        : m_responderPort{responderPort}
+    {}
+
+    using Resolver::socketFilter;
+
+protected:
+    quint16 port() const override { return m_responderPort; }
+
+private:
+    quint16 m_responderPort;
+};
+
+class ScanningTestResolver : public Resolver
+{
+public:
+    using Resolver::isScanningNeeded;
+};
+
+// opens its sockets on the loopback interface, and listens on an unused port
+class ListenerTestResolver : public Resolver
+{
+public:
+    explicit ListenerTestResolver(quint16 port)
+        : m_port{port}
+    {}
+
+    using Resolver::sockets;
+    using Resolver::socketsAndListeners;
+
+protected:
+    bool isSupportedInterface(const QNetworkInterface &iface) const override
+    { return iface.flags().testFlag(QNetworkInterface::IsLoopBack); }
+
+    bool isSupportedAddress(const QHostAddress &address) const override
+    { return address == QHostAddress{QHostAddress::LocalHost}; }
+
+    quint16 port() const override { return m_port; }
+
+private:
+    quint16 m_port;
+};
+
+quint16 unusedPort()
+{
+    auto socket = QUdpSocket{};
+
+    if (!socket.bind(QHostAddress::LocalHost))
+        return 0;
+
+    return socket.localPort();
+}
+
+int receiveBufferSize(const std::shared_ptr<QObject> &socket)
+{
+    if (const auto udpSocket = qobject_cast<QUdpSocket *>(socket.get()))
+        return udpSocket->socketOption(QUdpSocket::ReceiveBufferSizeSocketOption).toInt();
+
+    return -1;
+}
+
+#ifdef Q_OS_LINUX
+
+// the number of instructions in the socket filter attached to the socket
+int socketFilterSize(const std::shared_ptr<QObject> &socket)
+{
+    const auto udpSocket = qobject_cast<QUdpSocket *>(socket.get());
+    auto size = socklen_t{0};
+
+    if (!udpSocket || ::getsockopt(static_cast<int>(udpSocket->socketDescriptor()),
+                                   SOL_SOCKET, SO_GET_FILTER, nullptr, &size) < 0)
+        return -1;
+
+    return static_cast<int>(size);
+}
+
+#endif // Q_OS_LINUX
+
+using HostNameTable = QHash<QString, QList<QHostAddress>>;
+
+class DecoderTestResolver : public Resolver
+{
+public:
+    void receive(const QByteArray &data, const QHostAddress &sender = {}, uint interfaceIndex = 0)
+    {
+        if (const auto apply = datagramDecoder()(makeDatagram(data, sender, interfaceIndex)))
+            apply();
+    }
+
+    // like receive(), but also passes the duplicate filter and all the other steps
+    // datagrams received by the sockets take
+    void deliver(const QByteArray &data, const QHostAddress &sender, uint interfaceIndex)
+    {
+        onDatagramReceived(makeDatagram(data, sender, interfaceIndex));
+    }
+
+private:
+    static QNetworkDatagram makeDatagram(const QByteArray &data, const QHostAddress &sender, uint interfaceIndex)
+    {
+        auto datagram = QNetworkDatagram{data};
+        datagram.setSender(sender, 5353);
+        datagram.setInterfaceIndex(interfaceIndex);
+        return datagram;
+    }
+};
+
+auto addressResponse(quint8 hostIndex, quint8 addressIndex)
+{
+    // an authoritative answer with an A record for "hostN.local"
+    return QByteArray::fromHex("0000 8400 0000 0001 0000 0000"
+                               "05 686f737430 05 6c6f63616c 00"
+                               "0001 8001 00000078 0004 c0a800")
+            .replace(17, 1, QByteArray::number(hostIndex)).append(static_cast<char>(addressIndex));
+}
+
 } // namespace
 
 class ResolverTest : public QObject
@@ -119,6 +252,628 @@ private slots:
         QCOMPARE(intervalChanges, expectedIntervalChanges);
     }
 
+    void receiveBufferSizeProperty()
+    {
+        auto resolver = Resolver{};
+        auto sizeChanges = QSignalSpy{&resolver, &Resolver::receiveBufferSizeChanged};
+        auto expectedSizeChanges = QList<QVariantList>{};
+
+        QCOMPARE(resolver.receiveBufferSize(), 0);
+        QCOMPARE(resolver.droppedDatagrams(), quint64{0});
+        QCOMPARE(resolver.isOverloaded(), false);
+        QCOMPARE(sizeChanges, expectedSizeChanges);
+
+        resolver.setReceiveBufferSize(1 << 20);
+
+        expectedSizeChanges += QVariantList{1 << 20};
+        QCOMPARE(resolver.receiveBufferSize(), 1 << 20);
+        QCOMPARE(sizeChanges, expectedSizeChanges);
+
+        resolver.setReceiveBufferSize(1 << 20);
+
+        QCOMPARE(resolver.receiveBufferSize(), 1 << 20);
+        QCOMPARE(sizeChanges, expectedSizeChanges);
+
+        resolver.setReceiveBufferSize(0);
+
+        expectedSizeChanges += QVariantList{0};
+        QCOMPARE(resolver.receiveBufferSize(), 0);
+        QCOMPARE(sizeChanges, expectedSizeChanges);
+    }
+
+    void receiveBufferReset()
+    {
+        const auto port = unusedPort();
+        QVERIFY(port > 0);
+
+        auto resolver = ListenerTestResolver{port};
+        connect(&resolver, &Resolver::serviceFound, this, [] {});
+        QVERIFY(resolver.lookupServices({"_http._tcp"_L1}));
+
+        if (!QTest::qWaitFor([&resolver] { return !resolver.sockets().isEmpty(); }))
+            QSKIP("Cannot open multicast sockets on the loopback interface");
+
+        const auto defaultSize = receiveBufferSize(resolver.sockets().constBegin().value());
+        QVERIFY(defaultSize > 0);
+
+        resolver.setReceiveBufferSize(defaultSize / 4);
+        QVERIFY(receiveBufferSize(resolver.sockets().constBegin().value()) < defaultSize);
+
+        // the system's default gets restored by reopening the sockets
+        resolver.setReceiveBufferSize(0);
+        QTRY_VERIFY(!resolver.sockets().isEmpty());
+        QCOMPARE(receiveBufferSize(resolver.sockets().constBegin().value()), defaultSize);
+    }
+
+    void droppedDatagrams()
+    {
+#ifndef Q_OS_LINUX
+        QSKIP("Dropped datagrams are only counted on Linux");
+#else
+        // an SRV record for "foo._http._tcp.local"
+        const auto announcement = QByteArray::fromHex("0000 8400 0000 0001 0000 0000"
+                                                      "03 666f6f 05 5f68747470 04 5f746370 05 6c6f63616c 00"
+                                                      "0021 8001 00000078 000d"
+                                                      "0000 0000 0050 04 686f7374 c01b");
+
+        const auto port = unusedPort();
+        QVERIFY(port > 0);
+
+        auto resolver = ListenerTestResolver{port};
+        auto dropChanges = QSignalSpy{&resolver, &Resolver::droppedDatagramsChanged};
+
+        // receiving all messages disables the socket filter, unless overloaded
+        connect(&resolver, &Resolver::messageReceived, this, [] {});
+        connect(&resolver, &Resolver::serviceFound, this, [] {});
+
+        resolver.setPassiveListening(true);
+        QVERIFY(resolver.lookupServices({"_http._tcp"_L1}));
+
+        if (!QTest::qWaitFor([&resolver] { return !resolver.sockets().isEmpty(); }))
+            QSKIP("Cannot open multicast sockets on the loopback interface");
+
+        const auto sockets = resolver.socketsAndListeners();
+
+        if (core::SocketFilter::isSupported()) {
+            for (const auto &socket : sockets)
+                QCOMPARE(socketFilterSize(socket), 0);
+        }
+
+        // the smallest receive buffer the kernel permits only holds a few datagrams
+        resolver.setReceiveBufferSize(1);
+
+        auto sender = QUdpSocket{};
+        QVERIFY(sender.bind(QHostAddress::LocalHost));
+
+        // the resolver cannot read while this loop runs
+        for (auto i = 0; i < 200; ++i)
+            sender.writeDatagram(announcement, QHostAddress{QHostAddress::LocalHost}, port);
+
+        QTRY_VERIFY(resolver.droppedDatagrams() > 0);
+        QVERIFY(!dropChanges.isEmpty());
+
+        // overloaded resolvers filter unsolicited messages, even if all messages are wanted
+        QTRY_VERIFY(resolver.isOverloaded());
+
+        if (core::SocketFilter::isSupported()) {
+            for (const auto &socket : sockets)
+                QVERIFY(socketFilterSize(socket) > 0);
+        }
+#endif // Q_OS_LINUX
+    }
+
+    void decoderThreadCountProperty()
+    {
+        auto resolver = Resolver{};
+        auto countChanges = QSignalSpy{&resolver, &Resolver::decoderThreadCountChanged};
+        auto expectedCountChanges = QList<QVariantList>{};
+
+        QCOMPARE(resolver.decoderThreadCount(), 0);
+        QCOMPARE(countChanges, expectedCountChanges);
+
+        resolver.setDecoderThreadCount(2);
+
+        expectedCountChanges += QVariantList{2};
+        QCOMPARE(resolver.decoderThreadCount(), 2);
+        QCOMPARE(countChanges, expectedCountChanges);
+
+        resolver.setDecoderThreadCount(2);
+
+        QCOMPARE(resolver.decoderThreadCount(), 2);
+        QCOMPARE(countChanges, expectedCountChanges);
+
+        resolver.setDecoderThreadCount(0);
+
+        expectedCountChanges += QVariantList{0};
+        QCOMPARE(resolver.decoderThreadCount(), 0);
+        QCOMPARE(countChanges, expectedCountChanges);
+    }
+
+    void transportProperties()
+    {
+        auto resolver = Resolver{};
+        auto sharedChanges = QSignalSpy{&resolver, &Resolver::sharedTransportChanged};
+        auto passiveChanges = QSignalSpy{&resolver, &Resolver::passiveListeningChanged};
+        auto expectedSharedChanges = QList<QVariantList>{};
+        auto expectedPassiveChanges = QList<QVariantList>{};
+
+        QCOMPARE(resolver.isSharedTransport(), false);
+        QCOMPARE(resolver.isPassiveListening(), false);
+
+        resolver.setSharedTransport(true);
+        resolver.setSharedTransport(true);
+        resolver.setPassiveListening(true);
+        resolver.setPassiveListening(true);
+
+        expectedSharedChanges += QVariantList{true};
+        expectedPassiveChanges += QVariantList{true};
+
+        QCOMPARE(resolver.isSharedTransport(), true);
+        QCOMPARE(resolver.isPassiveListening(), true);
+        QCOMPARE(sharedChanges, expectedSharedChanges);
+        QCOMPARE(passiveChanges, expectedPassiveChanges);
+
+        resolver.setPassiveListening(false);
+
+        expectedPassiveChanges += QVariantList{false};
+        QCOMPARE(resolver.isPassiveListening(), false);
+        QCOMPARE(passiveChanges, expectedPassiveChanges);
+    }
+
+    void passiveListening()
+    {
+        // an SRV record for "foo._http._tcp.local" on port 80
+        const auto announcement = QByteArray::fromHex("0000 8400 0000 0001 0000 0000"
+                                                      "03 666f6f 05 5f68747470 04 5f746370 05 6c6f63616c 00"
+                                                      "0021 8001 00000078 000d"
+                                                      "0000 0000 0050 04 686f7374 c01b");
+
+        const auto port = unusedPort();
+        QVERIFY(port > 0);
+
+        auto resolver = ListenerTestResolver{port};
+        auto services = QList<ServiceDescription>{};
+
+        // receiving all messages disables the socket filter, that only accepts messages from the resolver's port
+        connect(&resolver, &Resolver::messageReceived, this, [] {});
+        connect(&resolver, &Resolver::serviceFound, this, [&services](const ServiceDescription &service) {
+            services += service;
+        });
+
+        resolver.setPassiveListening(true);
+        QVERIFY(resolver.lookupServices({"_http._tcp"_L1}));
+
+        if (!QTest::qWaitFor([&resolver] { return !resolver.sockets().isEmpty(); }))
+            QSKIP("Cannot open multicast sockets on the loopback interface");
+
+        QCOMPARE(resolver.socketsAndListeners().size(), 2 * resolver.sockets().size());
+
+        // only the listener is bound to the resolver's port
+        auto sender = QUdpSocket{};
+        QVERIFY(sender.bind(QHostAddress::LocalHost));
+        QCOMPARE(sender.writeDatagram(announcement, QHostAddress{QHostAddress::LocalHost}, port),
+                 static_cast<qint64>(announcement.size()));
+
+        QTRY_COMPARE(services.size(), 1);
+        QCOMPARE(services[0].port(), 80);
+    }
+
+    void listenerOptions()
+    {
+        const auto port = unusedPort();
+        QVERIFY(port > 0);
+
+        auto resolver = ListenerTestResolver{port};
+        connect(&resolver, &Resolver::serviceFound, this, [] {});
+
+        resolver.setPassiveListening(true);
+        QVERIFY(resolver.lookupServices({"_http._tcp"_L1}));
+
+        if (!QTest::qWaitFor([&resolver] { return !resolver.sockets().isEmpty(); }))
+            QSKIP("Cannot open multicast sockets on the loopback interface");
+
+        const auto sockets = resolver.socketsAndListeners();
+        QCOMPARE(sockets.size(), 2 * resolver.sockets().size());
+
+        // options changed after opening the sockets also reach the listeners
+        const auto defaultSize = receiveBufferSize(sockets.constFirst());
+        QVERIFY(defaultSize > 0);
+
+        resolver.setReceiveBufferSize(defaultSize / 4);
+
+        for (const auto &socket : sockets)
+            QVERIFY(receiveBufferSize(socket) < defaultSize);
+
+#ifdef Q_OS_LINUX
+        if (core::SocketFilter::isSupported()) {
+            for (const auto &socket : sockets)
+                QVERIFY(socketFilterSize(socket) > 0);
+
+            // receiving all messages detaches the filter from all sockets
+            connect(&resolver, &Resolver::messageReceived, this, [] {});
+
+            for (const auto &socket : sockets)
+                QTRY_COMPARE(socketFilterSize(socket), 0);
+        }
+#endif // Q_OS_LINUX
+    }
+
+    void batchProperties()
+    {
+        auto resolver = Resolver{};
+        auto intervalChanges = QSignalSpy{&resolver, &Resolver::batchIntervalChanged};
+        auto sizeChanges = QSignalSpy{&resolver, &Resolver::batchSizeChanged};
+        auto expectedIntervalChanges = QList<QVariantList>{};
+        auto expectedSizeChanges = QList<QVariantList>{};
+
+        QCOMPARE(resolver.batchInterval(), 0);
+        QCOMPARE(resolver.batchSize(), 100);
+
+        resolver.setBatchInterval(250);
+        resolver.setBatchInterval(250);
+        resolver.setBatchSize(10);
+        resolver.setBatchSize(10);
+
+        expectedIntervalChanges += QVariantList{250};
+        expectedSizeChanges += QVariantList{10};
+
+        QCOMPARE(resolver.batchInterval(), 250);
+        QCOMPARE(resolver.batchSize(), 10);
+        QCOMPARE(intervalChanges, expectedIntervalChanges);
+        QCOMPARE(sizeChanges, expectedSizeChanges);
+    }
+
+    void queryRateProperties()
+    {
+        auto resolver = Resolver{};
+        auto rateChanges = QSignalSpy{&resolver, &Resolver::queryRateChanged};
+        auto totalRateChanges = QSignalSpy{&resolver, &Resolver::totalQueryRateChanged};
+        auto expectedRateChanges = QList<QVariantList>{};
+        auto expectedTotalRateChanges = QList<QVariantList>{};
+
+        QCOMPARE(resolver.queryRate(), 0);
+        QCOMPARE(resolver.totalQueryRate(), 0);
+
+        resolver.setQueryRate(5);
+        resolver.setQueryRate(5);
+        resolver.setTotalQueryRate(20);
+        resolver.setTotalQueryRate(20);
+        resolver.setQueryRate(-1);
+
+        expectedRateChanges += QVariantList{5};
+        expectedRateChanges += QVariantList{0};
+        expectedTotalRateChanges += QVariantList{20};
+
+        QCOMPARE(resolver.queryRate(), 0);
+        QCOMPARE(resolver.totalQueryRate(), 20);
+        QCOMPARE(rateChanges, expectedRateChanges);
+        QCOMPARE(totalRateChanges, expectedTotalRateChanges);
+    }
+
+    void queryPacing()
+    {
+        const auto port = unusedPort();
+        QVERIFY(port > 0);
+
+        const auto &interfaces = QNetworkInterface::allInterfaces();
+        const auto loopback = std::find_if(interfaces.cbegin(), interfaces.cend(), [](const auto &iface) {
+            return iface.flags().testFlag(QNetworkInterface::IsLoopBack);
+        });
+
+        if (loopback == interfaces.cend())
+            QSKIP("There is no loopback interface");
+
+        auto receiver = QUdpSocket{};
+        QVERIFY(receiver.bind(QHostAddress::AnyIPv4, port, QUdpSocket::ShareAddress | QUdpSocket::ReuseAddressHint));
+
+        if (!receiver.joinMulticastGroup(QHostAddress{"224.0.0.251"_L1}, *loopback))
+            QSKIP("Cannot join multicast groups on the loopback interface");
+
+        auto timer = QElapsedTimer{};
+        auto received = QList<std::pair<QByteArray, qint64>>{};
+
+        timer.start();
+
+        connect(&receiver, &QUdpSocket::readyRead, this, [&receiver, &received, &timer] {
+            while (receiver.hasPendingDatagrams())
+                received.append({receiver.receiveDatagram().data(), timer.elapsed()});
+        });
+
+        const auto typeOf = [](const QByteArray &query) {
+            for (const auto type : {"alpha", "beta", "gamma", "delta", "echo"}) {
+                if (query.contains(type))
+                    return QByteArray{type};
+            }
+
+            return QByteArray{};
+        };
+
+        // a burst of two queries, and then one query every 500 ms
+        auto resolver = ListenerTestResolver{port};
+        resolver.setQueryRate(2);
+        connect(&resolver, &Resolver::serviceFound, this, [] {});
+
+        for (const auto &type : {"_alpha._tcp"_L1, "_beta._tcp"_L1, "_gamma._tcp"_L1, "_delta._tcp"_L1})
+            QVERIFY(resolver.lookupServices({type}));
+
+        if (!QTest::qWaitFor([&resolver] { return !resolver.sockets().isEmpty(); }))
+            QSKIP("Cannot open multicast sockets on the loopback interface");
+
+        // queries added while scanning go before the repeated queries still waiting
+        QVERIFY(resolver.lookupServices({"_echo._tcp"_L1}));
+        QTRY_COMPARE_WITH_TIMEOUT(received.size(), 5, 5000);
+
+        auto types = QByteArrayList{};
+        for (const auto &datagram : std::as_const(received))
+            types += typeOf(datagram.first);
+
+        QCOMPARE(types, (QByteArrayList{"alpha", "beta", "echo", "gamma", "delta"}));
+
+        // the burst is sent at once, the other queries wait for the token bucket
+        QVERIFY(received[1].second - received[0].second < 250);
+
+        for (auto i = 3; i < received.size(); ++i)
+            QVERIFY2(received[i].second - received[i - 1].second >= 400,
+                     qPrintable(QString::number(received[i].second - received[i - 1].second)));
+    }
+
+    void interests()
+    {
+        auto resolver = Resolver{};
+        QCOMPARE(resolver.interests(), Resolver::Interests{});
+
+        const auto hostNames = connect(&resolver, &Resolver::hostNameFound, this, [] {});
+        QCOMPARE(resolver.interests(), Resolver::Interests{Resolver::HostNames});
+
+        const auto services = connect(&resolver, &Resolver::servicesFound, this, [] {});
+        QCOMPARE(resolver.interests(), Resolver::HostNames | Resolver::Services);
+
+        const auto messages = connect(&resolver, &Resolver::messageReceived, this, [] {});
+        QCOMPARE(resolver.interests(), Resolver::HostNames | Resolver::Services | Resolver::Messages);
+
+        disconnect(hostNames);
+        disconnect(messages);
+        QTRY_COMPARE(resolver.interests(), Resolver::Interests{Resolver::Services});
+
+        disconnect(services);
+        QTRY_COMPARE(resolver.interests(), Resolver::Interests{});
+    }
+
+    void interestsMetaType()
+    {
+        const auto metaEnum = QMetaEnum::fromType<Resolver::Interests>();
+
+        QVERIFY(metaEnum.isValid());
+        QVERIFY(metaEnum.isFlag());
+        QCOMPARE(metaEnum.name(), "Interests");
+        QCOMPARE(metaEnum.valueToKeys(static_cast<int>(Resolver::HostNames | Resolver::Messages)), "HostNames|Messages"_ba);
+    }
+
+    void demandAwareScanning()
+    {
+        auto resolver = ScanningTestResolver{};
+        QVERIFY(!resolver.isScanningNeeded());
+
+        // scanning is pointless without any query
+        const auto hostNames = connect(&resolver, &Resolver::hostNameFound, this, [] {});
+        QVERIFY(!resolver.isScanningNeeded());
+
+        QVERIFY(resolver.lookupHostNames({"alpha"_L1}));
+        QVERIFY(resolver.isScanningNeeded());
+
+        // ...and also if nobody listens for results
+        disconnect(hostNames);
+        QTRY_VERIFY(!resolver.isScanningNeeded());
+
+        const auto identities = connect(&resolver, &Resolver::serviceIdentityChanged, this, [] {});
+        QVERIFY(resolver.isScanningNeeded());
+
+        disconnect(identities);
+        QTRY_VERIFY(!resolver.isScanningNeeded());
+    }
+
+    void batchedSignals()
+    {
+        auto resolver = DecoderTestResolver{};
+        auto hostNameCount = 0;
+        auto batches = QList<HostNameTable>{};
+
+        connect(&resolver, &Resolver::hostNameFound, this, [&hostNameCount] { ++hostNameCount; });
+        connect(&resolver, &Resolver::hostNamesFound, this, [&batches](const HostNameTable &hostNames) {
+            batches += hostNames;
+        });
+
+        resolver.receive(addressResponse(1, 1));
+        resolver.receive(addressResponse(1, 2));
+        resolver.receive(addressResponse(1, 2));
+        resolver.receive(addressResponse(2, 3));
+
+        QCOMPARE(hostNameCount, 4);
+        QCOMPARE(batches.size(), 0);
+
+        QTRY_COMPARE(batches.size(), 1);
+
+        const auto expectedBatch = HostNameTable{
+            {"host1"_L1, {QHostAddress{0xc0a80001U}, QHostAddress{0xc0a80002U}}},
+            {"host2"_L1, {QHostAddress{0xc0a80003U}}},
+        };
+
+        QCOMPARE(batches.constFirst(), expectedBatch);
+
+        // full batches get delivered immediately
+        resolver.setBatchSize(2);
+        resolver.receive(addressResponse(3, 4));
+        resolver.receive(addressResponse(4, 5));
+
+        QCOMPARE(batches.size(), 2);
+        QCOMPARE(batches.constLast().size(), 2);
+    }
+
+    void serviceIdentities()
+    {
+        // an SRV record for "foo._http._tcp.local", first announcing the service, then saying goodbye
+        const auto announcement = QByteArray::fromHex("0000 8400 0000 0001 0000 0000"
+                                                      "03 666f6f 05 5f68747470 04 5f746370 05 6c6f63616c 00"
+                                                      "0021 8001 00000078 000d"
+                                                      "0000 0000 0050 04 686f7374 c01b");
+        const auto goodbye = QByteArray{announcement}.replace(38, 4, QByteArray{4, '\0'});
+
+        auto resolver = DecoderTestResolver{};
+        auto changedIdentities = QList<core::ServiceIdentity>{};
+        auto lostIdentities = QStringList{};
+
+        connect(&resolver, &Resolver::serviceIdentityChanged, this,
+                [&changedIdentities](const core::ServiceIdentity &identity) {
+            changedIdentities += identity;
+        });
+
+        connect(&resolver, &Resolver::serviceIdentityLost, this, [&lostIdentities](const QString &name) {
+            lostIdentities += name;
+        });
+
+        const auto ipv4Sender = QHostAddress{0xc0a80001U};
+        const auto ipv6Sender = QHostAddress{"fe80::1"_L1};
+
+        auto foundCount = 0;
+        connect(&resolver, &Resolver::serviceFound, this, [&foundCount] { ++foundCount; });
+
+        // copies via the other address family pass the duplicate filter, copies via
+        // another interface only add that interface to the identity of the sender
+        QCOMPARE(resolver.duplicateWindow(), 500);
+
+        resolver.deliver(announcement, ipv4Sender, 1);
+        resolver.deliver(announcement, ipv4Sender, 1);
+        resolver.deliver(announcement, ipv6Sender, 1);
+        resolver.deliver(announcement, ipv4Sender, 2);
+        resolver.deliver(announcement, ipv4Sender, 2);
+
+        QCOMPARE(foundCount, 2);
+        QCOMPARE(changedIdentities.size(), 3);
+        QCOMPARE(resolver.serviceIdentities().size(), 1);
+
+        const auto identity = resolver.serviceIdentities().constFirst();
+        QCOMPARE(identity.name(), "foo._http._tcp"_L1);
+        QCOMPARE(identity.interfaces(), (QList<int>{1, 2}));
+        QCOMPARE(identity.addresses(), (QList<QHostAddress>{ipv4Sender, ipv6Sender}));
+        QVERIFY(identity.expiry() > QDateTime::currentDateTimeUtc().addSecs(100));
+
+        resolver.deliver(goodbye, ipv6Sender, 2);
+
+        QCOMPARE(lostIdentities, QStringList{"foo._http._tcp"_L1});
+        QVERIFY(resolver.serviceIdentities().isEmpty());
+    }
+
+    void cacheLifetime()
+    {
+        // an SRV record for "foo._http._tcp.local" with a time to life of 120 seconds, and its goodbye
+        const auto announcement = QByteArray::fromHex("0000 8400 0000 0001 0000 0000"
+                                                      "03 666f6f 05 5f68747470 04 5f746370 05 6c6f63616c 00"
+                                                      "0021 8001 00000078 000d"
+                                                      "0000 0000 0050 04 686f7374 c01b");
+        const auto goodbye = QByteArray{announcement}.replace(38, 4, QByteArray{4, '\0'});
+
+        const auto dir = QTemporaryDir{};
+        const auto fileName = dir.filePath("cache"_L1);
+        const auto sender = QHostAddress{0xc0a80001U};
+
+        {
+            auto resolver = DecoderTestResolver{};
+            connect(&resolver, &Resolver::serviceFound, this, [] {});
+            resolver.setCacheFileName(fileName);
+
+            resolver.deliver(announcement, sender, 1);
+
+            // datagrams get cached for the time to life of their records
+            const auto now = QDateTime::currentDateTimeUtc();
+            const auto entries = core::WarmCache{fileName}.load(now);
+
+            QCOMPARE(entries.size(), 1);
+            QCOMPARE(entries[0].datagram.data(), announcement);
+            QCOMPARE(entries[0].keys, QStringList{"foo._http._tcp"_L1});
+            QVERIFY(entries[0].expiry > now.addSecs(100));
+            QVERIFY(entries[0].expiry <= now.addSecs(120));
+
+            // goodbyes don't get cached, but suppress the cached announcement
+            resolver.deliver(goodbye, sender, 1);
+        }
+
+        QVERIFY(core::WarmCache{fileName}.load().isEmpty());
+    }
+
+    void cacheReplay()
+    {
+        // an SRV record for "foo._http._tcp.local" with a time to life of 120 seconds
+        const auto announcement = QByteArray::fromHex("0000 8400 0000 0001 0000 0000"
+                                                      "03 666f6f 05 5f68747470 04 5f746370 05 6c6f63616c 00"
+                                                      "0021 8001 00000078 000d"
+                                                      "0000 0000 0050 04 686f7374 c01b");
+
+        const auto dir = QTemporaryDir{};
+        const auto fileName = dir.filePath("cache"_L1);
+        const auto received = QDateTime::currentDateTimeUtc().addSecs(-100);
+
+        {
+            auto datagram = QNetworkDatagram{announcement};
+            datagram.setSender(QHostAddress{0xc0a80001U}, 5353);
+
+            auto cache = core::WarmCache{fileName};
+            QVERIFY(cache.store(datagram, received.addSecs(120), {"foo._http._tcp"_L1}, received));
+        }
+
+        auto resolver = DecoderTestResolver{};
+        auto services = QList<ServiceDescription>{};
+
+        connect(&resolver, &Resolver::serviceFound, this, [&services](const ServiceDescription &service) {
+            services += service;
+        });
+
+        resolver.setCacheFileName(fileName);
+
+        // replayed records keep the time to life they had when they were received
+        QTRY_COMPARE(services.size(), 1);
+        QCOMPARE(services[0].expires(), received.addSecs(120));
+        QVERIFY(resolver.isStaleService("foo._http._tcp"_L1));
+    }
+
+    void engineProperty()
+    {
+        auto resolver = Resolver{};
+        auto engineChanges = QSignalSpy{&resolver, &Resolver::engineChanged};
+        auto expectedEngineChanges = QList<QVariantList>{};
+
+        QVERIFY(Resolver::isSupportedEngine(Resolver::Engine::Qt));
+
+        QCOMPARE(resolver.engine(), Resolver::Engine::Qt);
+        QCOMPARE(engineChanges, expectedEngineChanges);
+
+        resolver.setEngine(Resolver::Engine::Qt);
+
+        QCOMPARE(resolver.engine(), Resolver::Engine::Qt);
+        QCOMPARE(engineChanges, expectedEngineChanges);
+
+        if (!Resolver::isSupportedEngine(Resolver::Engine::IoUring)) {
+            QTest::ignoreMessage(QtWarningMsg, "Unsupported datagram engine: IoUring");
+            resolver.setEngine(Resolver::Engine::IoUring);
+
+            QCOMPARE(resolver.engine(), Resolver::Engine::Qt);
+            QCOMPARE(engineChanges, expectedEngineChanges);
+
+            QSKIP("The io_uring engine is not supported on this system");
+        }
+
+        resolver.setEngine(Resolver::Engine::IoUring);
+
+        expectedEngineChanges += QVariantList{QVariant::fromValue(Resolver::Engine::IoUring)};
+        QCOMPARE(resolver.engine(), Resolver::Engine::IoUring);
+        QCOMPARE(engineChanges, expectedEngineChanges);
+
+        resolver.setEngine(Resolver::Engine::Qt);
+
+        expectedEngineChanges += QVariantList{QVariant::fromValue(Resolver::Engine::Qt)};
+        QCOMPARE(resolver.engine(), Resolver::Engine::Qt);
+        QCOMPARE(engineChanges, expectedEngineChanges);
+    }
+
     void lookupHostNames()
     {
         auto resolver = Resolver{};
@@ -155,6 +910,57 @@ private slots:
         QVERIFY(!resolver.lookupServices({"_ipp._tcp.local."_L1}));
     }
 
+    void socketFilter()
+    {
+        if (!core::SocketFilter::isSupported())
+            QSKIP("Socket filters are not supported on this platform");
+
+        auto receiver  = QUdpSocket{};
+        auto responder = QUdpSocket{};
+        auto stranger  = QUdpSocket{};
+
+        QVERIFY(receiver .bind(QHostAddress::LocalHost));
+        QVERIFY(responder.bind(QHostAddress::LocalHost));
+        QVERIFY(stranger .bind(QHostAddress::LocalHost));
+
+        auto resolver = FilterTestResolver{responder.localPort()};
+
+        QVERIFY(resolver.lookupHostNames({"alpha"_L1}));
+        QVERIFY(resolver.lookupServices({"_http._tcp"_L1}));
+        QVERIFY(resolver.socketFilter().attach(receiver.socketDescriptor()));
+
+        const auto query           = "0000|0000|0001|0000|0000|0000"
+                                     "05<61 6c 70 68 61>05<6c 6f 63 61 6c>00|0001|0001"_hex;
+        const auto hostResponse    = "0000|8400|0000|0001|0000|0000"
+                                     "05<61 6c 70 68 61>05<6c 6f 63 61 6c>00"
+                                     "0001|0001|00000078|0004|c0a80001"_hex;
+        const auto foreignResponse = "0000|8400|0000|0001|0000|0000"
+                                     "05<67 61 6d 6d 61>05<6c 6f 63 61 6c>00"
+                                     "0001|0001|00000078|0004|c0a80002"_hex;
+        const auto serviceResponse = "0000|8400|0000|0001|0000|0000"
+                                     "06<66 72 69 64 67 65>05<5f 68 74 74 70>04<5f 74 63 70>05<6c 6f 63 61 6c>00"
+                                     "0010|0001|00001194|0001|00"_hex;
+
+        const auto send = [&receiver](QUdpSocket &sender, const QByteArray &data) {
+            return sender.writeDatagram(data, receiver.localAddress(), receiver.localPort()) == data.size();
+        };
+
+        QVERIFY(send(responder, query));
+        QVERIFY(send(stranger,  hostResponse));
+        QVERIFY(send(responder, foreignResponse));
+        QVERIFY(send(responder, hostResponse));
+        QVERIFY(send(responder, serviceResponse));
+
+        auto received = QByteArrayList{};
+
+        while (received.size() < 2 && receiver.waitForReadyRead(1000)) {
+            while (receiver.hasPendingDatagrams())
+                received += receiver.receiveDatagram().data();
+        }
+
+        QCOMPARE(received, (QByteArrayList{hostResponse, serviceResponse}));
+    }
+
     void serviceLocations_data()
     {
         QTest::addColumn<ServiceDescription>("service");
@@ -5,14 +5,79 @@
 // QtNetworkCrumbs headers
 #include "ssdpresolver.h"
 #include "literals.h"
+#include "warmcache.h"
 
 // Qt headers
+#include <QNetworkDatagram>
+#include <QTemporaryDir>
 #include <QTest>
 
+// STL headers
+#include <algorithm>
+
 Q_DECLARE_METATYPE(qnc::ssdp::NotifyMessage)
 
 namespace qnc::ssdp::tests {
 
+using namespace std::chrono_literals;
+
+namespace {
+
+class TestResolver : public Resolver
+{
+public:
+    using Resolver::expectedResponders;
+    using Resolver::finalizeQuery;
+    using Resolver::hasSubscribers;
+    using Resolver::internedServiceTypes;
+    using Resolver::queries;
+    using Resolver::queryJitter;
+    using Resolver::submitQueries;
+    using Resolver::takeRefreshTargets;
+    using Resolver::unicastQuery;
+
+    void receive(const QByteArray &data, const QHostAddress &sender)
+    {
+        auto datagram = QNetworkDatagram{data};
+        datagram.setSender(sender, 1900);
+
+        if (const auto apply = datagramDecoder()(datagram))
+            apply();
+    }
+};
+
+auto notifyMessage(const QByteArray &type, const QByteArray &location, int maxAge = 1800)
+{
+    return "NOTIFY * HTTP/1.1\r\n"
+           "NT: urn:schemas-upnp-org:device:MediaServer:1\r\n"
+           "NTS: ssdp:"_ba + type + "\r\n"
+           "USN: uuid:device-1::urn:schemas-upnp-org:device:MediaServer:1\r\n"
+           "Location: "_ba + location + "\r\n"
+           "Cache-Control: max-age="_ba + QByteArray::number(maxAge) + "\r\n"
+           "\r\n"_ba;
+}
+
+auto searchResponse(int index)
+{
+    return "HTTP/1.1 200 OK\r\n"
+           "Cache-Control: max-age=1800\r\n"
+           "ST: urn:schemas-upnp-org:device:MediaServer:1\r\n"
+           "USN: uuid:device-"_ba + QByteArray::number(index) + "\r\n"
+           "Location: http://192.168.1.1/description.xml\r\n"
+           "\r\n"_ba;
+}
+
+auto searchResponse(const QByteArray &serviceName, const QByteArray &location)
+{
+    return "HTTP/1.1 200 OK\r\n"
+           "Cache-Control: max-age=1800\r\n"
+           "USN: "_ba + serviceName + "\r\n"
+           "Location: "_ba + location + "\r\n"
+           "\r\n"_ba;
+}
+
+} // namespace
+
 class ResolverTest : public QObject
 {
     Q_OBJECT
@@ -66,6 +131,81 @@ private slots:
                    NotifyMessage::Type::ByeBye,
                    "someunique:idscheme3"_L1,
                    "blenderassociation:blender"_L1};
+
+        QTest::newRow("response")
+                << now
+                << "HTTP/1.1 200 OK\r\n"
+                   "cache-control: max-age=1800\r\n"
+                   "EXT:\r\n"
+                   "location: http://192.168.123.45:7890/dd.xml\r\n"
+                   "SERVER: Linux/6.1 UPnP/1.0 Blender/1.0\r\n"
+                   "ST: blenderassociation:blender\r\n"
+                   "usn: someunique:idscheme3\r\n"
+                   "\r\n"_ba
+                << NotifyMessage{
+                   NotifyMessage::Type::Alive,
+                   "someunique:idscheme3"_L1,
+                   {},
+                   {"http://192.168.123.45:7890/dd.xml"_url},
+                   {},
+                   now.addSecs(1800)};
+
+        QTest::newRow("upnp-1.1")
+                << now
+                << "NOTIFY * HTTP/1.1\r\n"
+                   "NT: upnp:rootdevice\r\n"
+                   "NTS: ssdp:alive\r\n"
+                   "USN: uuid:device-1::upnp:rootdevice\r\n"
+                   "BOOTID.UPNP.ORG: 7\r\n"
+                   "CONFIGID.UPNP.ORG: 42\r\n"
+                   "SEARCHPORT.UPNP.ORG: 49152\r\n"
+                   "\r\n"_ba
+                << NotifyMessage{
+                   NotifyMessage::Type::Alive,
+                   "uuid:device-1::upnp:rootdevice"_L1,
+                   "upnp:rootdevice"_L1,
+                   {}, {}, {}, 7, 42, -1, 49152};
+
+        QTest::newRow("update")
+                << now
+                << "NOTIFY * HTTP/1.1\r\n"
+                   "NT: upnp:rootdevice\r\n"
+                   "NTS: ssdp:update\r\n"
+                   "USN: uuid:device-1::upnp:rootdevice\r\n"
+                   "BootId.UPnP.Org: 7\r\n"
+                   "NextBootId.UPnP.Org: 8\r\n"
+                   "ConfigId.UPnP.Org: invalid\r\n"
+                   "\r\n"_ba
+                << NotifyMessage{
+                   NotifyMessage::Type::Update,
+                   "uuid:device-1::upnp:rootdevice"_L1,
+                   "upnp:rootdevice"_L1,
+                   {}, {}, {}, 7, -1, 8, 0};
+
+        QTest::newRow("continued-header")
+                << now
+                << "NOTIFY * HTTP/1.1\r\n"
+                   "NTS: ssdp:byebye\r\n"
+                   "USN: someunique:\r\n"
+                   " idscheme3\r\n"
+                   "\r\n"_ba
+                << NotifyMessage{
+                   NotifyMessage::Type::ByeBye,
+                   "someunique:idscheme3"_L1};
+
+        QTest::newRow("search")
+                << now
+                << "M-SEARCH * HTTP/1.1\r\n"
+                   "ST: ssdp:all\r\n"
+                   "\r\n"_ba
+                << NotifyMessage{};
+
+        QTest::newRow("not-found")
+                << now
+                << "HTTP/1.1 404 Not Found\r\n"
+                   "USN: someunique:idscheme3\r\n"
+                   "\r\n"_ba
+                << NotifyMessage{};
     }
 
     void testParseNotifyMessage()
@@ -82,6 +222,466 @@ private slots:
         QCOMPARE(message.locations,     expectedMessage.locations);
         QCOMPARE(message.altLocations,  expectedMessage.altLocations);
         QCOMPARE(message.expiry,        expectedMessage.expiry);
+        QCOMPARE(message.bootId,        expectedMessage.bootId);
+        QCOMPARE(message.configId,      expectedMessage.configId);
+        QCOMPARE(message.nextBootId,    expectedMessage.nextBootId);
+        QCOMPARE(message.searchPort,    expectedMessage.searchPort);
+    }
+
+    void finalizedQueries()
+    {
+        auto resolver = TestResolver{};
+        QVERIFY(resolver.lookupService("upnp:rootdevice"_L1));
+
+        const auto query = resolver.queries().constFirst();
+        QVERIFY(query.contains("\r\nST: upnp:rootdevice\r\n"));
+        QVERIFY(query.contains("{multicast-group}"));
+
+        const auto ipv4 = resolver.finalizeQuery(QHostAddress{"192.168.1.2"_L1}, query);
+        const auto ipv6 = resolver.finalizeQuery(QHostAddress{"fe80::1"_L1}, query);
+
+        QVERIFY(ipv4.contains("\r\nHOST: 239.255.255.250:1900\r\n"));
+        QVERIFY(ipv6.contains("\r\nHOST: [ff02::c]:1900\r\n"));
+
+        // finalized queries get reused until MX changes
+        QCOMPARE(resolver.finalizeQuery(QHostAddress{"10.0.0.1"_L1}, query).constData(), ipv4.constData());
+        QCOMPARE(resolver.finalizeQuery(QHostAddress{"fe80::2"_L1}, query).constData(), ipv6.constData());
+    }
+
+    void serviceCache()
+    {
+        const auto sender = QHostAddress{"192.168.1.1"_L1};
+        auto resolver = TestResolver{};
+        auto found = QStringList{};
+        auto lost = QStringList{};
+
+        connect(&resolver, &Resolver::serviceFound, this, [&found](const ServiceDescription &service) {
+            found += service.locations().constFirst().toString();
+        });
+
+        connect(&resolver, &Resolver::serviceLost, this, [&lost](const QString &name) {
+            lost += name;
+        });
+
+        resolver.receive(notifyMessage("alive", "http://192.168.1.1/a.xml"), sender);
+        QCOMPARE(found, QStringList{"http://192.168.1.1/a.xml"_L1});
+        QCOMPARE(resolver.services().size(), 1);
+
+        // repeated announcements only refresh the expiry
+        const auto expiry = resolver.services().constFirst().expires();
+        QTest::qWait(1100);
+
+        resolver.receive(notifyMessage("alive", "http://192.168.1.1/a.xml"), sender);
+        QCOMPARE(found.size(), 1);
+        QVERIFY(resolver.services().constFirst().expires() > expiry);
+
+        // changes get reported
+        resolver.receive(notifyMessage("alive", "http://192.168.1.1/b.xml"), sender);
+        QCOMPARE(found, (QStringList{"http://192.168.1.1/a.xml"_L1, "http://192.168.1.1/b.xml"_L1}));
+
+        // goodbyes only get reported once
+        resolver.receive(notifyMessage("byebye", "http://192.168.1.1/b.xml"), sender);
+        resolver.receive(notifyMessage("byebye", "http://192.168.1.1/b.xml"), sender);
+        QCOMPARE(lost, QStringList{"uuid:device-1::urn:schemas-upnp-org:device:MediaServer:1"_L1});
+        QVERIFY(resolver.services().isEmpty());
+
+        // services that stop announcing themselves are lost once they expire
+        resolver.receive(notifyMessage("alive", "http://192.168.1.1/c.xml", 1), sender);
+        QCOMPARE(found.size(), 3);
+        QCOMPARE(lost.size(), 1);
+        QTRY_COMPARE_WITH_TIMEOUT(lost.size(), 2, 3000);
+        QVERIFY(resolver.services().isEmpty());
+    }
+
+    void batchedServices()
+    {
+        const auto sender = QHostAddress{"192.168.1.1"_L1};
+        const auto name = "uuid:device-1::urn:schemas-upnp-org:device:MediaServer:1"_L1;
+
+        auto finder = TestResolver{};
+        auto foundBatches = QList<QList<ServiceDescription>>{};
+
+        finder.setBatchInterval(50);
+        connect(&finder, &Resolver::servicesFound, this, [&foundBatches](const QList<ServiceDescription> &services) {
+            foundBatches += services;
+        });
+
+        // changes within a batch replace the pending service
+        finder.receive(notifyMessage("alive", "http://192.168.1.1/a.xml"), sender);
+        finder.receive(notifyMessage("alive", "http://192.168.1.1/b.xml"), sender);
+
+        QTRY_COMPARE(foundBatches.size(), 1);
+        QCOMPARE(foundBatches[0].size(), 1);
+        QCOMPARE(foundBatches[0][0].locations(), (QList<QUrl>{QUrl{"http://192.168.1.1/a.xml"_L1},
+                                                              QUrl{"http://192.168.1.1/b.xml"_L1}}));
+
+        // services lost within the batch are not reported, even without listening for lost ones
+        finder.receive(notifyMessage("alive", "http://192.168.1.1/c.xml"), sender);
+        finder.receive(notifyMessage("byebye", "http://192.168.1.1/c.xml"), sender);
+
+        QTest::qWait(200);
+        QCOMPARE(foundBatches.size(), 1);
+
+        // services found again within the batch are not reported, even without listening for found ones
+        auto loser = TestResolver{};
+        auto lostBatches = QList<QStringList>{};
+
+        loser.setBatchInterval(50);
+        connect(&loser, &Resolver::servicesLost, this, [&lostBatches](const QStringList &names) {
+            lostBatches += names;
+        });
+
+        loser.receive(notifyMessage("alive", "http://192.168.1.1/a.xml"), sender);
+        loser.receive(notifyMessage("byebye", "http://192.168.1.1/a.xml"), sender);
+        loser.receive(notifyMessage("alive", "http://192.168.1.1/a.xml"), sender);
+
+        QTest::qWait(200);
+        QVERIFY(lostBatches.isEmpty());
+
+        loser.receive(notifyMessage("byebye", "http://192.168.1.1/a.xml"), sender);
+        QTRY_COMPARE(lostBatches, QList<QStringList>{QStringList{name}});
+    }
+
+    void deviceAggregation()
+    {
+        const auto sender = QHostAddress{"192.168.1.1"_L1};
+        auto resolver = TestResolver{};
+
+        resolver.receive(searchResponse("uuid:device-1", "http://192.168.1.1/a.xml"), sender);
+        resolver.receive(searchResponse("uuid:device-1::upnp:rootdevice", "http://192.168.1.1/a.xml"), sender);
+        resolver.receive(searchResponse("uuid:device-1::urn:schemas-upnp-org:service:ContentDirectory:1",
+                                        "http://192.168.1.1/a.xml"), sender);
+        resolver.receive(searchResponse("uuid:device-2::upnp:rootdevice", "http://192.168.1.2/b.xml"), sender);
+
+        QCOMPARE(resolver.services().size(), 4);
+
+        auto devices = resolver.devices();
+        std::sort(devices.begin(), devices.end(), [](const auto &lhs, const auto &rhs) {
+            return lhs.id() < rhs.id();
+        });
+
+        QCOMPARE(devices.size(), 2);
+        QCOMPARE(devices[0].id(), "uuid:device-1"_L1);
+        QCOMPARE(devices[1].id(), "uuid:device-2"_L1);
+        QCOMPARE(devices[1].serviceTypes(), QStringList{"upnp:rootdevice"_L1});
+        QCOMPARE(devices[1].locations(), QList<QUrl>{QUrl{"http://192.168.1.2/b.xml"_L1}});
+
+        auto serviceTypes = devices[0].serviceTypes();
+        serviceTypes.sort();
+
+        // responses to M-SEARCH report the type found within the unique service name
+        QCOMPARE(serviceTypes, (QStringList{"upnp:rootdevice"_L1,
+                                            "urn:schemas-upnp-org:service:ContentDirectory:1"_L1}));
+
+        // the services of a device share its location list
+        for (const auto &service : resolver.services()) {
+            if (service.deviceId() == devices[0].id())
+                QCOMPARE(service.locations().constData(), devices[0].locations().constData());
+        }
+
+        // devices vanish with their last service
+        resolver.receive("NOTIFY * HTTP/1.1\r\n"
+                         "NTS: ssdp:byebye\r\n"
+                         "USN: uuid:device-2::upnp:rootdevice\r\n"
+                         "\r\n"_ba, sender);
+
+        QCOMPARE(resolver.devices().size(), 1);
+        QCOMPARE(resolver.devices().constFirst().id(), "uuid:device-1"_L1);
+    }
+
+    void serviceTypeInterning()
+    {
+        const auto sender = QHostAddress{"192.168.1.1"_L1};
+        auto resolver = TestResolver{};
+
+        const auto sortedTypes = [&resolver] {
+            auto types = resolver.internedServiceTypes();
+            types.sort();
+            return types;
+        };
+
+        resolver.receive(searchResponse("uuid:device-1::upnp:rootdevice", "http://192.168.1.1/a.xml"), sender);
+        resolver.receive(searchResponse("uuid:device-2::upnp:rootdevice", "http://192.168.1.2/b.xml"), sender);
+        resolver.receive(searchResponse("uuid:device-2::urn:schemas-upnp-org:service:ContentDirectory:1",
+                                        "http://192.168.1.2/b.xml"), sender);
+        resolver.receive("HTTP/1.1 200 OK\r\n"
+                         "Cache-Control: max-age=1\r\n"
+                         "USN: uuid:device-3::urn:schemas-upnp-org:service:ConnectionManager:1\r\n"
+                         "Location: http://192.168.1.3/c.xml\r\n"
+                         "\r\n"_ba, sender);
+
+        QCOMPARE(sortedTypes(), (QStringList{"upnp:rootdevice"_L1,
+                                             "urn:schemas-upnp-org:service:ConnectionManager:1"_L1,
+                                             "urn:schemas-upnp-org:service:ContentDirectory:1"_L1}));
+
+        // services of the same type share their type string
+        const auto services = resolver.services();
+        const auto rootDevices = static_cast<int>(std::count_if(services.cbegin(), services.cend(),
+                                                                [](const auto &service) {
+            return service.type() == "upnp:rootdevice"_L1;
+        }));
+
+        QCOMPARE(rootDevices, 2);
+
+        for (const auto &lhs : services) {
+            for (const auto &rhs : services) {
+                if (lhs.type() == rhs.type())
+                    QCOMPARE(lhs.type().constData(), rhs.type().constData());
+            }
+        }
+
+        // types are forgotten with their last service, be it lost or expired
+        resolver.receive("NOTIFY * HTTP/1.1\r\n"
+                         "NTS: ssdp:byebye\r\n"
+                         "USN: uuid:device-2::urn:schemas-upnp-org:service:ContentDirectory:1\r\n"
+                         "\r\n"_ba, sender);
+        resolver.receive("NOTIFY * HTTP/1.1\r\n"
+                         "NTS: ssdp:byebye\r\n"
+                         "USN: uuid:device-1::upnp:rootdevice\r\n"
+                         "\r\n"_ba, sender);
+
+        QCOMPARE(sortedTypes(), (QStringList{"upnp:rootdevice"_L1,
+                                             "urn:schemas-upnp-org:service:ConnectionManager:1"_L1}));
+        QTRY_COMPARE_WITH_TIMEOUT(sortedTypes(), QStringList{"upnp:rootdevice"_L1}, 3000);
+    }
+
+    void dualStackLocations()
+    {
+        const auto sender = QHostAddress{"192.168.1.1"_L1};
+        const auto ipv4Location = QUrl{"http://192.168.1.1/a.xml"_L1};
+        const auto ipv6Location = QUrl{"http://[fe80::1]/a.xml"_L1};
+        auto resolver = TestResolver{};
+        auto found = 0;
+
+        connect(&resolver, &Resolver::serviceFound, this, [&found] { ++found; });
+
+        // dual-stack devices announce each of their services per address family
+        for (auto i = 0; i < 3; ++i) {
+            resolver.receive(searchResponse("uuid:device-1::upnp:rootdevice", "http://192.168.1.1/a.xml"), sender);
+            resolver.receive(searchResponse("uuid:device-1::upnp:rootdevice", "http://[fe80::1]/a.xml"), sender);
+            resolver.receive(searchResponse("uuid:device-1::urn:schemas-upnp-org:service:ContentDirectory:1",
+                                            "http://[fe80::1]/a.xml"), sender);
+        }
+
+        // alternating locations are merged, instead of reporting the services again and again
+        QCOMPARE(found, 3);
+        QCOMPARE(resolver.devices().size(), 1);
+        QCOMPARE(resolver.devices().constFirst().locations(), (QList<QUrl>{ipv4Location, ipv6Location}));
+
+        // sibling services report the same locations, even if not announced for each address
+        for (const auto &service : resolver.services())
+            QCOMPARE(service.locations(), (QList<QUrl>{ipv4Location, ipv6Location}));
+
+        // each location expires on its own
+        resolver.receive("HTTP/1.1 200 OK\r\n"
+                         "Cache-Control: max-age=1\r\n"
+                         "USN: uuid:device-1::urn:schemas-upnp-org:service:ConnectionManager:1\r\n"
+                         "Location: http://192.168.1.2/a.xml\r\n"
+                         "\r\n"_ba, sender);
+
+        QCOMPARE(found, 4);
+        QCOMPARE(resolver.devices().constFirst().locations().size(), 3);
+        QCOMPARE(resolver.services().size(), 3);
+        QTRY_COMPARE_WITH_TIMEOUT(resolver.devices().constFirst().locations(),
+                                  (QList<QUrl>{ipv4Location, ipv6Location}), 3000);
+        QCOMPARE(resolver.services().size(), 2);
+    }
+
+    void deviceSubscribers()
+    {
+        auto resolver = TestResolver{};
+        QVERIFY(!resolver.hasSubscribers());
+
+        // listening only for device state still needs the resolver to scan
+        const auto rebooted = connect(&resolver, &Resolver::deviceRebooted, this, [] {});
+        QVERIFY(resolver.hasSubscribers());
+
+        disconnect(rebooted);
+        QVERIFY(!resolver.hasSubscribers());
+
+        connect(&resolver, &Resolver::deviceConfigurationChanged, this, [] {});
+        QVERIFY(resolver.hasSubscribers());
+    }
+
+    void bootAndConfigIds()
+    {
+        const auto sender = QHostAddress{"192.168.1.1"_L1};
+        auto resolver = TestResolver{};
+        auto found = 0;
+        auto rebooted = QStringList{};
+        auto configIds = QList<int>{};
+
+        connect(&resolver, &Resolver::serviceFound, this, [&found] { ++found; });
+        connect(&resolver, &Resolver::deviceRebooted, this, [&rebooted](const QString &deviceId) {
+            rebooted += deviceId;
+        });
+        connect(&resolver, &Resolver::deviceConfigurationChanged, this, [&configIds](const QString &, int configId) {
+            configIds += configId;
+        });
+
+        const auto announce = [&resolver, &sender](const QByteArray &type, int bootId, int configId) {
+            resolver.receive("NOTIFY * HTTP/1.1\r\n"
+                             "NT: upnp:rootdevice\r\n"
+                             "NTS: ssdp:"_ba + type + "\r\n"
+                             "USN: uuid:device-1::upnp:rootdevice\r\n"
+                             "Location: http://192.168.1.1/a.xml\r\n"
+                             "Cache-Control: max-age=1800\r\n"
+                             "BOOTID.UPNP.ORG: "_ba + QByteArray::number(bootId) + "\r\n"
+                             "CONFIGID.UPNP.ORG: "_ba + QByteArray::number(configId) + "\r\n"
+                             "NEXTBOOTID.UPNP.ORG: "_ba + QByteArray::number(bootId + 1) + "\r\n"
+                             "\r\n"_ba, sender);
+        };
+
+        announce("alive", 1, 10);
+        QCOMPARE(found, 1);
+        QCOMPARE(resolver.devices().constFirst().bootId(), 1);
+        QCOMPARE(resolver.devices().constFirst().configId(), 10);
+
+        // re-announcements with unchanged ids are no news
+        announce("alive", 1, 10);
+        QCOMPARE(found, 1);
+        QVERIFY(rebooted.isEmpty());
+        QVERIFY(configIds.isEmpty());
+
+        // a new configuration gets reported
+        announce("alive", 1, 11);
+        QCOMPARE(found, 2);
+        QCOMPARE(configIds, QList<int>{11});
+
+        // a boot id announced by ssdp:update is no reboot
+        announce("update", 1, 11);
+        announce("alive", 2, 11);
+        QVERIFY(rebooted.isEmpty());
+
+        // but an unexpected boot id is
+        announce("alive", 7, 11);
+        QCOMPARE(rebooted, QStringList{"uuid:device-1"_L1});
+        QCOMPARE(resolver.devices().constFirst().bootId(), 7);
+        QCOMPARE(found, 2);
+    }
+
+    void staleCachedService()
+    {
+        const auto dir = QTemporaryDir{};
+        const auto fileName = dir.filePath("cache"_L1);
+        const auto now = QDateTime::currentDateTimeUtc();
+
+        {
+            auto datagram = QNetworkDatagram{searchResponse("uuid:device-1::upnp:rootdevice",
+                                                            "http://192.168.1.1/a.xml")};
+            datagram.setSender(QHostAddress{"192.168.1.1"_L1}, 1900);
+
+            // the cached datagram is about to expire, while its max-age says otherwise
+            auto cache = core::WarmCache{fileName};
+            QVERIFY(cache.store(datagram, now.addSecs(1), {"uuid:device-1::upnp:rootdevice"_L1}, now));
+        }
+
+        auto resolver = TestResolver{};
+        auto lost = QStringList{};
+        auto expired = QStringList{};
+
+        connect(&resolver, &Resolver::serviceLost, this, [&lost](const QString &name) { lost += name; });
+        connect(&resolver, &Resolver::cachedServiceExpired, this, [&expired](const QString &name) { expired += name; });
+
+        resolver.setCacheFileName(fileName);
+        QTRY_COMPARE(resolver.services().size(), 1);
+        QVERIFY(resolver.isStaleService("uuid:device-1::upnp:rootdevice"_L1));
+
+        // replayed services that are not seen again vanish with their cached datagram
+        QTRY_COMPARE_WITH_TIMEOUT(expired, QStringList{"uuid:device-1::upnp:rootdevice"_L1}, 3000);
+        QCOMPARE(lost, QStringList{"uuid:device-1::upnp:rootdevice"_L1});
+        QVERIFY(resolver.services().isEmpty());
+        QVERIFY(resolver.devices().isEmpty());
+    }
+
+    void unicastRefresh()
+    {
+        const auto sender = QHostAddress{"192.168.1.1"_L1};
+        auto resolver = TestResolver{};
+
+        QVERIFY(!resolver.isUnicastRefresh());
+        resolver.setUnicastRefresh(true);
+        QVERIFY(resolver.isUnicastRefresh());
+
+        resolver.receive("NOTIFY * HTTP/1.1\r\n"
+                         "NT: upnp:rootdevice\r\n"
+                         "NTS: ssdp:alive\r\n"
+                         "USN: uuid:device-1::upnp:rootdevice\r\n"
+                         "Location: http://192.168.1.1:8080/a.xml\r\n"
+                         "Cache-Control: max-age=100\r\n"
+                         "SEARCHPORT.UPNP.ORG: 1901\r\n"
+                         "\r\n"_ba, sender);
+
+        resolver.receive(searchResponse("uuid:device-2::upnp:rootdevice", "http://printer.local/b.xml"), sender);
+
+        // devices only get refreshed shortly before they expire
+        const auto now = QDateTime::currentDateTimeUtc();
+        QVERIFY(resolver.takeRefreshTargets(now).isEmpty());
+        QVERIFY(resolver.takeRefreshTargets(now.addSecs(60)).isEmpty());
+
+        // devices without IP address in their location cannot be searched by unicast
+        const auto targets = resolver.takeRefreshTargets(now.addSecs(90));
+        QCOMPARE(targets.size(), 1);
+        QCOMPARE(targets[0].deviceId, "uuid:device-1"_L1);
+        QCOMPARE(targets[0].address, sender);
+        QCOMPARE(targets[0].port, quint16{1901});
+
+        // each expiry gets refreshed once
+        QVERIFY(resolver.takeRefreshTargets(now.addSecs(95)).isEmpty());
+
+        const auto ipv4Query = resolver.unicastQuery(sender, 1900);
+        QVERIFY(ipv4Query.startsWith("M-SEARCH * HTTP/1.1\r\n"));
+        QVERIFY(ipv4Query.contains("\r\nHOST: 192.168.1.1:1900\r\n"));
+        QVERIFY(ipv4Query.contains("\r\nST: ssdp:all\r\n"));
+        QVERIFY(!ipv4Query.contains("\r\nMX:"));
+
+        const auto ipv6Query = resolver.unicastQuery(QHostAddress{"fe80::1%2"_L1}, 1901);
+        QVERIFY(ipv6Query.contains("\r\nHOST: [fe80::1]:1901\r\n"));
+    }
+
+    void adaptiveDelay()
+    {
+        const auto ipv4 = QHostAddress{"192.168.1.2"_L1};
+        auto resolver = TestResolver{};
+
+        auto request = ServiceLookupRequest{};
+        request.serviceType = "urn:schemas-upnp-org:device:MediaServer:1"_L1;
+        QVERIFY(resolver.lookupService(request));
+
+        request.serviceType = "urn:schemas-upnp-org:device:Printer:1"_L1;
+        request.maximumDelay = 2s;
+        QVERIFY(resolver.lookupService(request));
+
+        const auto queries = resolver.queries();
+        QCOMPARE(queries.size(), 2);
+
+        // as long as the number of responders is unknown, the longest delay is requested
+        QCOMPARE(resolver.expectedResponders(), 0);
+        QCOMPARE(resolver.queryJitter(), 20ms);
+        QVERIFY(resolver.finalizeQuery(ipv4, queries[0]).contains("\r\nMX: 5\r\n"));
+        QVERIFY(resolver.finalizeQuery(ipv4, queries[1]).contains("\r\nMX: 2\r\n"));
+        QVERIFY(resolver.finalizeQuery(ipv4, queries[0]).contains("\r\nHOST: 239.255.255.250:1900\r\n"));
+
+        // devices get counted once, no matter how many addresses they use,
+        // and only if they respond to searches
+        for (auto i = 0; i < 50; ++i) {
+            resolver.receive(searchResponse(i), QHostAddress{0xc0a80100U + static_cast<quint32>(i)});
+            resolver.receive(searchResponse(i), QHostAddress{"fe80::%1"_L1.arg(i + 1)});
+        }
+
+        resolver.receive(notifyMessage("alive", "http://192.168.2.1/a.xml"), QHostAddress{"192.168.2.1"_L1});
+
+        // many responders spread their responses, but the requested maximum is respected
+        resolver.submitQueries({});
+        QCOMPARE(resolver.expectedResponders(), 50);
+        QCOMPARE(resolver.queryJitter(), 250ms);
+        QVERIFY(resolver.finalizeQuery(ipv4, queries[0]).contains("\r\nMX: 3\r\n"));
+        QVERIFY(resolver.finalizeQuery(ipv4, queries[1]).contains("\r\nMX: 2\r\n"));
+
+        // missing responders only get forgotten slowly
+        resolver.submitQueries({});
+        QCOMPARE(resolver.expectedResponders(), 25);
+        QVERIFY(resolver.finalizeQuery(ipv4, queries[0]).contains("\r\nMX: 2\r\n"));
     }
 };
 